@@ -0,0 +1,342 @@
+/**************************************************************************/
+/*  benchmark_baseline.cpp                                                */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#include "benchmark_baseline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace {
+
+//
+// Minimal JSON reader, sufficient for the files g3_benchmark writes
+// (objects, arrays, strings without unicode escapes, numbers, true/false/null).
+//
+struct json_value {
+	enum kind_t { Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object };
+	kind_t kind = Null;
+	double number = 0;
+	std::string string;
+	std::vector<json_value> elements;
+	std::vector<std::pair<std::string, json_value>> members;
+
+	const json_value *find(const std::string &key) const {
+		for (const auto &m : members) {
+			if (m.first == key)
+				return &m.second;
+		}
+		return nullptr;
+	}
+};
+
+class json_reader {
+public:
+	json_reader(const std::string &text) :
+			s(text), pos(0) {}
+
+	bool parse(json_value &value, std::string &error) {
+		if (parse_value(value) == false) {
+			error = "JSON syntax error at offset " + std::to_string(pos);
+			return false;
+		}
+		skip_space();
+		if (pos != s.size()) {
+			error = "trailing characters at offset " + std::to_string(pos);
+			return false;
+		}
+		return true;
+	}
+
+protected:
+	const std::string &s;
+	size_t pos;
+
+	void skip_space() {
+		while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r'))
+			++pos;
+	}
+
+	bool match(const char *literal) {
+		size_t n = strlen(literal);
+		if (s.compare(pos, n, literal) != 0)
+			return false;
+		pos += n;
+		return true;
+	}
+
+	bool parse_string(std::string &out) {
+		if (pos >= s.size() || s[pos] != '"')
+			return false;
+		++pos;
+		while (pos < s.size() && s[pos] != '"') {
+			if (s[pos] == '\\') {
+				if (++pos >= s.size())
+					return false;
+				char c = s[pos];
+				out += (c == 'n') ? '\n' : (c == 't') ? '\t' : c;
+			} else {
+				out += s[pos];
+			}
+			++pos;
+		}
+		if (pos >= s.size())
+			return false;
+		++pos;
+		return true;
+	}
+
+	bool parse_value(json_value &value) {
+		skip_space();
+		if (pos >= s.size())
+			return false;
+		char c = s[pos];
+		if (c == '{') {
+			value.kind = json_value::Object;
+			++pos;
+			skip_space();
+			if (pos < s.size() && s[pos] == '}') {
+				++pos;
+				return true;
+			}
+			while (true) {
+				std::string key;
+				skip_space();
+				if (parse_string(key) == false)
+					return false;
+				skip_space();
+				if (pos >= s.size() || s[pos++] != ':')
+					return false;
+				value.members.emplace_back(key, json_value());
+				if (parse_value(value.members.back().second) == false)
+					return false;
+				skip_space();
+				if (pos < s.size() && s[pos] == ',') {
+					++pos;
+					continue;
+				}
+				return (pos < s.size() && s[pos++] == '}');
+			}
+		} else if (c == '[') {
+			value.kind = json_value::Array;
+			++pos;
+			skip_space();
+			if (pos < s.size() && s[pos] == ']') {
+				++pos;
+				return true;
+			}
+			while (true) {
+				value.elements.emplace_back();
+				if (parse_value(value.elements.back()) == false)
+					return false;
+				skip_space();
+				if (pos < s.size() && s[pos] == ',') {
+					++pos;
+					continue;
+				}
+				return (pos < s.size() && s[pos++] == ']');
+			}
+		} else if (c == '"') {
+			value.kind = json_value::String;
+			return parse_string(value.string);
+		} else if (match("true")) {
+			value.kind = json_value::Bool;
+			value.number = 1;
+			return true;
+		} else if (match("false")) {
+			value.kind = json_value::Bool;
+			return true;
+		} else if (match("null")) {
+			return true;
+		}
+		char *end = nullptr;
+		value.kind = json_value::Number;
+		value.number = strtod(s.c_str() + pos, &end);
+		if (end == s.c_str() + pos)
+			return false;
+		pos = end - s.c_str();
+		return true;
+	}
+};
+
+double number_member(const json_value &obj, const char *key, double missing) {
+	const json_value *v = obj.find(key);
+	return (v != nullptr && v->kind == json_value::Number) ? v->number : missing;
+}
+
+std::string string_member(const json_value &obj, const char *key) {
+	const json_value *v = obj.find(key);
+	return (v != nullptr && v->kind == json_value::String) ? v->string : std::string();
+}
+
+const char *status_label(comparison_status status) {
+	switch (status) {
+		case comparison_status::Unchanged:
+			return "ok";
+		case comparison_status::Faster:
+			return "faster";
+		case comparison_status::Slower:
+			return "SLOWER";
+		case comparison_status::MoreAllocations:
+			return "MORE ALLOCATIONS";
+		case comparison_status::NewBenchmark:
+			return "new";
+		case comparison_status::Missing:
+			return "missing";
+	}
+	return "";
+}
+
+} // namespace
+
+bool read_benchmark_records(const std::string &filename, std::vector<benchmark_record> &records, std::string &error) {
+	std::ifstream in(filename);
+	if (!in) {
+		error = "cannot read " + filename;
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	std::string text = buffer.str();
+
+	json_value root;
+	json_reader reader(text);
+	if (reader.parse(root, error) == false) {
+		error = filename + ": " + error;
+		return false;
+	}
+	const json_value *results = root.find("results");
+	if (root.kind != json_value::Object || string_member(root, "format") != "g3_benchmark" || results == nullptr || results->kind != json_value::Array) {
+		error = filename + ": not a g3_benchmark results file";
+		return false;
+	}
+
+	records.clear();
+	for (const json_value &r : results->elements) {
+		benchmark_record record;
+		record.name = string_member(r, "name");
+		record.mesh = string_member(r, "mesh");
+		record.median_ms = number_member(r, "median_ms", 0);
+		record.min_ms = number_member(r, "min_ms", record.median_ms);
+		// files written before mad_ms was added only have the stddev
+		record.mad_ms = number_member(r, "mad_ms", number_member(r, "stddev_ms", 0) / 1.4826);
+		record.allocations = (int64_t)number_member(r, "allocations", -1);
+		records.push_back(record);
+	}
+	return true;
+}
+
+std::vector<benchmark_comparison> compare_benchmarks(const std::vector<benchmark_record> &baseline,
+		const std::vector<benchmark_record> &current, const regression_thresholds &thresholds) {
+	std::map<std::string, const benchmark_record *> baseline_map;
+	for (const benchmark_record &b : baseline)
+		baseline_map[b.name + "/" + b.mesh] = &b;
+
+	std::vector<benchmark_comparison> comparisons;
+	for (const benchmark_record &c : current) {
+		benchmark_comparison cmp;
+		cmp.name = c.name;
+		cmp.mesh = c.mesh;
+		cmp.current_ms = c.min_ms;
+		cmp.current_allocations = c.allocations;
+
+		auto found = baseline_map.find(c.name + "/" + c.mesh);
+		if (found == baseline_map.end()) {
+			cmp.status = comparison_status::NewBenchmark;
+			comparisons.push_back(cmp);
+			continue;
+		}
+		const benchmark_record &b = *found->second;
+		baseline_map.erase(found);
+		cmp.baseline_ms = b.min_ms;
+		cmp.baseline_allocations = b.allocations;
+
+		double delta = c.min_ms - b.min_ms;
+		cmp.delta_ratio = (b.min_ms > 0) ? delta / b.min_ms : 0;
+		cmp.noise_ms = thresholds.noise_sigmas * 1.4826 * std::sqrt(b.mad_ms * b.mad_ms + c.mad_ms * c.mad_ms);
+		double allowed = std::max(thresholds.time_ratio * b.min_ms, std::max(cmp.noise_ms, thresholds.min_time_delta_ms));
+
+		if (thresholds.check_allocations && b.allocations >= 0 && c.allocations >= 0 &&
+				(double)c.allocations > (double)b.allocations * (1.0 + thresholds.allocation_ratio)) {
+			cmp.status = comparison_status::MoreAllocations;
+		}
+		if (thresholds.check_time && delta > allowed) {
+			cmp.status = comparison_status::Slower;
+		} else if (thresholds.check_time && cmp.status == comparison_status::Unchanged && -delta > allowed) {
+			cmp.status = comparison_status::Faster;
+		}
+		comparisons.push_back(cmp);
+	}
+
+	// baseline entries that were not run (eg filtered out) are reported but do not fail the gate
+	for (const benchmark_record &b : baseline) {
+		if (baseline_map.find(b.name + "/" + b.mesh) == baseline_map.end())
+			continue;
+		benchmark_comparison cmp;
+		cmp.name = b.name;
+		cmp.mesh = b.mesh;
+		cmp.status = comparison_status::Missing;
+		cmp.baseline_ms = b.min_ms;
+		cmp.baseline_allocations = b.allocations;
+		comparisons.push_back(cmp);
+	}
+	return comparisons;
+}
+
+int print_comparison_report(std::ostream &out, const std::vector<benchmark_comparison> &comparisons) {
+	int nRegressions = 0, nFaster = 0, nCompared = 0;
+	char line[256];
+	for (const benchmark_comparison &cmp : comparisons) {
+		std::string label = cmp.name + "/" + cmp.mesh;
+		if (cmp.status == comparison_status::NewBenchmark || cmp.status == comparison_status::Missing) {
+			snprintf(line, sizeof(line), "  %-34s %s\n", label.c_str(), status_label(cmp.status));
+		} else {
+			snprintf(line, sizeof(line), "  %-34s %10.3f -> %10.3f ms %+7.1f%% (noise %.3f ms)  allocs %lld -> %lld  %s\n",
+					label.c_str(), cmp.baseline_ms, cmp.current_ms, 100.0 * cmp.delta_ratio, cmp.noise_ms,
+					(long long)cmp.baseline_allocations, (long long)cmp.current_allocations, status_label(cmp.status));
+		}
+		out << line;
+		nRegressions += cmp.is_regression() ? 1 : 0;
+		nFaster += (cmp.status == comparison_status::Faster) ? 1 : 0;
+		nCompared += (cmp.status == comparison_status::NewBenchmark || cmp.status == comparison_status::Missing) ? 0 : 1;
+	}
+	out << nRegressions << " regression(s), " << nFaster << " faster, " << nCompared << " compared\n";
+	return nRegressions;
+}
@@ -0,0 +1,100 @@
+/**************************************************************************/
+/*  benchmark_baseline.h                                                  */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef BENCHMARK_BASELINE_H
+#define BENCHMARK_BASELINE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//
+// Regression gate for g3_benchmark: reads a committed baseline JSON file (the
+// output of a previous g3_benchmark run) and compares a new run against it.
+//
+
+// the values of one benchmark/mesh pair that the gate compares. Times are compared by the
+// fastest run, as scheduling and cache noise only ever make runs slower, and the run-to-run
+// noise is measured by the median absolute deviation, which ignores a few slow outliers
+struct benchmark_record {
+	std::string name;
+	std::string mesh;
+	double min_ms = 0;
+	double median_ms = 0;
+	double mad_ms = 0;
+	int64_t allocations = -1; // -1 if not measured
+};
+
+struct regression_thresholds {
+	bool check_time = true;
+	bool check_allocations = true;
+
+	// a benchmark is slower if its fastest run grew by more than all of these
+	double time_ratio = 0.10; // relative to the baseline fastest run
+	double noise_sigmas = 3.0; // times the combined noise (1.4826 * MAD, ie a stddev) of both runs
+	double min_time_delta_ms = 0.05; // below timer/scheduler noise
+
+	// allocations are close to deterministic, so only allow a small relative increase
+	double allocation_ratio = 0.02;
+};
+
+enum class comparison_status {
+	Unchanged,
+	Faster,
+	Slower, // a regression
+	MoreAllocations, // a regression
+	NewBenchmark, // not in the baseline
+	Missing // in the baseline but not in this run
+};
+
+struct benchmark_comparison {
+	std::string name;
+	std::string mesh;
+	comparison_status status = comparison_status::Unchanged;
+	double baseline_ms = 0, current_ms = 0;
+	double delta_ratio = 0; // (current - baseline) / baseline
+	double noise_ms = 0; // allowed delta from the run-to-run noise
+	int64_t baseline_allocations = -1, current_allocations = -1;
+
+	bool is_regression() const { return status == comparison_status::Slower || status == comparison_status::MoreAllocations; }
+};
+
+// parse the "results" array of a g3_benchmark JSON file, returns false and sets error on failure
+bool read_benchmark_records(const std::string &filename, std::vector<benchmark_record> &records, std::string &error);
+
+// compare each current record with the baseline record of the same name and mesh
+std::vector<benchmark_comparison> compare_benchmarks(const std::vector<benchmark_record> &baseline,
+		const std::vector<benchmark_record> &current, const regression_thresholds &thresholds);
+
+// one line per comparison plus a summary, returns the number of regressions
+int print_comparison_report(std::ostream &out, const std::vector<benchmark_comparison> &comparisons);
+
+#endif // BENCHMARK_BASELINE_H
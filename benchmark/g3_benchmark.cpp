@@ -0,0 +1,1248 @@
+/**************************************************************************/
+/*  g3_benchmark.cpp                                                      */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+// Standalone micro/macro benchmarks for the g3 mesh hot paths. See CMakeLists.txt
+// for how to build, and run with --help for the options. Results are written as JSON.
+
+#include <geometry3PCH.h>
+
+#include <BasicProjectionTargets.h>
+#include <DMesh3.h>
+#include <DMeshAABBTree3.h>
+#include <PartitionedRemesher.h>
+#include <RegionRemesher.h>
+#include <SizingFields.h>
+#include <Remesher.h>
+#include <profile_util.h>
+#include <thread_pool.h>
+
+#include "benchmark_baseline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef G3_BENCHMARK_BUILD_TYPE
+#define G3_BENCHMARK_BUILD_TYPE "unknown"
+#endif
+
+using namespace g3;
+
+//
+// Global operator new is replaced so that each timed run also reports how many
+// heap allocations it made, and so that profiler scopes can count allocations
+// (see --profile). The array and nothrow forms forward to these.
+// Eigen's aligned allocations bypass operator new and are not counted.
+//
+// The replacements are not inlined: GCC would then see free() of memory returned by
+// operator new at the call sites, and warn (-Wmismatched-new-delete).
+//
+namespace {
+std::atomic<int64_t> allocation_count(0);
+std::atomic<int64_t> allocation_bytes(0);
+} // namespace
+
+#if defined(__GNUC__)
+#define G3_BENCHMARK_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define G3_BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define G3_BENCHMARK_NOINLINE
+#endif
+
+G3_BENCHMARK_NOINLINE void *operator new(std::size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocation_bytes.fetch_add((int64_t)size, std::memory_order_relaxed);
+	LocalProfiler::NoteAllocation(size);
+	void *p = std::malloc(size > 0 ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+G3_BENCHMARK_NOINLINE void operator delete(void *p) noexcept {
+	std::free(p);
+}
+G3_BENCHMARK_NOINLINE void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+namespace {
+
+// results are accumulated here so the optimizer cannot drop the measured work
+volatile int64_t benchmark_sink = 0;
+
+struct benchmark_options {
+	std::vector<std::string> scales = { "small", "medium" };
+	std::string filter;
+	std::string output;
+	int repeat = 5;
+	int warmup = 1;
+	int threads = 0; // 0 = default thread_pool
+	int queries = 50000;
+	bool list_only = false;
+	bool profile = false;
+
+	// regression gate, see benchmark_baseline.h
+	std::string baseline;
+	regression_thresholds thresholds;
+};
+
+struct mesh_scale {
+	const char *name;
+	int slices, stacks;
+};
+
+// ~16K, ~260K and ~1M triangles
+const mesh_scale mesh_scales[] = {
+	{ "small", 128, 64 },
+	{ "medium", 512, 256 },
+	{ "large", 1024, 512 },
+};
+
+struct benchmark_result {
+	std::string name;
+	std::string mesh;
+	int vertices = 0;
+	int triangles = 0;
+	int64_t ops = 0;
+	std::vector<double> samples_ms;
+	int64_t allocations = -1; // fewest heap allocations of any timed run
+	int64_t allocated_bytes = -1;
+
+	double min_ms() const { return *std::min_element(samples_ms.begin(), samples_ms.end()); }
+	double max_ms() const { return *std::max_element(samples_ms.begin(), samples_ms.end()); }
+	double mean_ms() const {
+		double sum = 0;
+		for (double t : samples_ms)
+			sum += t;
+		return sum / (double)samples_ms.size();
+	}
+	double median_ms() const {
+		std::vector<double> sorted = samples_ms;
+		std::sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		return (n % 2 == 1) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+	}
+	// median absolute deviation from the median
+	double mad_ms() const {
+		double median = median_ms();
+		std::vector<double> deviations;
+		for (double t : samples_ms)
+			deviations.push_back(std::abs(t - median));
+		std::sort(deviations.begin(), deviations.end());
+		size_t n = deviations.size();
+		return (n % 2 == 1) ? deviations[n / 2] : 0.5 * (deviations[n / 2 - 1] + deviations[n / 2]);
+	}
+	double stddev_ms() const {
+		if (samples_ms.size() < 2)
+			return 0;
+		double mean = mean_ms(), sum = 0;
+		for (double t : samples_ms)
+			sum += (t - mean) * (t - mean);
+		return std::sqrt(sum / (double)(samples_ms.size() - 1));
+	}
+};
+
+// unit sphere as a lat-long grid with single-vertex poles, closed and manifold
+void make_sphere(DMesh3 &mesh, int nSlices, int nStacks) {
+	int top = mesh.AppendVertex(Vector3d(0, 0, 1));
+	for (int j = 1; j < nStacks; ++j) {
+		double phi = Wml::Mathd::PI * (double)j / (double)nStacks;
+		for (int i = 0; i < nSlices; ++i) {
+			double theta = Wml::Mathd::TWO_PI * (double)i / (double)nSlices;
+			mesh.AppendVertex(Vector3d(std::sin(phi) * std::cos(theta), std::sin(phi) * std::sin(theta), std::cos(phi)));
+		}
+	}
+	int bottom = mesh.AppendVertex(Vector3d(0, 0, -1));
+
+	auto ring_vertex = [nSlices](int j, int i) { return 1 + (j - 1) * nSlices + (i % nSlices); };
+	for (int i = 0; i < nSlices; ++i)
+		mesh.AppendTriangle(top, ring_vertex(1, i), ring_vertex(1, i + 1));
+	for (int j = 1; j < nStacks - 1; ++j) {
+		for (int i = 0; i < nSlices; ++i) {
+			mesh.AppendTriangle(ring_vertex(j, i), ring_vertex(j + 1, i), ring_vertex(j + 1, i + 1));
+			mesh.AppendTriangle(ring_vertex(j, i), ring_vertex(j + 1, i + 1), ring_vertex(j, i + 1));
+		}
+	}
+	for (int i = 0; i < nSlices; ++i)
+		mesh.AppendTriangle(bottom, ring_vertex(nStacks - 1, i + 1), ring_vertex(nStacks - 1, i));
+}
+
+double mean_edge_length(const DMesh3 &mesh) {
+	double sum = 0;
+	for (int eid : mesh.EdgeIndices()) {
+		Index2i ev = mesh.GetEdgeV(eid);
+		sum += (mesh.GetVertex(ev.x()) - mesh.GetVertex(ev.y())).norm();
+	}
+	return sum / (double)mesh.EdgeCount();
+}
+
+// edge IDs of mesh in a fixed pseudo-random order
+std::vector<int> shuffled_edges(const DMesh3 &mesh, unsigned int seed) {
+	std::vector<int> edges;
+	edges.reserve(mesh.EdgeCount());
+	for (int eid : mesh.EdgeIndices())
+		edges.push_back(eid);
+	std::mt19937 rng(seed);
+	std::shuffle(edges.begin(), edges.end(), rng);
+	return edges;
+}
+
+DMesh3Ptr copy_mesh(const DMesh3 &mesh) {
+	return std::make_shared<DMesh3>(mesh, false, MeshComponents::None);
+}
+
+// copy of a unit sphere with attributes that are functions of the position: the normal,
+// color (p+1)/2 and UV (x,y), and group 1 on the upper and 2 on the lower half
+DMesh3Ptr copy_sphere_with_attributes(const DMesh3 &mesh) {
+	int nAll = (int)MeshComponents::VertexNormals | (int)MeshComponents::VertexColors |
+			(int)MeshComponents::VertexUVs | (int)MeshComponents::FaceGroups;
+	DMesh3Ptr result = std::make_shared<DMesh3>((MeshComponents)nAll);
+	std::vector<int> new_vid(mesh.MaxVertexID(), DMesh3::InvalidID);
+	for (int vid : mesh.VertexIndices()) {
+		Vector3f p = mesh.GetVertex(vid).cast<float>();
+		new_vid[vid] = result->AppendVertex(NewVertexInfo(mesh.GetVertex(vid), p.normalized(),
+				0.5f * (p + Vector3f::Ones()), Vector2f(p.x(), p.y())));
+	}
+	for (int tid : mesh.TriangleIndices()) {
+		Index3i tv = mesh.GetTriangle(tid);
+		result->AppendTriangle(Index3i(new_vid[tv[0]], new_vid[tv[1]], new_vid[tv[2]]),
+				(mesh.GetTriCentroid(tid).z() >= 0) ? 1 : 2);
+	}
+	return result;
+}
+
+// Remesher for mesh that projects to target. fTargetLength is a bit below the current edge
+// length in the remesher benchmarks, so a pass splits, collapses, flips, smooths and projects
+std::unique_ptr<Remesher> make_remesher(DMesh3Ptr mesh, double fTargetLength, IProjectionTargetPtr target) {
+	std::unique_ptr<Remesher> remesher(new Remesher(mesh));
+	remesher->SetTargetEdgeLength(fTargetLength);
+	remesher->SetProjectionTarget(target);
+	remesher->Precompute();
+	return remesher;
+}
+
+// base remeshed close to convergence (two priority-ordered passes), so that further passes
+// only change a small part of the mesh
+DMesh3Ptr converged_mesh(const DMesh3 &base, double fTargetLength, IProjectionTargetPtr target) {
+	DMesh3Ptr mesh = copy_mesh(base);
+	std::unique_ptr<Remesher> remesher = make_remesher(mesh, fTargetLength, target);
+	remesher->EdgeOrder = Remesher::EdgeOrders::Priority;
+	for (int k = 0; k < 2; ++k)
+		remesher->BasicRemeshPass();
+	return mesh;
+}
+
+// number of edges that are shorter than MinEdgeLength or longer than MaxEdgeLength
+int edges_out_of_range(const DMesh3 &mesh, const Remesher &remesher) {
+	int nCount = 0;
+	for (int eid : mesh.EdgeIndices()) {
+		Index2i ev = mesh.GetEdgeV(eid);
+		double fLength = (mesh.GetVertex(ev.x()) - mesh.GetVertex(ev.y())).norm();
+		if (fLength < remesher.MinEdgeLength || fLength > remesher.MaxEdgeLength)
+			nCount++;
+	}
+	return nCount;
+}
+
+// true if a and b have the same vertex and triangle IDs, vertex positions (up to fTolerance) and triangles
+bool identical_meshes(const DMesh3 &a, const DMesh3 &b, double fTolerance = 0) {
+	if (a.MaxVertexID() != b.MaxVertexID() || a.MaxTriangleID() != b.MaxTriangleID())
+		return false;
+	for (int vid = 0; vid < a.MaxVertexID(); ++vid) {
+		if (a.IsVertex(vid) != b.IsVertex(vid) || (a.IsVertex(vid) && (a.GetVertex(vid) - b.GetVertex(vid)).norm() > fTolerance))
+			return false;
+	}
+	for (int tid = 0; tid < a.MaxTriangleID(); ++tid) {
+		if (a.IsTriangle(tid) != b.IsTriangle(tid) || (a.IsTriangle(tid) && a.GetTriangle(tid) != b.GetTriangle(tid)))
+			return false;
+	}
+	return true;
+}
+
+// Benchmarks also check their results, so a mode that is only reached from here is still
+// tested. A failed check is reported and makes g3_benchmark exit with status 1.
+int check_failures = 0;
+void check(bool bOK, const benchmark_result &result, const std::string &what) {
+	if (bOK)
+		return;
+	check_failures++;
+	std::cerr << "\n"
+			  << result.name << "/" << result.mesh << ": check failed: " << what << "\n";
+}
+void check_valid(const DMesh3 &mesh, const benchmark_result &result, const std::string &what, bool bAllowNonManifoldVertices = false) {
+	check(mesh.CheckValidity(bAllowNonManifoldVertices, DMesh3::FailMode::ReturnOnly), result, what + " is a valid mesh");
+}
+
+// Runs g3 parallel loops on a private pool of nThreads threads (the calling thread and
+// nThreads-1 pool threads), or on the default thread_pool if nThreads is 0
+std::unique_ptr<thread_pool> private_pool;
+void use_private_pool(int nThreads) {
+	clear_parallel_backend();
+	private_pool.reset();
+	if (nThreads <= 0)
+		return;
+	private_pool.reset(new thread_pool(nThreads - 1));
+	thread_pool *use_pool = private_pool.get();
+	parallel_backend backend;
+	backend.concurrency = nThreads;
+	backend.dispatch = [use_pool](int nTasks, const std::function<void(int)> &task) {
+		task_group group(*use_pool);
+		for (int k = 1; k < nTasks; ++k)
+			group.run([&task, k]() { task(k); });
+		task(0);
+		group.wait();
+	};
+	set_parallel_backend(backend);
+}
+
+//
+// Runs setup() (untimed) and then run() (timed) nWarmup+nRepeat times and records
+// the timed samples and allocation counts. run() returns the number of operations it performed.
+//
+template <typename SetupFunc, typename RunFunc>
+void measure(benchmark_result &result, const benchmark_options &opt, SetupFunc setup, RunFunc run) {
+	for (int k = 0; k < opt.warmup + opt.repeat; ++k) {
+		setup();
+		int64_t nAllocStart = allocation_count.load(), nBytesStart = allocation_bytes.load();
+		auto start = std::chrono::steady_clock::now();
+		int64_t ops = run();
+		auto end = std::chrono::steady_clock::now();
+		int64_t nAllocs = allocation_count.load() - nAllocStart, nBytes = allocation_bytes.load() - nBytesStart;
+		if (k < opt.warmup)
+			continue;
+		result.samples_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		result.ops = ops;
+		if (result.allocations < 0 || nAllocs < result.allocations) {
+			result.allocations = nAllocs;
+			result.allocated_bytes = nBytes;
+		}
+	}
+}
+
+struct benchmark_case {
+	const char *name;
+	std::function<void(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result)> run;
+};
+
+void bench_append_triangle(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	std::vector<Vector3d> vertices;
+	std::vector<Index3i> triangles;
+	for (int vid : base.VertexIndices())
+		vertices.push_back(base.GetVertex(vid));
+	for (int tid : base.TriangleIndices())
+		triangles.push_back(base.GetTriangle(tid));
+
+	std::unique_ptr<DMesh3> mesh;
+	measure(
+			result, opt, [&]() { mesh.reset(); },
+			[&]() {
+				mesh.reset(new DMesh3(MeshComponents::None));
+				for (const Vector3d &v : vertices)
+					mesh->AppendVertex(v);
+				for (const Index3i &t : triangles)
+					mesh->AppendTriangle(t);
+				return (int64_t)triangles.size();
+			});
+	benchmark_sink += mesh->TriangleCount();
+}
+
+void bench_split_edge(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	std::vector<int> edges = shuffled_edges(base, 1);
+	DMesh3Ptr mesh;
+	measure(
+			result, opt, [&]() { mesh = copy_mesh(base); },
+			[&]() {
+				DMesh3::EdgeSplitInfo info;
+				int64_t nOK = 0;
+				for (int eid : edges)
+					nOK += (mesh->SplitEdge(eid, info) == MeshResult::Ok) ? 1 : 0;
+				benchmark_sink += nOK;
+				return (int64_t)edges.size();
+			});
+}
+
+void bench_flip_edge(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	std::vector<int> edges = shuffled_edges(base, 2);
+	DMesh3Ptr mesh;
+	measure(
+			result, opt, [&]() { mesh = copy_mesh(base); },
+			[&]() {
+				DMesh3::EdgeFlipInfo info;
+				int64_t nOK = 0;
+				for (int eid : edges)
+					nOK += (mesh->FlipEdge(eid, info) == MeshResult::Ok) ? 1 : 0;
+				benchmark_sink += nOK;
+				return (int64_t)edges.size();
+			});
+}
+
+void bench_collapse_edge(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	// collapse a quarter of the edges, so the mesh stays far away from degenerate
+	std::vector<int> edges = shuffled_edges(base, 3);
+	edges.resize(edges.size() / 4);
+	DMesh3Ptr mesh;
+	measure(
+			result, opt, [&]() { mesh = copy_mesh(base); },
+			[&]() {
+				DMesh3::EdgeCollapseInfo info;
+				int64_t nOK = 0;
+				for (int eid : edges) {
+					if (mesh->IsEdge(eid) == false)
+						continue;
+					Index2i ev = mesh->GetEdgeV(eid);
+					nOK += (mesh->CollapseEdge(ev.x(), ev.y(), info) == MeshResult::Ok) ? 1 : 0;
+				}
+				benchmark_sink += nOK;
+				return (int64_t)edges.size();
+			});
+}
+
+void bench_find_edge(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	// every existing edge, plus the same number of (almost always) missing vertex pairs
+	std::vector<Index2i> pairs;
+	for (int eid : base.EdgeIndices())
+		pairs.push_back(base.GetEdgeV(eid));
+	std::mt19937 rng(4);
+	std::uniform_int_distribution<int> vertex(0, base.MaxVertexID() - 1);
+	size_t nEdges = pairs.size();
+	for (size_t k = 0; k < nEdges; ++k)
+		pairs.push_back(Index2i(vertex(rng), vertex(rng)));
+	std::shuffle(pairs.begin(), pairs.end(), rng);
+
+	measure(
+			result, opt, []() {},
+			[&]() {
+				int64_t nFound = 0;
+				for (const Index2i &p : pairs)
+					nFound += (base.FindEdge(p.x(), p.y()) != DMesh3::InvalidID) ? 1 : 0;
+				benchmark_sink += nFound;
+				return (int64_t)pairs.size();
+			});
+}
+
+void bench_aabb_build(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	DMesh3Ptr mesh = copy_mesh(base);
+	std::unique_ptr<DMeshAABBTree3> tree;
+	measure(
+			result, opt, [&]() { tree.reset(); },
+			[&]() {
+				tree.reset(new DMeshAABBTree3(mesh, false));
+				tree->Build();
+				return (int64_t)mesh->TriangleCount();
+			});
+}
+
+void bench_aabb_nearest(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	DMesh3Ptr mesh = copy_mesh(base);
+	DMeshAABBTree3 tree(mesh, true);
+
+	// points near the surface, as in remesher projection
+	std::vector<Vector3d> points;
+	std::mt19937 rng(5);
+	std::normal_distribution<double> coord(0.0, 1.0);
+	std::uniform_real_distribution<double> radius(0.9, 1.1);
+	for (int k = 0; k < opt.queries; ++k) {
+		Vector3d dir(coord(rng), coord(rng), coord(rng));
+		points.push_back(radius(rng) * dir.normalized());
+	}
+
+	measure(
+			result, opt, []() {},
+			[&]() {
+				int64_t nSum = 0;
+				for (const Vector3d &p : points) {
+					double fDistSqr;
+					nSum += tree.FindNearestTriangle(p, fDistSqr);
+				}
+				benchmark_sink += nSum;
+				return (int64_t)points.size();
+			});
+}
+
+void bench_remesh_pass(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(base);
+				remesher = make_remesher(mesh, fTargetLength, target);
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				Remesher::RemeshPassStats stats = remesher->BasicRemeshPass();
+				benchmark_sink += stats.ModifiedEdges();
+				return nEdges;
+			});
+
+	if (opt.profile) {
+		DMesh3 compact(MeshComponents::None);
+		compact.CompactCopy(*mesh, false, false, false);
+		std::cerr << "\nremeshed " << result.mesh << " memory:\n"
+				  << mesh->GetMemoryReport().ToString() << "compact copy memory:\n"
+				  << compact.GetMemoryReport().ToString();
+	}
+}
+
+void bench_parallel_refine(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+	auto make_parallel_remesher = [&](DMesh3Ptr mesh) {
+		std::unique_ptr<Remesher> remesher = make_remesher(mesh, fTargetLength, target);
+		remesher->EnableParallelRefinement = true;
+		return remesher;
+	};
+
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(base);
+				remesher = make_parallel_remesher(mesh);
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				Remesher::RemeshPassStats stats = remesher->BasicRemeshPass();
+				benchmark_sink += stats.ModifiedEdges();
+				return nEdges;
+			});
+	check_valid(*mesh, result, "parallel refinement");
+
+	// The ops do not depend on the thread count. Concurrent splits and collapses take IDs in
+	// scheduling order, and smoothing sums in edge-list order, so the meshes are compared by
+	// their element counts and the distance of each vertex to the other surface.
+	Remesher::RemeshPassStats thread_stats[2];
+	DMesh3Ptr thread_mesh[2];
+	for (int k = 0; k < 2; ++k) {
+		use_private_pool((k == 0) ? 1 : 4);
+		thread_mesh[k] = copy_mesh(base);
+		thread_stats[k] = make_parallel_remesher(thread_mesh[k])->BasicRemeshPass();
+	}
+	use_private_pool(opt.threads);
+	bool bSameOps = true;
+	for (int i = 0; i < Remesher::ProcessResultCount; ++i)
+		bSameOps = bSameOps && thread_stats[0].ResultCounts[i] == thread_stats[1].ResultCounts[i];
+	check(bSameOps, result, "parallel refinement does the same ops on 1 and 4 threads");
+	const DMesh3 &mesh1 = *thread_mesh[0], &mesh4 = *thread_mesh[1];
+	check(mesh1.VertexCount() == mesh4.VertexCount() && mesh1.EdgeCount() == mesh4.EdgeCount() &&
+					mesh1.TriangleCount() == mesh4.TriangleCount(),
+			result, "parallel refinement makes the same mesh on 1 and 4 threads");
+	double fMaxDist = 0;
+	for (int k = 0; k < 2; ++k) {
+		DMeshAABBTree3 tree(thread_mesh[k], true);
+		for (int vid : thread_mesh[1 - k]->VertexIndices()) {
+			double fDistSqr;
+			tree.FindNearestTriangle(thread_mesh[1 - k]->GetVertex(vid), fDistSqr);
+			fMaxDist = std::max(fMaxDist, std::sqrt(fDistSqr));
+		}
+	}
+	check(fMaxDist < 1e-9 * fTargetLength, result, "parallel refinement vertices are the same on 1 and 4 threads");
+}
+
+void bench_priority_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(base);
+				remesher = make_remesher(mesh, fTargetLength, target);
+				remesher->EdgeOrder = Remesher::EdgeOrders::Priority;
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				Remesher::RemeshPassStats stats = remesher->BasicRemeshPass();
+				benchmark_sink += stats.ModifiedEdges();
+				return nEdges;
+			});
+	check_valid(*mesh, result, "priority refinement");
+	// the re-queued edges are refined again in the same pass, so after one pass almost all
+	// edges are in range (about 30% are not after a PrimeModulo pass)
+	check(edges_out_of_range(*mesh, *remesher) < mesh->EdgeCount() / 100, result, "priority refinement converges in one pass");
+}
+
+void bench_active_set_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+
+	// the active set is small once the mesh is close to converged
+	DMesh3Ptr converged = converged_mesh(base, fTargetLength, target);
+
+	// the first pass of a remesher processes the whole mesh
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	Remesher::RemeshPassStats stats;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(*converged);
+				remesher = make_remesher(mesh, fTargetLength, target);
+				remesher->EnableActiveSet = true;
+				remesher->BasicRemeshPass();
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				stats = remesher->BasicRemeshPass();
+				benchmark_sink += stats.ModifiedEdges();
+				return nEdges;
+			});
+	check_valid(*mesh, result, "active-set pass");
+	check(stats.ActiveVertices >= 0 && stats.ActiveVertices < mesh->VertexCount() / 4, result,
+			"active-set pass only processes the active set");
+}
+
+void bench_sizing_field_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fMeanLength = mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+	// target lengths grow from 0.5 to 1.5 times the current length from the bottom to the top
+	std::shared_ptr<MeshSizingField> field = std::make_shared<MeshSizingField>(copy_mesh(base), fMeanLength);
+	for (int vid : field->Mesh->VertexIndices())
+		field->VertexLengths[vid] = fMeanLength * (1.0 + 0.5 * field->Mesh->GetVertex(vid).z());
+
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(base);
+				remesher = make_remesher(mesh, fMeanLength, target);
+				remesher->SizingField = field;
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				Remesher::RemeshPassStats stats = remesher->BasicRemeshPass();
+				benchmark_sink += stats.ModifiedEdges();
+				return nEdges;
+			});
+	check_valid(*mesh, result, "sizing-field pass");
+	// mean edge length in the caps above z=0.5 and below z=-0.5, where the targets differ by about 2.2x
+	double fSum[2] = { 0, 0 };
+	int nCount[2] = { 0, 0 };
+	for (int eid : mesh->EdgeIndices()) {
+		Index2i ev = mesh->GetEdgeV(eid);
+		Vector3d a = mesh->GetVertex(ev.x()), b = mesh->GetVertex(ev.y());
+		double z = 0.5 * (a.z() + b.z());
+		if (std::abs(z) > 0.5) {
+			fSum[z > 0 ? 0 : 1] += (a - b).norm();
+			nCount[z > 0 ? 0 : 1]++;
+		}
+	}
+	check(nCount[1] > 0 && fSum[0] * nCount[1] > 1.5 * fSum[1] * nCount[0], result, "sizing-field pass adapts the edge lengths");
+}
+
+void bench_step_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+	// about 20 slices per pass
+	int nSliceItems = base.EdgeCount() / 8;
+
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(base);
+				remesher = make_remesher(mesh, fTargetLength, target);
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				while (remesher->Step(nSliceItems) == false)
+					benchmark_sink++;
+				return nEdges;
+			});
+	check_valid(*mesh, result, "time-sliced pass");
+
+	// the mesh is valid after each slice, and the sliced pass does the same as BasicRemeshPass(),
+	// with buffered and with in-place smoothing
+	for (int k = 0; k < 2; ++k) {
+		std::string mode = (k == 0) ? "time-sliced pass" : "time-sliced in-place pass";
+		DMesh3Ptr sliced = copy_mesh(base);
+		remesher = make_remesher(sliced, fTargetLength, target);
+		remesher->EnableSmoothInPlace = (k == 1);
+		bool bValid = true;
+		int nSlices = 1;
+		for (; remesher->Step(nSliceItems) == false; ++nSlices)
+			bValid = bValid && sliced->CheckValidity(false, DMesh3::FailMode::ReturnOnly);
+		check(bValid && nSlices > 1, result, mode + " leaves a valid mesh after each slice");
+		DMesh3Ptr reference = copy_mesh(base);
+		remesher = make_remesher(reference, fTargetLength, target);
+		remesher->EnableSmoothInPlace = (k == 1);
+		remesher->BasicRemeshPass();
+		check(identical_meshes(*reference, *sliced), result, mode + " gives the same mesh as BasicRemeshPass()");
+	}
+}
+
+void bench_cotan_cache_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+	// few weights change between passes once the mesh is close to converged
+	DMesh3Ptr converged = converged_mesh(base, fTargetLength, target);
+
+	// the second pass of a remesher builds the cache, the third updates it
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(*converged);
+				remesher = make_remesher(mesh, fTargetLength, target);
+				for (int k = 0; k < 2; ++k)
+					remesher->BasicRemeshPass();
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				Remesher::RemeshPassStats stats = remesher->BasicRemeshPass();
+				benchmark_sink += stats.ModifiedEdges();
+				return nEdges;
+			});
+	check_valid(*mesh, result, "cotan-cache pass");
+
+	// the cached weights are the weights smoothing would compute
+	DMesh3Ptr uncached = copy_mesh(*converged);
+	remesher = make_remesher(uncached, fTargetLength, target);
+	remesher->EnableCotanWeightCache = false;
+	for (int k = 0; k < 3; ++k)
+		remesher->BasicRemeshPass();
+	check(identical_meshes(*mesh, *uncached), result, "cotan-cache passes give the same mesh as uncached passes");
+}
+
+void bench_warm_start_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+
+	// the first pass fills the cache, the second starts its queries from it
+	DMesh3Ptr mesh;
+	std::unique_ptr<Remesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(base);
+				MeshProjectionTargetPtr warm_target = std::make_shared<WarmStartMeshProjectionTarget>(target->Mesh, target->Spatial);
+				remesher = make_remesher(mesh, fTargetLength, warm_target);
+				remesher->BasicRemeshPass();
+			},
+			[&]() {
+				int64_t nEdges = mesh->EdgeCount();
+				Remesher::RemeshPassStats stats = remesher->BasicRemeshPass();
+				benchmark_sink += stats.ModifiedEdges();
+				return nEdges;
+			});
+	check_valid(*mesh, result, "warm-start pass");
+
+	// the warm-started queries find the same nearest triangles, except that ties (eg points
+	// nearest to a shared edge) may pick another triangle and round differently, and
+	// smoothing spreads these differences a little
+	DMesh3Ptr cold = copy_mesh(base);
+	remesher = make_remesher(cold, fTargetLength, target);
+	for (int k = 0; k < 2; ++k)
+		remesher->BasicRemeshPass();
+	check(identical_meshes(*mesh, *cold, 1e-6 * fTargetLength), result, "warm-start passes give the same mesh as MeshProjectionTarget");
+}
+
+void bench_compact_copy(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	// remove every third triangle so the ID spaces have gaps to compact
+	DMesh3Ptr sparse = copy_mesh(base);
+	for (int tid = 0; tid < sparse->MaxTriangleID(); tid += 3) {
+		if (sparse->IsTriangle(tid))
+			sparse->RemoveTriangle(tid, true, false);
+	}
+
+	std::unique_ptr<DMesh3> compact;
+	measure(
+			result, opt, [&]() { compact.reset(); },
+			[&]() {
+				compact.reset(new DMesh3(MeshComponents::None));
+				compact->CompactCopy(*sparse, false, false, false);
+				return (int64_t)sparse->TriangleCount();
+			});
+	benchmark_sink += compact->TriangleCount();
+	// removing triangles leaves bowtie vertices
+	check_valid(*compact, result, "CompactCopy", true);
+}
+
+void bench_compact_in_place(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	// remove every 64th vertex, so few vertices move and MapV is a hash map (see IDMap::ForRange).
+	// Removed vertices next to each other leave bowtie vertices
+	DMesh3Ptr sparse = copy_mesh(base);
+	for (int vid = 0; vid < sparse->MaxVertexID(); vid += 64) {
+		if (sparse->IsVertex(vid))
+			sparse->RemoveVertex(vid, true, false);
+	}
+
+	DMesh3Ptr mesh;
+	DMesh3::CompactInfo info;
+	measure(
+			result, opt, [&]() { mesh = copy_mesh(*sparse); },
+			[&]() {
+				info = mesh->CompactInPlace(true);
+				return (int64_t)mesh->VertexCount();
+			});
+	benchmark_sink += mesh->MaxVertexID();
+
+	check_valid(*mesh, result, "CompactInPlace", true);
+	check(mesh->IsCompact(), result, "CompactInPlace result is compact");
+	check(info.MapV.Type() == Sparse, result, "CompactInPlace MapV is sparse");
+	// vertices at or above the new vertex count were moved into the free slots
+	bool bMapOK = true;
+	for (int vid : sparse->VertexIndices()) {
+		if (vid < mesh->VertexCount())
+			continue;
+		int new_vid = info.MapV.GetNew(vid);
+		bMapOK = bMapOK && mesh->IsVertex(new_vid) && mesh->GetVertex(new_vid) == sparse->GetVertex(vid);
+	}
+	check(bMapOK, result, "CompactInPlace MapV maps moved vertices");
+}
+
+void bench_partitioned_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	DMesh3Ptr input = copy_sphere_with_attributes(base);
+
+	std::unique_ptr<PartitionedRemesher> remesher;
+	bool bComputed = true;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset(new PartitionedRemesher(input));
+				// four chunks, then a seam pass along their borders
+				remesher->MaxChunkTriangles = input->TriangleCount() / 4 + 1;
+				remesher->ChunkPasses = 2;
+				remesher->SeamPasses = 2;
+				remesher->TargetEdgeLength = fTargetLength;
+			},
+			[&]() {
+				bComputed = remesher->Compute() && bComputed;
+				return (int64_t)input->TriangleCount();
+			});
+
+	check(bComputed && remesher->Result != nullptr, result, "PartitionedRemesher::Compute() succeeded");
+	if (remesher->Result == nullptr)
+		return;
+	const DMesh3 &mesh = *remesher->Result;
+	benchmark_sink += mesh.TriangleCount();
+	check(remesher->ChunkCount == 4 && remesher->SeamTriangleCount > 0, result, "PartitionedRemesher made 4 chunks and a seam band");
+	check_valid(mesh, result, "PartitionedRemesher result");
+	check(mesh.Components() == input->Components(), result, "PartitionedRemesher result has the input attributes");
+	if (mesh.Components() != input->Components())
+		return;
+	// new vertices interpolate the attributes, and are moved (by much less than an edge) by
+	// smoothing and projection
+	double fMaxColorError = 0, fMaxUVError = 0;
+	for (int vid : mesh.VertexIndices()) {
+		Vector3f p = mesh.GetVertex(vid).cast<float>();
+		fMaxColorError = std::max(fMaxColorError, (double)(mesh.GetVertexColor(vid) - 0.5f * (p + Vector3f::Ones())).norm());
+		fMaxUVError = std::max(fMaxUVError, (double)(mesh.GetVertexUV(vid) - Vector2f(p.x(), p.y())).norm());
+	}
+	check(fMaxColorError < fTargetLength && fMaxUVError < 2 * fTargetLength, result, "PartitionedRemesher interpolates colors and UVs");
+	bool bGroupsOK = true;
+	for (int tid : mesh.TriangleIndices()) {
+		int gid = mesh.GetTriangleGroup(tid);
+		bGroupsOK = bGroupsOK && (gid == 1 || gid == 2);
+	}
+	check(bGroupsOK, result, "PartitionedRemesher keeps the triangle groups");
+}
+
+void bench_region_remesh(const DMesh3 &base, const benchmark_options &opt, benchmark_result &result) {
+	double fTargetLength = 0.75 * mean_edge_length(base);
+	MeshProjectionTargetPtr target = std::make_shared<MeshProjectionTarget>(copy_mesh(base));
+
+	// the region is the cap above z=0.5. A border vertex and an edge outside the region at it
+	// have user constraints, which the border lock must restore exactly
+	auto in_cap = [&](int tid) { return base.GetTriCentroid(tid).z() > 0.5; };
+	std::vector<int> cap;
+	for (int tid : base.TriangleIndices()) {
+		if (in_cap(tid))
+			cap.push_back(tid);
+	}
+	int border_vid = DMesh3::InvalidID, border_eid = DMesh3::InvalidID;
+	std::vector<unsigned char> outside_vertex(base.MaxVertexID(), 1);
+	for (int tid : cap) {
+		Index3i tv = base.GetTriangle(tid);
+		for (int j = 0; j < 3; ++j)
+			outside_vertex[tv[j]] = 0;
+	}
+	for (int tid : cap) {
+		Index3i tv = base.GetTriangle(tid);
+		for (int j = 0; j < 3 && border_eid == DMesh3::InvalidID; ++j) {
+			for (int eid : base.VtxEdgesItr(tv[j])) {
+				Index2i et = base.GetEdgeT(eid);
+				if (in_cap(et[0]) == false && in_cap(et[1]) == false) {
+					border_vid = tv[j];
+					border_eid = eid;
+					break;
+				}
+			}
+		}
+	}
+	VertexConstraint user_vertex(true, 5);
+	EdgeConstraint user_edge(EdgeRefineFlags::NoFlip);
+	user_edge.TrackingSetID = 3;
+	int pole_vid = 0;
+
+	DMesh3Ptr mesh;
+	MeshConstraintsPtr constraints;
+	std::unique_ptr<RegionRemesher> remesher;
+	measure(
+			result, opt,
+			[&]() {
+				remesher.reset();
+				mesh = copy_mesh(base);
+				constraints = std::make_shared<MeshConstraints>();
+				constraints->SetOrUpdateVertexConstraint(border_vid, user_vertex);
+				constraints->SetOrUpdateEdgeConstraint(border_eid, user_edge);
+				constraints->SetOrUpdateVertexConstraint(pole_vid, VertexConstraint::Pinned());
+				remesher.reset(new RegionRemesher(mesh, cap));
+				remesher->SetExternalConstraints(constraints);
+				remesher->SetTargetEdgeLength(fTargetLength);
+				remesher->SetProjectionTarget(target);
+				remesher->Precompute();
+			},
+			[&]() {
+				int64_t nTriangles = (int64_t)cap.size();
+				for (int k = 0; k < 2; ++k) {
+					Remesher::RemeshPassStats stats = remesher->BasicRemeshPass();
+					benchmark_sink += stats.ModifiedEdges();
+				}
+				return nTriangles;
+			});
+
+	check_valid(*mesh, result, "RegionRemesher result");
+	check(remesher->RegionTriangles().size() > cap.size(), result, "RegionRemesher refined the region");
+	bool bOutsideOK = true;
+	for (int vid : base.VertexIndices()) {
+		if (outside_vertex[vid])
+			bOutsideOK = bOutsideOK && mesh->IsVertex(vid) && mesh->GetVertex(vid) == base.GetVertex(vid);
+	}
+	check(bOutsideOK, result, "RegionRemesher does not change vertices outside the region");
+	check(constraints->GetVertexConstraint(border_vid).FixedSetID == VertexConstraint::InvalidSetID &&
+					constraints->GetEdgeConstraint(border_eid).NoModifications(),
+			result, "RegionRemesher locks the border");
+
+	remesher->ClearBorderConstraints();
+	const VertexConstraint &vc = constraints->GetVertexConstraint(border_vid);
+	const EdgeConstraint &ec = constraints->GetEdgeConstraint(border_eid);
+	check(constraints->Vertices.size() == 2 && constraints->Edges.size() == 1 &&
+					vc.Fixed && vc.FixedSetID == 5 && ec.refineFlags == EdgeRefineFlags::NoFlip && ec.TrackingSetID == 3 &&
+					constraints->GetVertexConstraint(pole_vid).Fixed && mesh->IsVertex(pole_vid),
+			result, "RegionRemesher restores the user constraints at the border");
+}
+
+const benchmark_case benchmark_cases[] = {
+	{ "append_triangle", bench_append_triangle },
+	{ "split_edge", bench_split_edge },
+	{ "flip_edge", bench_flip_edge },
+	{ "collapse_edge", bench_collapse_edge },
+	{ "find_edge", bench_find_edge },
+	{ "aabb_build", bench_aabb_build },
+	{ "aabb_nearest", bench_aabb_nearest },
+	{ "remesh_pass", bench_remesh_pass },
+	{ "parallel_refine", bench_parallel_refine },
+	{ "priority_remesh", bench_priority_remesh },
+	{ "active_set_remesh", bench_active_set_remesh },
+	{ "sizing_field_remesh", bench_sizing_field_remesh },
+	{ "step_remesh", bench_step_remesh },
+	{ "cotan_cache_remesh", bench_cotan_cache_remesh },
+	{ "warm_start_remesh", bench_warm_start_remesh },
+	{ "compact_copy", bench_compact_copy },
+	{ "compact_in_place", bench_compact_in_place },
+	{ "partitioned_remesh", bench_partitioned_remesh },
+	{ "region_remesh", bench_region_remesh },
+};
+
+std::string json_escape(const std::string &s) {
+	std::string out;
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if ((unsigned char)c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", (int)c);
+			out += buf;
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
+
+std::string compiler_name() {
+#if defined(__clang__)
+	return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+	return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc " + std::to_string(_MSC_VER);
+#else
+	return "unknown";
+#endif
+}
+
+std::string utc_timestamp() {
+	std::time_t now = std::time(nullptr);
+	char buf[32];
+	std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+	return buf;
+}
+
+void write_json(std::ostream &out, const benchmark_options &opt, const std::vector<benchmark_result> &results) {
+	out.precision(6);
+	out << "{\n";
+	out << "  \"format\": \"g3_benchmark\",\n";
+	out << "  \"version\": 1,\n";
+	out << "  \"timestamp\": \"" << utc_timestamp() << "\",\n";
+	out << "  \"compiler\": \"" << json_escape(compiler_name()) << "\",\n";
+	out << "  \"build_type\": \"" << json_escape(G3_BENCHMARK_BUILD_TYPE) << "\",\n";
+	out << "  \"threads\": " << parallel_concurrency() << ",\n";
+	out << "  \"repeat\": " << opt.repeat << ",\n";
+	out << "  \"results\": [";
+	for (size_t k = 0; k < results.size(); ++k) {
+		const benchmark_result &r = results[k];
+		out << (k == 0 ? "\n" : ",\n");
+		out << "    {\"name\": \"" << json_escape(r.name) << "\", \"mesh\": \"" << json_escape(r.mesh) << "\""
+			<< ", \"vertices\": " << r.vertices << ", \"triangles\": " << r.triangles << ", \"ops\": " << r.ops
+			<< ", \"min_ms\": " << r.min_ms() << ", \"median_ms\": " << r.median_ms() << ", \"mean_ms\": " << r.mean_ms()
+			<< ", \"max_ms\": " << r.max_ms() << ", \"stddev_ms\": " << r.stddev_ms() << ", \"mad_ms\": " << r.mad_ms()
+			<< ", \"ns_per_op\": " << (r.ops > 0 ? 1.0e6 * r.median_ms() / (double)r.ops : 0.0)
+			<< ", \"allocations\": " << r.allocations << ", \"allocated_bytes\": " << r.allocated_bytes << ", \"samples_ms\": [";
+		for (size_t j = 0; j < r.samples_ms.size(); ++j)
+			out << (j == 0 ? "" : ", ") << r.samples_ms[j];
+		out << "]}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+void print_usage() {
+	std::cerr << "usage: g3_benchmark [options]\n"
+				 "  --scale S       small, medium, large or all, may be repeated (default small and medium)\n"
+				 "  --filter TEXT   only run benchmarks whose name/mesh contains TEXT\n"
+				 "  --repeat N      timed runs per benchmark (default 5)\n"
+				 "  --warmup N      untimed runs per benchmark (default 1)\n"
+				 "  --queries N     FindNearestTriangle queries per run (default 50000)\n"
+				 "  --threads N     run g3 parallel loops on a private pool of N threads\n"
+				 "  --output FILE   write JSON results to FILE instead of stdout\n"
+				 "  --list          print the benchmark names and exit\n"
+				 "  --profile       print profiler scopes (with allocation counts) and remeshed mesh memory,\n"
+				 "                  timings include the profiling overhead\n"
+				 "\n"
+				 "regression gate, exits with status 1 if any benchmark regressed:\n"
+				 "  --baseline FILE         compare against the results in FILE\n"
+				 "  --gate G                time, allocations or all (default all)\n"
+				 "  --time-threshold PCT    allowed slowdown of the fastest run in percent (default 10)\n"
+				 "  --noise-sigmas K        also allow K times the combined run-to-run noise (default 3)\n"
+				 "  --alloc-threshold PCT   allowed increase in allocations in percent (default 2)\n";
+}
+
+bool parse_options(int argc, char **argv, benchmark_options &opt) {
+	bool bScaleSet = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool bHasValue = (i + 1 < argc);
+		if (arg == "--list") {
+			opt.list_only = true;
+		} else if (arg == "--profile") {
+			opt.profile = true;
+		} else if (arg == "--scale" && bHasValue) {
+			if (bScaleSet == false)
+				opt.scales.clear();
+			bScaleSet = true;
+			std::string scale = argv[++i];
+			if (scale == "all") {
+				opt.scales.clear();
+				for (const mesh_scale &s : mesh_scales)
+					opt.scales.push_back(s.name);
+			} else {
+				opt.scales.push_back(scale);
+			}
+		} else if (arg == "--filter" && bHasValue) {
+			opt.filter = argv[++i];
+		} else if (arg == "--repeat" && bHasValue) {
+			opt.repeat = std::max(1, atoi(argv[++i]));
+		} else if (arg == "--warmup" && bHasValue) {
+			opt.warmup = std::max(0, atoi(argv[++i]));
+		} else if (arg == "--queries" && bHasValue) {
+			opt.queries = std::max(1, atoi(argv[++i]));
+		} else if (arg == "--threads" && bHasValue) {
+			opt.threads = std::max(1, atoi(argv[++i]));
+		} else if (arg == "--output" && bHasValue) {
+			opt.output = argv[++i];
+		} else if (arg == "--baseline" && bHasValue) {
+			opt.baseline = argv[++i];
+		} else if (arg == "--gate" && bHasValue) {
+			std::string gate = argv[++i];
+			if (gate != "time" && gate != "allocations" && gate != "all")
+				return false;
+			opt.thresholds.check_time = (gate != "allocations");
+			opt.thresholds.check_allocations = (gate != "time");
+		} else if (arg == "--time-threshold" && bHasValue) {
+			opt.thresholds.time_ratio = std::max(0.0, atof(argv[++i]) / 100.0);
+		} else if (arg == "--noise-sigmas" && bHasValue) {
+			opt.thresholds.noise_sigmas = std::max(0.0, atof(argv[++i]));
+		} else if (arg == "--alloc-threshold" && bHasValue) {
+			opt.thresholds.allocation_ratio = std::max(0.0, atof(argv[++i]) / 100.0);
+		} else {
+			return false;
+		}
+	}
+	for (const std::string &scale : opt.scales) {
+		bool bKnown = false;
+		for (const mesh_scale &s : mesh_scales)
+			bKnown = bKnown || (scale == s.name);
+		if (bKnown == false) {
+			std::cerr << "unknown scale " << scale << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	benchmark_options opt;
+	if (parse_options(argc, argv, opt) == false) {
+		print_usage();
+		return 2;
+	}
+
+	if (opt.list_only) {
+		for (const benchmark_case &bc : benchmark_cases)
+			std::cout << bc.name << "\n";
+		return 0;
+	}
+
+	// read the baseline up-front so a bad path fails before the (slow) benchmarks run
+	std::vector<benchmark_record> baseline;
+	if (opt.baseline.empty() == false) {
+		std::string error;
+		if (read_benchmark_records(opt.baseline, baseline, error) == false) {
+			std::cerr << error << "\n";
+			return 2;
+		}
+	}
+
+	use_private_pool(opt.threads);
+
+	LocalProfiler profiler(opt.profile);
+	profiler_activation activate_profiler(opt.profile ? &profiler : nullptr);
+
+	std::vector<benchmark_result> results;
+	for (const mesh_scale &scale : mesh_scales) {
+		if (std::find(opt.scales.begin(), opt.scales.end(), scale.name) == opt.scales.end())
+			continue;
+		DMesh3 base(MeshComponents::None);
+		make_sphere(base, scale.slices, scale.stacks);
+		std::string mesh_name = std::string("sphere_") + scale.name;
+
+		for (const benchmark_case &bc : benchmark_cases) {
+			benchmark_result result;
+			result.name = bc.name;
+			result.mesh = mesh_name;
+			result.vertices = base.VertexCount();
+			result.triangles = base.TriangleCount();
+			if (opt.filter.empty() == false && (result.name + "/" + result.mesh).find(opt.filter) == std::string::npos)
+				continue;
+
+			std::cerr << result.name << "/" << result.mesh << " ..." << std::flush;
+			bc.run(base, opt, result);
+			std::cerr << " median " << result.median_ms() << " ms\n";
+			results.push_back(result);
+		}
+	}
+
+	if (opt.output.empty()) {
+		write_json(std::cout, opt, results);
+	} else {
+		std::ofstream out(opt.output);
+		if (!out) {
+			std::cerr << "cannot write " << opt.output << "\n";
+			return 1;
+		}
+		write_json(out, opt, results);
+	}
+
+	use_private_pool(0);
+	if (opt.profile) {
+		std::cerr << "profile:\n"
+				  << profiler.Report();
+	}
+
+	if (check_failures > 0)
+		std::cerr << check_failures << " check(s) failed\n";
+
+	if (opt.baseline.empty() == false) {
+		std::vector<benchmark_record> current;
+		for (const benchmark_result &r : results) {
+			benchmark_record record;
+			record.name = r.name;
+			record.mesh = r.mesh;
+			record.min_ms = r.min_ms();
+			record.median_ms = r.median_ms();
+			record.mad_ms = r.mad_ms();
+			record.allocations = r.allocations;
+			current.push_back(record);
+		}
+		std::cerr << "comparing with " << opt.baseline << "\n";
+		int nRegressions = print_comparison_report(std::cerr, compare_benchmarks(baseline, current, opt.thresholds));
+		if (nRegressions > 0)
+			return 1;
+	}
+	return (check_failures > 0) ? 1 : 0;
+}
@@ -32,15 +32,51 @@
 #include "remesh_operator.h"
 #include "scene/resources/surface_tool.h"
 
+#include "core/object/worker_thread_pool.h"
+
+#include <thread_pool.h>
+
+// run g3 parallel loops on Godot's WorkerThreadPool instead of a second set of threads.
+// Parallel loops nest (eg PartitionedRemesher chunks smooth in parallel), and a worker that
+// blocks on a nested group can starve the pool, so nested loops run inline on the worker.
+static thread_local bool g3_in_worker_pool_task = false;
+
+static void g3_worker_pool_task(void *p_userdata, uint32_t p_index) {
+	const std::function<void(int)> &task = *static_cast<const std::function<void(int)> *>(p_userdata);
+	bool was_in_task = g3_in_worker_pool_task;
+	g3_in_worker_pool_task = true;
+	task((int)p_index);
+	g3_in_worker_pool_task = was_in_task;
+}
+
+static void g3_worker_pool_dispatch(int p_tasks, const std::function<void(int)> &p_task) {
+	if (g3_in_worker_pool_task) {
+		for (int k = 0; k < p_tasks; ++k) {
+			p_task(k);
+		}
+		return;
+	}
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	WorkerThreadPool::GroupID group = pool->add_native_group_task(&g3_worker_pool_task,
+			const_cast<std::function<void(int)> *>(&p_task), p_tasks, p_tasks, true, "geometry3");
+	pool->wait_for_group_task_completion(group);
+}
+
 void initialize_geometry3_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
 	ClassDB::register_class<RemeshOperator>();
+
+	g3::parallel_backend backend;
+	backend.dispatch = &g3_worker_pool_dispatch;
+	backend.concurrency = WorkerThreadPool::get_singleton()->get_thread_count();
+	g3::set_parallel_backend(backend);
 }
 
 void uninitialize_geometry3_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+	g3::clear_parallel_backend();
 }
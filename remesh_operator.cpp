@@ -47,6 +47,8 @@
 #include <limits>
 #include <list>
 
+#include "core/io/file_access.h"
+#include "core/os/os.h"
 #include "scene/resources/surface_tool.h"
 #include "src/geometry/MeshboundaryLoop.h"
 #include "src/mesh/DMesh3.h"
@@ -231,7 +233,61 @@ DCurve3Ptr ExtractLoopV(g3::DMesh3Ptr mesh, std::vector<int> vertices) {
 //   }
 // }
 
-Array geometry3_process(Array p_mesh) {
+// RemeshPassStats as a Dictionary for GDScript
+Dictionary pass_stats_to_dictionary(const Remesher::RemeshPassStats &stats) {
+	typedef Remesher::ProcessResult ProcessResult;
+	Dictionary d;
+	d["collapses"] = stats.Collapses();
+	d["flips"] = stats.Flips();
+	d["splits"] = stats.Splits();
+	d["collapse_attempts"] = stats.CollapseAttempts;
+	d["flip_attempts"] = stats.FlipAttempts;
+	d["split_attempts"] = stats.SplitAttempts;
+
+	Dictionary results;
+	results["ok_collapsed"] = stats.Count(ProcessResult::Ok_Collapsed);
+	results["ok_flipped"] = stats.Count(ProcessResult::Ok_Flipped);
+	results["ok_split"] = stats.Count(ProcessResult::Ok_Split);
+	results["ignored_edge_is_fine"] = stats.Count(ProcessResult::Ignored_EdgeIsFine);
+	results["ignored_edge_is_fully_constrained"] = stats.Count(ProcessResult::Ignored_EdgeIsFullyConstrained);
+	results["failed_op_not_successful"] = stats.Count(ProcessResult::Failed_OpNotSuccessful);
+	results["failed_not_an_edge"] = stats.Count(ProcessResult::Failed_NotAnEdge);
+	d["results"] = results;
+
+	d["ops_time_ms"] = stats.OpsTimeMs;
+	d["smooth_time_ms"] = stats.SmoothTimeMs;
+	d["project_time_ms"] = stats.ProjectTimeMs;
+	d["total_time_ms"] = stats.TotalTimeMs;
+
+	d["vertex_count_before"] = stats.VertexCountBefore;
+	d["vertex_count_after"] = stats.VertexCountAfter;
+	d["vertex_delta"] = stats.VertexDelta();
+	d["triangle_count_before"] = stats.TriangleCountBefore;
+	d["triangle_count_after"] = stats.TriangleCountAfter;
+	d["triangle_delta"] = stats.TriangleDelta();
+	d["cancelled"] = stats.Cancelled;
+
+	if (stats.HasEdgeLengthStats) {
+		d["edge_count"] = stats.EdgeCount;
+		d["edge_length_min"] = stats.EdgeLengthMin;
+		d["edge_length_max"] = stats.EdgeLengthMax;
+		d["edge_length_mean"] = stats.EdgeLengthMean;
+		d["edges_shorter_than_min"] = stats.EdgesShorterThanMin;
+		d["edges_longer_than_max"] = stats.EdgesLongerThanMax;
+		PackedInt32Array histogram;
+		for (int k = 0; k < Remesher::RemeshPassStats::HistogramBins; ++k) {
+			histogram.push_back(stats.EdgeLengthHistogram[k]);
+		}
+		d["edge_length_histogram"] = histogram;
+	}
+	return d;
+}
+
+// if r_pass_stats is given, one Dictionary per remesh pass is appended to it.
+// If p_profiler is given, the stages and remesh passes are timed with it, and the pass
+// stats include the edge-length distribution.
+Array geometry3_process(Array p_mesh, Array *r_pass_stats = nullptr, LocalProfiler *p_profiler = nullptr) {
+	profile_scope ingest_scope(p_profiler, "ingest");
 	g3::DMesh3Ptr g3_mesh = std::make_shared<DMesh3>();
 	::Vector<::Vector3> vertex_array = p_mesh[Mesh::ARRAY_VERTEX];
 	::Vector<::Vector3> normal_array = p_mesh[Mesh::ARRAY_NORMAL];
@@ -309,7 +365,13 @@ Array geometry3_process(Array p_mesh) {
 						index_array[index_i + 2]);
 		g3_mesh->AppendTriangle(new_tri);
 	}
+	ingest_scope.Close();
+
+	profile_scope remesh_scope(p_profiler, "remesh");
 	Remesher r(g3_mesh);
+	r.Profiler = p_profiler;
+	// the edge-length distribution is a diagnostic, only computed when profiling
+	r.ComputeEdgeLengthStats = (p_profiler != nullptr);
 	// broke compactinplace
 	// g3_mesh->CompactInPlace();
 	g3::MeshConstraintsPtr cons = std::make_shared<MeshConstraints>();
@@ -327,12 +389,20 @@ Array geometry3_process(Array p_mesh) {
 	//  r.SetTargetEdgeLength(avg_edge_len);
 	 r.Precompute();
 	 for (int k = 0; k < iterations; ++k) {
-	 	r.BasicRemeshPass();
+	 	Remesher::RemeshPassStats stats = r.BasicRemeshPass();
+	 	if (r_pass_stats) {
+	 		Dictionary d = pass_stats_to_dictionary(stats);
+	 		d["pass"] = k;
+	 		r_pass_stats->push_back(d);
+	 	}
 	 	print_line("remesh pass " + itos(k));
 	 }
 	// print_line("remesh done");
 	// RemoveFinTriangles(g3_mesh, true);
 	// std::cout << g3_mesh->MeshInfoString();
+	remesh_scope.Close();
+
+	profile_scope export_scope(p_profiler, "export");
 	vertex_array.clear();
 	index_array.clear();
 	uv1_array.clear();
@@ -405,16 +475,81 @@ Ref<Mesh> RemeshOperator::process(Ref<Mesh> p_mesh) {
 	if (p_mesh.is_null()) {
 		return Ref<Mesh>(); // Return an empty ArrayMesh if input is invalid
 	}
+	// the G3_TRACE_FILE environment variable enables tracing without touching the scene
+	String trace_file = trace_path;
+	if (trace_file.is_empty()) {
+		trace_file = OS::get_singleton()->get_environment("G3_TRACE_FILE");
+	}
+	bool tracing = !trace_file.is_empty();
+	bool use_profiler = profiling_enabled || tracing;
+	if (use_profiler) {
+		profiler.Clear();
+		profiler.SetRecordTrace(tracing);
+	}
+	// the profiler is passed down explicitly, and made Active() on this thread only for
+	// code that is not handed one (eg AABBTree.Build), as concurrent process() calls of
+	// other operators must not record into it
+	g3::LocalProfiler *active_profiler = use_profiler ? &profiler : nullptr;
+	g3::thread_profiler_activation activate_profiler(active_profiler);
+	g3::profile_scope process_scope(active_profiler, "RemeshOperator.process");
+
+	pass_stats.clear();
 	Ref<ArrayMesh> array_mesh = memnew(ArrayMesh);
 	int surface_count = p_mesh->get_surface_count();
 	for (int i = 0; i < surface_count; ++i) {
+		g3::profile_scope surface_scope(active_profiler, "surface", i);
 		Array surface_arrays = p_mesh->surface_get_arrays(i);
-		surface_arrays = g3::geometry3_process(surface_arrays);
+		Array surface_pass_stats;
+		surface_arrays = g3::geometry3_process(surface_arrays, &surface_pass_stats, active_profiler);
+		for (int k = 0; k < surface_pass_stats.size(); ++k) {
+			Dictionary d = surface_pass_stats[k];
+			d["surface"] = i;
+			pass_stats.push_back(d);
+		}
 		array_mesh->add_surface_from_arrays(Mesh::PRIMITIVE_TRIANGLES, surface_arrays);
 	}
+	process_scope.Close();
+
+	if (tracing) {
+		Ref<FileAccess> file = FileAccess::open(trace_file, FileAccess::WRITE);
+		ERR_FAIL_COND_V_MSG(file.is_null(), array_mesh, "Cannot write remesh trace to " + trace_file);
+		file->store_string(String::utf8(profiler.ChromeTraceJSON().c_str()));
+	}
 	return array_mesh;
 }
 
+void RemeshOperator::set_profiling_enabled(bool p_enabled) {
+	profiling_enabled = p_enabled;
+}
+
+bool RemeshOperator::is_profiling_enabled() const {
+	return profiling_enabled;
+}
+
+String RemeshOperator::get_profile_report() const {
+	return String(profiler.Report().c_str());
+}
+
+Array RemeshOperator::get_pass_stats() const {
+	return pass_stats;
+}
+
+void RemeshOperator::set_trace_path(const String &p_path) {
+	trace_path = p_path;
+}
+
+String RemeshOperator::get_trace_path() const {
+	return trace_path;
+}
+
 void RemeshOperator::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("remesh", "mesh"), &RemeshOperator::process);
+	ClassDB::bind_method(D_METHOD("set_profiling_enabled", "enabled"), &RemeshOperator::set_profiling_enabled);
+	ClassDB::bind_method(D_METHOD("is_profiling_enabled"), &RemeshOperator::is_profiling_enabled);
+	ClassDB::bind_method(D_METHOD("get_profile_report"), &RemeshOperator::get_profile_report);
+	ClassDB::bind_method(D_METHOD("get_pass_stats"), &RemeshOperator::get_pass_stats);
+	ClassDB::bind_method(D_METHOD("set_trace_path", "path"), &RemeshOperator::set_trace_path);
+	ClassDB::bind_method(D_METHOD("get_trace_path"), &RemeshOperator::get_trace_path);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "profiling_enabled"), "set_profiling_enabled", "is_profiling_enabled");
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "trace_path", PROPERTY_HINT_SAVE_FILE, "*.json"), "set_trace_path", "get_trace_path");
 }
@@ -34,14 +34,35 @@
 #include "core/object/ref_counted.h"
 #include "scene/resources/mesh.h"
 
+#include "profile_util.h"
+
 class RemeshOperator : public RefCounted {
 	GDCLASS(RemeshOperator, RefCounted);
 
+	bool profiling_enabled = false;
+	String trace_path;
+	Array pass_stats;
+	g3::LocalProfiler profiler;
+
 protected:
 	static void _bind_methods();
 
 public:
 	Ref<Mesh> RemeshOperator::process(Ref<Mesh> p_mesh);
+
+	// time ingest/remesh/export of each process() call, see get_profile_report()
+	void set_profiling_enabled(bool p_enabled);
+	bool is_profiling_enabled() const;
+	String get_profile_report() const;
+
+	// one Dictionary per remesh pass of the last process() call, with op counts,
+	// results by type, phase times, vertex/triangle deltas and edge-length distribution
+	Array get_pass_stats() const;
+
+	// if set (or if the G3_TRACE_FILE environment variable is set), each process() call
+	// writes a Chrome trace-event JSON timeline to this path, see LocalProfiler::ChromeTraceJSON()
+	void set_trace_path(const String &p_path);
+	String get_trace_path() const;
 	RemeshOperator() {}
 };
 
@@ -40,6 +40,7 @@
 #include <Wm5PolyhedralMassProperties.h>
 
 #include <atomic_util.h>
+#include <parallel_util.h>
 #include <algorithm>
 #include <limits>
 
@@ -71,23 +72,22 @@ const Real *get_value(const Real *pBuffer, unsigned int nIndex,
 }
 
 double Area(const IPackedMesh *pMesh) {
-	// was using this in tbb version but we removed tbb...
-	// atomic_accumulator<double> area(0.0);
-
 	const float *pVertices = pMesh->GetPositionsBuffer();
 	const unsigned int *pTriangles = pMesh->GetIndicesBuffer();
-	unsigned int nTriangles = pMesh->GetTriangleCount();
-
-	double area = 0;
-	for (unsigned int ti = 0; ti < nTriangles; ++ti) {
-		auto pTri = get_value(pTriangles, (unsigned int)ti);
-		double a = Area(f2d(Vector3f(get_value(pVertices, pTri[0]))),
-				f2d(Vector3f(get_value(pVertices, pTri[1]))),
-				f2d(Vector3f(get_value(pVertices, pTri[2]))));
-		area += a;
-	}
-
-	return area;
+	int nTriangles = (int)pMesh->GetTriangleCount();
+
+	// block-ordered reduction, so the sum does not depend on the thread count
+	return parallel_reduce(
+			0, nTriangles, 0.0, [&](int a, int b, double area) {
+				for (int ti = a; ti < b; ++ti) {
+					auto pTri = get_value(pTriangles, (unsigned int)ti);
+					area += Area(f2d(Vector3f(get_value(pVertices, pTri[0]))),
+							f2d(Vector3f(get_value(pVertices, pTri[1]))),
+							f2d(Vector3f(get_value(pVertices, pTri[2]))));
+				}
+				return area;
+			},
+			[](double x, double y) { return x + y; });
 }
 
 class PackedMeshVertexSource : public Wml::VertexSource<double> {
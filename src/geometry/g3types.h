@@ -170,6 +170,9 @@ typedef std::shared_ptr<IProjectionTarget> IProjectionTargetPtr;
 class MeshProjectionTarget;
 typedef std::shared_ptr<MeshProjectionTarget> MeshProjectionTargetPtr;
 
+class ISizingField;
+typedef std::shared_ptr<ISizingField> ISizingFieldPtr;
+
 class IMeshSpatial;
 typedef std::shared_ptr<IMeshSpatial> IMeshSpatialPtr;
 
@@ -37,6 +37,7 @@
 #include <map>
 #include <string>
 
+#include <IDMap.h>
 #include <VectorUtil.h>
 #include <dvector.h>
 #include <g3Debug.h>
@@ -209,7 +210,13 @@ protected:
 	int timestamp = 0;
 	int shape_timestamp = 0;
 
+	// true between BeginConcurrentEdits() and EndConcurrentEdits()
+	bool concurrent_edits = false;
+
 	int max_group_id = 0;
+	// HasTriangleGroups() compares buffer sizes, so it cannot tell whether a mesh without
+	// triangles has groups. AppendTriangle() then only adds groups if this is set
+	bool want_triangle_groups = false;
 
 	///// <summary>
 	///// Support attaching arbitrary data to mesh.
@@ -238,6 +245,7 @@ public:
 		triangles_refcount = refcount_vector();
 		if (bWantTriGroups)
 			triangle_groups = dvector<int>();
+		want_triangle_groups = bWantTriGroups;
 		max_group_id = 0;
 
 		edges = dvector<int>();
@@ -449,9 +457,10 @@ protected:
 	}
 
 public:
-	// TODO make this work
+	// MapV maps old vertex IDs to new ones. Storage (dense array or hash map)
+	// is picked by IDMap::ForRange based on how many IDs are remapped.
 	struct CompactInfo {
-		std::map<int, int> MapV;
+		IDMap<int> MapV;
 	};
 
 	CompactInfo CompactCopy(const DMesh3 &copy, bool bNormals = true, bool bColors = true, bool bUVs = true) {
@@ -476,30 +485,28 @@ public:
 		colors = dvector<float>();
 		uv = dvector<float>();
 		triangle_groups = dvector<int>();
+		want_triangle_groups = copy.HasTriangleGroups();
 
 		// [TODO] if we ksome of these were dense we could copy directly...
 
 		NewVertexInfo vinfo;
-		std::vector<int> mapV;
-		mapV.resize(copy.MaxVertexID());
-		for (int vid : VertexIndices()) {
+		CompactInfo ci;
+		ci.MapV = IDMap<int>::ForRange(copy.MaxVertexID(), copy.VertexCount(), copy.VertexCount());
+		for (int vid : copy.VertexIndices()) {
 			copy.GetVertex(vid, vinfo, bNormals, bColors, bUVs);
-			mapV[vid] = AppendVertex(vinfo);
+			ci.MapV.SetMap(vid, AppendVertex(vinfo));
 		}
 
 		// [TODO] would be much faster to explicitly copy triangle & edge data structures!!
-		for (int tid : TriangleIndices()) {
+		for (int tid : copy.TriangleIndices()) {
 			Index3i t = copy.GetTriangle(tid);
-			t = Index3i(mapV[t.x()], mapV[t.y()], mapV[t.z()]);
+			t = Index3i(ci.MapV.GetNew(t.x()), ci.MapV.GetNew(t.y()), ci.MapV.GetNew(t.z()));
 			int g = (copy.HasTriangleGroups()) ? copy.GetTriangleGroup(tid) : InvalidID;
 			AppendTriangle(t, g);
 			max_group_id = std::max(max_group_id, g + 1);
 		}
 
-		// return CompactInfo() {
-		//     MapV = IndexMap(mapV, this.MaxVertexID)
-		// };
-		return CompactInfo();
+		return ci;
 	}
 
 	void Copy(const DMesh3 &copy, bool bNormals = true, bool bColors = true, bool bUVs = true) {
@@ -516,8 +523,8 @@ public:
 		triangles = dvector<int>(copy.triangles);
 		triangle_edges = dvector<int>(copy.triangle_edges);
 		triangles_refcount = refcount_vector(copy.triangles_refcount);
-		if (copy.HasTriangleGroups())
-			triangle_groups = dvector<int>(copy.triangle_groups);
+		triangle_groups = (copy.HasTriangleGroups()) ? dvector<int>(copy.triangle_groups) : dvector<int>();
+		want_triangle_groups = copy.HasTriangleGroups();
 		max_group_id = copy.max_group_id;
 
 		edges = dvector<int>(copy.edges);
@@ -571,6 +578,8 @@ public:
 
 protected:
 	void updateTimeStamp(bool bShapeChange) {
+		if (concurrent_edits)
+			return; // EndConcurrentEdits() updates once for all edits
 		timestamp++;
 		if (bShapeChange)
 			shape_timestamp++;
@@ -683,6 +692,25 @@ public:
 		updateTimeStamp(true);
 	}
 
+	/// <summary>
+	/// SetVertex() without the timestamp update, so that different vertices can be
+	/// set from concurrent threads. Call UpdateShapeTimestamp() once all threads are done.
+	/// </summary>
+	void SetVertexConcurrent(int vID, const Vector3d &vNewPos) {
+		gDevAssert(IsFinite(vNewPos));
+		debug_check_is_vertex(vID);
+
+		int i = 3 * vID;
+		vertices[i] = vNewPos.x();
+		vertices[i + 1] = vNewPos.y();
+		vertices[i + 2] = vNewPos.z();
+	}
+
+	// record a change of vertex positions made with SetVertexConcurrent()
+	void UpdateShapeTimestamp() {
+		updateTimeStamp(true);
+	}
+
 	Vector3f GetVertexNormal(int vID) const {
 		if (HasVertexNormals() == false)
 			return Vector3f::UnitY();
@@ -863,7 +891,7 @@ public:
 	// }
 
 	int GetTriangleGroup(int tID) const {
-		return (HasTriangleGroups()) ? -1 : (triangles_refcount.isValid(tID) ? triangle_groups[tID] : 0);
+		return (HasTriangleGroups() == false) ? -1 : (triangles_refcount.isValid(tID) ? triangle_groups[tID] : 0);
 	}
 
 	void SetTriangleGroup(int tid, int group_id) {
@@ -1198,31 +1226,7 @@ public:
 	/// </summary>
 	int AppendVertex(const NewVertexInfo &info) {
 		int vid = vertices_refcount.allocate();
-		int i = 3 * vid;
-		vertices.insertAt(info.v[2], i + 2);
-		vertices.insertAt(info.v[1], i + 1);
-		vertices.insertAt(info.v[0], i);
-
-		if (info.bHaveN) {
-			Vector3f n = (info.bHaveN) ? info.n : Vector3f::UnitY();
-			normals.insertAt(n[2], i + 2);
-			normals.insertAt(n[1], i + 1);
-			normals.insertAt(n[0], i);
-		}
-
-		if (info.bHaveC) {
-			Vector3f c = (info.bHaveC) ? info.c : Vector3f::Ones();
-			colors.insertAt(c[2], i + 2);
-			colors.insertAt(c[1], i + 1);
-			colors.insertAt(c[0], i);
-		}
-
-		if (info.bHaveUV) {
-			Vector2f u = (info.bHaveUV) ? info.uv : Vector2f::Zero();
-			int j = 2 * vid;
-			uv.insertAt(u[1], j + 1);
-			uv.insertAt(u[0], j);
-		}
+		insert_vertex_data(vid, info);
 
 		allocate_edges_list(vid);
 
@@ -1233,54 +1237,8 @@ public:
 	/// <summary>
 	/// copy vertex fromVID from existing source mesh, returns vid
 	/// </summary>
-	int AppendVertex(DMesh3 from, int fromVID) {
-		int bi = 3 * fromVID;
-
-		int vid = vertices_refcount.allocate();
-		int i = 3 * vid;
-		vertices.insertAt(from.vertices[bi + 2], i + 2);
-		vertices.insertAt(from.vertices[bi + 1], i + 1);
-		vertices.insertAt(from.vertices[bi], i);
-		if (HasVertexNormals()) {
-			if (from.HasVertexNormals()) {
-				normals.insertAt(from.normals[bi + 2], i + 2);
-				normals.insertAt(from.normals[bi + 1], i + 1);
-				normals.insertAt(from.normals[bi], i);
-			} else {
-				normals.insertAt(0, i + 2);
-				normals.insertAt(1, i + 1); // y-up
-				normals.insertAt(0, i);
-			}
-		}
-
-		if (HasVertexColors()) {
-			if (from.HasVertexColors()) {
-				colors.insertAt(from.colors[bi + 2], i + 2);
-				colors.insertAt(from.colors[bi + 1], i + 1);
-				colors.insertAt(from.colors[bi], i);
-			} else {
-				colors.insertAt(1, i + 2);
-				colors.insertAt(1, i + 1); // white
-				colors.insertAt(1, i);
-			}
-		}
-
-		if (HasVertexUVs()) {
-			int j = 2 * vid;
-			if (from.HasVertexUVs()) {
-				int bj = 2 * fromVID;
-				uv.insertAt(from.uv[bj + 1], j + 1);
-				uv.insertAt(from.uv[bj], j);
-			} else {
-				uv.insertAt(0, j + 1);
-				uv.insertAt(0, j);
-			}
-		}
-
-		allocate_edges_list(vid);
-
-		updateTimeStamp(true);
-		return vid;
+	int AppendVertex(const DMesh3 &from, int fromVID) {
+		return AppendVertex(from.GetVertexAll(fromVID));
 	}
 
 	/// <summary>
@@ -1297,36 +1255,53 @@ public:
 		if (bOK == false)
 			return MeshResult::Failed_CannotAllocateVertex;
 
+		insert_vertex_data(vid, info);
+
+		allocate_edges_list(vid);
+
+		updateTimeStamp(true);
+		return MeshResult::Ok;
+	}
+
+	// Write the position and attributes of new vertex vid. It gets the attributes of the mesh
+	// (defaults for the ones info does not have), or the ones of info if it is the first vertex.
+	// These are checked before the position buffer grows, as HasVertexNormals() etc compare sizes
+	void insert_vertex_data(int vid, const NewVertexInfo &info) {
+		bool bFirst = (vertices.size() == 0);
+		bool bNormals = (bFirst) ? info.bHaveN : HasVertexNormals();
+		bool bColors = (bFirst) ? info.bHaveC : HasVertexColors();
+		bool bUVs = (bFirst) ? info.bHaveUV : HasVertexUVs();
+
 		int i = 3 * vid;
 		vertices.insertAt(info.v[2], i + 2);
 		vertices.insertAt(info.v[1], i + 1);
 		vertices.insertAt(info.v[0], i);
 
-		if (HasVertexNormals()) {
+		if (bNormals) {
 			Vector3f n = (info.bHaveN) ? info.n : Vector3f::UnitY();
 			normals.insertAt(n[2], i + 2);
 			normals.insertAt(n[1], i + 1);
 			normals.insertAt(n[0], i);
 		}
 
-		if (HasVertexColors()) {
+		if (bColors) {
 			Vector3f c = (info.bHaveC) ? info.c : Vector3f::Ones();
 			colors.insertAt(c[2], i + 2);
 			colors.insertAt(c[1], i + 1);
 			colors.insertAt(c[0], i);
 		}
 
-		if (HasVertexUVs()) {
+		if (bUVs) {
 			Vector2f u = (info.bHaveUV) ? info.uv : Vector2f::Zero();
 			int j = 2 * vid;
 			uv.insertAt(u[1], j + 1);
 			uv.insertAt(u[0], j);
 		}
+	}
 
-		allocate_edges_list(vid);
-
-		updateTimeStamp(true);
-		return MeshResult::Ok;
+	// true if a triangle added now gets a group, checked before the triangle buffer grows
+	bool new_triangle_has_group() const {
+		return (triangles.size() == 0) ? want_triangle_groups : HasTriangleGroups();
 	}
 
 	virtual void BeginUnsafeVerticesInsert() {
@@ -1359,12 +1334,13 @@ public:
 		}
 
 		// now safe to insert triangle
+		bool bGroups = new_triangle_has_group();
 		int tid = triangles_refcount.allocate();
 		int i = 3 * tid;
 		triangles.insertAt(tv[2], i + 2);
 		triangles.insertAt(tv[1], i + 1);
 		triangles.insertAt(tv[0], i);
-		if (HasTriangleGroups()) {
+		if (bGroups) {
 			triangle_groups.insertAt(gid, tid);
 			max_group_id = std::max(max_group_id, gid + 1);
 		}
@@ -1423,11 +1399,12 @@ public:
 			return MeshResult::Failed_CannotAllocateTriangle;
 
 		// now safe to insert triangle
+		bool bGroups = new_triangle_has_group();
 		int i = 3 * tid;
 		triangles.insertAt(tv[2], i + 2);
 		triangles.insertAt(tv[1], i + 1);
 		triangles.insertAt(tv[0], i);
-		if (HasTriangleGroups()) {
+		if (bGroups) {
 			triangle_groups.insertAt(gid, tid);
 			max_group_id = std::max(max_group_id, gid + 1);
 		}
@@ -1452,6 +1429,106 @@ public:
 		triangles_refcount.rebuild_free_list();
 	}
 
+	/// <summary>
+	/// Concurrent edits. Between BeginConcurrentEdits() and EndConcurrentEdits(),
+	/// SplitEdge(), FlipEdge(), CollapseEdge() and SetVertex() may be called from several
+	/// threads at once, as long as
+	///   - each thread only reads and writes the neighbourhood of its own edits, ie an edit
+	///     of edge [a,b] must not run at the same time as an edit whose vertices overlap
+	///     a, b or their one-rings
+	///   - each edit runs inside a ConcurrentEditScope for a slot in [0,nSlots), and each
+	///     slot allocates at most the given number of new vertices/triangles/edges
+	///   - all edits together make at most nEdgeListInserts insertions into vertex-edge lists
+	/// IDs are reserved per slot up front, and IDs freed by the edits are only returned to
+	/// the free lists by EndConcurrentEdits() (in slot order), so the resulting mesh does not
+	/// depend on the order in which the slots ran. Timestamps are updated once, at the end.
+	/// </summary>
+	void BeginConcurrentEdits(int nSlots, int nVerticesPerSlot, int nTrianglesPerSlot, int nEdgesPerSlot, int nEdgeListInserts) {
+		gDevAssert(concurrent_edits == false);
+		bool bNormals = HasVertexNormals(), bColors = HasVertexColors(), bUVs = HasVertexUVs(), bGroups = HasTriangleGroups();
+		vertices_refcount.begin_concurrent(nSlots, nVerticesPerSlot);
+		triangles_refcount.begin_concurrent(nSlots, nTrianglesPerSlot);
+		edges_refcount.begin_concurrent(nSlots, nEdgesPerSlot);
+
+		// size the buffers for all reserved IDs, so that appends become plain writes
+		int NV = MaxVertexID(), NT = MaxTriangleID(), NE = MaxEdgeID();
+		grow_buffer(vertices, 3 * NV);
+		if (bNormals)
+			grow_buffer(normals, 3 * NV);
+		if (bColors)
+			grow_buffer(colors, 3 * NV);
+		if (bUVs)
+			grow_buffer(uv, 2 * NV);
+		grow_buffer(triangles, 3 * NT);
+		grow_buffer(triangle_edges, 3 * NT);
+		if (bGroups)
+			grow_buffer(triangle_groups, NT);
+		grow_buffer(edges, 4 * NE);
+		vertex_edges.Resize(NV);
+		vertex_edges.BeginConcurrent(nSlots * nVerticesPerSlot, nEdgeListInserts);
+
+		concurrent_edits = true;
+	}
+
+	void EndConcurrentEdits() {
+		gDevAssert(concurrent_edits == true);
+		bool bNormals = HasVertexNormals(), bColors = HasVertexColors(), bUVs = HasVertexUVs(), bGroups = HasTriangleGroups();
+		vertex_edges.EndConcurrent();
+		vertices_refcount.end_concurrent();
+		triangles_refcount.end_concurrent();
+		edges_refcount.end_concurrent();
+
+		// drop the space of trailing reserved IDs that were not used
+		int NV = MaxVertexID(), NT = MaxTriangleID(), NE = MaxEdgeID();
+		vertices.resize(3 * NV);
+		if (bNormals)
+			normals.resize(3 * NV);
+		if (bColors)
+			colors.resize(3 * NV);
+		if (bUVs)
+			uv.resize(2 * NV);
+		triangles.resize(3 * NT);
+		triangle_edges.resize(3 * NT);
+		if (bGroups)
+			triangle_groups.resize(NT);
+		edges.resize(4 * NE);
+
+		concurrent_edits = false;
+		updateTimeStamp(true);
+	}
+
+	bool InConcurrentEdits() const {
+		return concurrent_edits;
+	}
+
+	/// <summary>
+	/// Binds the calling thread to a concurrent-edit slot for the lifetime of the scope
+	/// </summary>
+	class ConcurrentEditScope {
+	public:
+		explicit ConcurrentEditScope(int slot) :
+				prev_slot(refcount_vector::concurrent_slot()) {
+			refcount_vector::concurrent_slot() = slot;
+		}
+		~ConcurrentEditScope() {
+			refcount_vector::concurrent_slot() = prev_slot;
+		}
+		ConcurrentEditScope(const ConcurrentEditScope &copy) = delete;
+		const ConcurrentEditScope &operator=(const ConcurrentEditScope &copy) = delete;
+
+	protected:
+		int prev_slot;
+	};
+
+protected:
+	template <typename T>
+	static void grow_buffer(dvector<T> &buffer, size_t nSize) {
+		if (buffer.size() < nSize)
+			buffer.resize(nSize);
+	}
+
+public:
+
 	void EnableVertexNormals(Vector3f initial_normal) {
 		if (HasVertexNormals())
 			return;
@@ -1503,6 +1580,7 @@ public:
 	}
 
 	void EnableTriangleGroups(int initial_group = 0) {
+		want_triangle_groups = true;
 		if (HasTriangleGroups())
 			return;
 		triangle_groups = dvector<int>();
@@ -1513,6 +1591,7 @@ public:
 		max_group_id = 0;
 	}
 	void DiscardTriangleGroups() {
+		want_triangle_groups = false;
 		triangle_groups = dvector<int>();
 		max_group_id = 0;
 	}
@@ -2371,20 +2450,37 @@ public:
 		updateTimeStamp(true);
 	}
 
+	/// <summary>
+	/// Re-linearize the vertex-edge lists, so one-ring traversal is sequential in
+	/// memory again after many topology changes. Indices and list order are unchanged.
+	/// </summary>
+	void CompactVertexEdges() {
+		vertex_edges.Compact();
+	}
+
+	small_list_set::memory_stats VertexEdgesMemoryStats() const {
+		return vertex_edges.MemoryStats();
+	}
+
+	// VertexEdgesMemoryStats().fragmentation, from counters kept by the lists. O(1)
+	double VertexEdgesFragmentation() const {
+		return vertex_edges.LinkFragmentation();
+	}
+
 	/// <summary>
 	/// Compact mesh in-place, by moving vertices around and rewriting indices.
 	/// Should be faster if the amount of compacting is not too significant, and
 	/// is useful in some places.
 	/// [TODO] vertex_edges is not compacted. does not affect indices, but does keep memory.
 	///
-	/// If bComputeCompactInfo=false, the returned CompactInfo is not initialized
+	/// If bComputeCompactInfo=false, the returned CompactInfo is not initialized.
+	/// Otherwise MapV contains only the vertices that were moved, other vertex IDs are unchanged.
 	/// </summary>
-	// [RMS] disabled for now
 	CompactInfo CompactInPlace(bool bComputeCompactInfo = false) {
-		// IndexMap mapV = (bComputeCompactInfo) ? IndexMap(MaxVertexID, VertexCount) : nullptr;
-		std::map<int, int> mapV;
 		CompactInfo ci = CompactInfo();
-		ci.MapV = mapV;
+		// at most one vertex is moved per free slot below MaxVertexID
+		if (bComputeCompactInfo)
+			ci.MapV = IDMap<int>::ForRange(MaxVertexID(), MaxVertexID(), MaxVertexID() - VertexCount());
 
 		// find first free vertex, and last used vertex
 		int iLastV = MaxVertexID() - 1, iCurV = 0;
@@ -2393,7 +2489,7 @@ public:
 		while (vertices_refcount.isValidUnsafe(iCurV))
 			iCurV++;
 
-		dvector<short> vref = vertices_refcount.RawRefCounts();
+		dvector<short> &vref = vertices_refcount.RawRefCounts();
 
 		while (iCurV < iLastV) {
 			int kc = iCurV * 3, kl = iLastV * 3;
@@ -2436,7 +2532,7 @@ public:
 			vertex_edges.Move(iLastV, iCurV);
 
 			if (bComputeCompactInfo)
-				mapV[iLastV] = iCurV;
+				ci.MapV.SetMap(iLastV, iCurV);
 
 			// move cur forward one, last back one, and  then search for next valid
 			iLastV--;
@@ -2468,7 +2564,7 @@ public:
 		while (triangles_refcount.isValidUnsafe(iCurT))
 			iCurT++;
 
-		dvector<short> tref = triangles_refcount.RawRefCounts();
+		dvector<short> &tref = triangles_refcount.RawRefCounts();
 
 		while (iCurT < iLastT) {
 			int kc = iCurT * 3, kl = iLastT * 3;
@@ -2516,7 +2612,7 @@ public:
 		while (edges_refcount.isValidUnsafe(iCurE))
 			iCurE++;
 
-		dvector<short> eref = edges_refcount.RawRefCounts();
+		dvector<short> &eref = edges_refcount.RawRefCounts();
 
 		while (iCurE < iLastE) {
 			int kc = iCurE * 4, kl = iLastE * 4;
@@ -2843,8 +2939,9 @@ public:
 			replace_tri_vertex(t0, b, f);
 
 			// add second triangle
+			bool bGroups = HasTriangleGroups();
 			int t2 = add_triangle_only(f, b, c, InvalidID, InvalidID, InvalidID);
-			if (HasTriangleGroups())
+			if (bGroups)
 				triangle_groups.insertAt(triangle_groups[t0], t2);
 
 			// rewrite edge bc, create edge af
@@ -2908,9 +3005,10 @@ public:
 			replace_tri_vertex(t1, b, f);
 
 			// add two triangles to close holes we just created
+			bool bGroups = HasTriangleGroups();
 			int t2 = add_triangle_only(f, b, c, InvalidID, InvalidID, InvalidID);
 			int t3 = add_triangle_only(f, d, b, InvalidID, InvalidID, InvalidID);
-			if (HasTriangleGroups()) {
+			if (bGroups) {
 				triangle_groups.insertAt(triangle_groups[t0], t2);
 				triangle_groups.insertAt(triangle_groups[t1], t3);
 			}
@@ -3539,6 +3637,7 @@ public:
 		set_triangle_edges(tid, te[0], ebC, eaC);
 
 		// add two triangles
+		bool bGroups = HasTriangleGroups();
 		int t1 = add_triangle_only(tv[1], tv[2], center, te[1], ecC, ebC);
 		int t2 = add_triangle_only(tv[2], tv[0], center, te[2], eaC, ecC);
 
@@ -3552,7 +3651,7 @@ public:
 		set_edge_triangles(ecC, t1, t2);
 
 		// transfer groups
-		if (HasTriangleGroups()) {
+		if (bGroups) {
 			int g = triangle_groups[tid];
 			triangle_groups.insertAt(g, t1);
 			triangle_groups.insertAt(g, t2);
@@ -3588,6 +3687,74 @@ public:
 		}
 	}
 
+	/// <summary>
+	/// Memory used by one internal buffer. live_bytes is the part holding data of
+	/// existing elements, the rest is spare block capacity, slots of deleted elements
+	/// and (for vertex_edges) unused list slots and free blocks.
+	/// </summary>
+	struct BufferMemory {
+		const char *name;
+		size_t bytes;
+		size_t live_bytes;
+
+		size_t wasted_bytes() const { return bytes - std::min(bytes, live_bytes); }
+	};
+
+	struct MemoryReport {
+		std::vector<BufferMemory> Buffers;
+
+		size_t TotalBytes() const {
+			size_t n = 0;
+			for (const BufferMemory &b : Buffers)
+				n += b.bytes;
+			return n;
+		}
+		size_t WastedBytes() const {
+			size_t n = 0;
+			for (const BufferMemory &b : Buffers)
+				n += b.wasted_bytes();
+			return n;
+		}
+
+		std::string ToString() const {
+			std::ostringstream s;
+			for (const BufferMemory &b : Buffers) {
+				s << b.name << " " << (b.bytes / 1024) << "kb  wasted " << (b.wasted_bytes() / 1024) << "kb" << std::endl;
+			}
+			s << "Total " << (TotalBytes() / 1024) << "kb  wasted " << (WastedBytes() / 1024) << "kb" << std::endl;
+			return s.str();
+		}
+	};
+
+	/// <summary>
+	/// Bytes allocated by each internal buffer, and how much of that is not holding live data.
+	/// O(V) because of the vertex_edges statistics.
+	/// </summary>
+	MemoryReport GetMemoryReport() const {
+		size_t nV = VertexCount(), nT = TriangleCount(), nE = EdgeCount();
+		MemoryReport r;
+		r.Buffers.push_back(BufferMemory{ "vertices", vertices.byte_count(), nV * 3 * sizeof(double) });
+		r.Buffers.push_back(BufferMemory{ "normals", normals.byte_count(), HasVertexNormals() ? nV * 3 * sizeof(float) : 0 });
+		r.Buffers.push_back(BufferMemory{ "colors", colors.byte_count(), HasVertexColors() ? nV * 3 * sizeof(float) : 0 });
+		r.Buffers.push_back(BufferMemory{ "uv", uv.byte_count(), HasVertexUVs() ? nV * 2 * sizeof(float) : 0 });
+		r.Buffers.push_back(BufferMemory{ "triangles", triangles.byte_count(), nT * 3 * sizeof(int) });
+		r.Buffers.push_back(BufferMemory{ "triangle_edges", triangle_edges.byte_count(), nT * 3 * sizeof(int) });
+		r.Buffers.push_back(BufferMemory{ "triangle_groups", triangle_groups.byte_count(), HasTriangleGroups() ? nT * sizeof(int) : 0 });
+		r.Buffers.push_back(BufferMemory{ "edges", edges.byte_count(), nE * 4 * sizeof(int) });
+
+		small_list_set::memory_stats vestats = vertex_edges.MemoryStats();
+		r.Buffers.push_back(BufferMemory{ "vertex_edges", vestats.bytes, vestats.bytes - std::min(vestats.bytes, vestats.wasted_bytes) });
+
+		const refcount_vector *refcounts[3] = { &vertices_refcount, &triangles_refcount, &edges_refcount };
+		const char *refcount_names[3] = { "vertex_refcounts", "triangle_refcounts", "edge_refcounts" };
+		const char *free_list_names[3] = { "vertex_free_list", "triangle_free_list", "edge_free_list" };
+		for (int k = 0; k < 3; ++k) {
+			r.Buffers.push_back(BufferMemory{ refcount_names[k], refcounts[k]->refcount_byte_count(), refcounts[k]->count() * sizeof(short) });
+			r.Buffers.push_back(BufferMemory{ free_list_names[k], refcounts[k]->free_list_byte_count(), refcounts[k]->free_count() * sizeof(int) });
+		}
+		return r;
+	}
+
 	std::string MeshInfoString() {
 		std::ostringstream b;
 		b << "Vertices  "
@@ -3599,6 +3766,7 @@ public:
 		b << "Normals " << HasVertexNormals() << "  Colors " << HasVertexColors() << "  UVs " << HasVertexUVs() << "  Groups " << HasTriangleGroups() << std::endl;
 		b << "Closed " << CachedIsClosed() << " Compact " << IsCompact() << " timestamp " << timestamp << " shape_timestamp " << shape_timestamp << "  MaxGroupID " << MaxGroupID() << std::endl;
 		b << "VertexEdges " << vertex_edges.MemoryUsage() << std::endl;
+		b << GetMemoryReport().ToString();
 		return b.str();
 	}
 
@@ -33,6 +33,10 @@
 
 #include <g3types.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 namespace g3 {
 
 enum class EdgeRefineFlags {
@@ -75,20 +79,20 @@ public:
 		TrackingSetID = -1;
 	}
 
-	bool CanFlip() {
+	bool CanFlip() const {
 		return ((int)refineFlags & (int)EdgeRefineFlags::NoFlip) == 0;
 	}
-	bool CanSplit() {
+	bool CanSplit() const {
 		return ((int)refineFlags & (int)EdgeRefineFlags::NoSplit) == 0;
 	}
-	bool CanCollapse() {
+	bool CanCollapse() const {
 		return ((int)refineFlags & (int)EdgeRefineFlags::NoCollapse) == 0;
 	}
-	bool NoModifications() {
+	bool NoModifications() const {
 		return ((int)refineFlags & (int)EdgeRefineFlags::FullyConstrained) == (int)EdgeRefineFlags::FullyConstrained;
 	}
 
-	bool IsUnconstrained() {
+	bool IsUnconstrained() const {
 		return refineFlags == EdgeRefineFlags::NoConstraint && Target == nullptr;
 	}
 
@@ -131,9 +135,88 @@ public:
 	static VertexConstraint Pinned() { return VertexConstraint(true); }
 };
 
+//
+// id -> constraint storage used by MeshConstraints. Constraints are packed into
+// a vector of <id,constraint> pairs, and an id-indexed slot array maps each id to
+// its position in that vector. So a lookup is two array reads (no tree walk, and
+// only 4 bytes per id for the unconstrained majority), iteration only visits
+// constrained elements, and an empty table is detected with a single compare.
+// Iteration order is not sorted by id: it is insertion order until an erase(),
+// which moves the last constraint into the freed position.
+//
+template <class ConstraintType>
+class ConstraintTable {
+public:
+	typedef std::pair<int, ConstraintType> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+	typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+	bool empty() const { return items.empty(); }
+	size_t size() const { return items.size(); }
+
+	bool contains(int id) const { return find(id) != nullptr; }
+
+	// returns nullptr if id has no constraint
+	inline const ConstraintType *find(int id) const {
+		if (id < 0 || (size_t)id >= slots.size())
+			return nullptr;
+		int k = slots[id];
+		return (k == 0) ? nullptr : &items[k - 1].second;
+	}
+	inline ConstraintType *find(int id) {
+		if (id < 0 || (size_t)id >= slots.size())
+			return nullptr;
+		int k = slots[id];
+		return (k == 0) ? nullptr : &items[k - 1].second;
+	}
+
+	// negative ids are ignored
+	void set(int id, const ConstraintType &c) {
+		if (id < 0)
+			return;
+		if ((size_t)id >= slots.size())
+			slots.resize(std::max((size_t)id + 1, 2 * slots.size()), 0);
+		int k = slots[id];
+		if (k != 0) {
+			items[k - 1].second = c;
+		} else {
+			items.push_back(value_type(id, c));
+			slots[id] = (int)items.size();
+		}
+	}
+
+	// removal moves the last constraint into the freed position
+	void erase(int id) {
+		if (id < 0 || (size_t)id >= slots.size() || slots[id] == 0)
+			return;
+		int k = slots[id] - 1;
+		int last = (int)items.size() - 1;
+		if (k != last) {
+			items[k] = std::move(items[last]);
+			slots[items[k].first] = k + 1;
+		}
+		items.pop_back();
+		slots[id] = 0;
+	}
+
+	void clear() {
+		slots.clear();
+		items.clear();
+	}
+
+	iterator begin() { return items.begin(); }
+	iterator end() { return items.end(); }
+	const_iterator begin() const { return items.begin(); }
+	const_iterator end() const { return items.end(); }
+
+protected:
+	std::vector<int> slots; // id -> (index in items)+1, 0 means unconstrained
+	std::vector<value_type> items;
+};
+
 class MeshConstraints {
 public:
-	std::map<int, EdgeConstraint> Edges;
+	ConstraintTable<EdgeConstraint> Edges;
 
 	int set_id_counter; // use this to allocate FixedSetIDs
 
@@ -145,71 +228,85 @@ public:
 		return set_id_counter++;
 	}
 
-	bool HasEdgeConstraint(int eid) {
-		return Edges.find(eid) != Edges.end();
+	bool HasEdgeConstraints() const {
+		return Edges.empty() == false;
+	}
+
+	bool HasEdgeConstraint(int eid) const {
+		return Edges.contains(eid);
 	}
 
-	EdgeConstraint GetEdgeConstraint(int eid) {
-		auto found = Edges.find(eid);
-		if (found == Edges.end())
-			return EdgeConstraint::Unconstrained();
-		else
-			return found->second;
+	// returns a reference to a shared Unconstrained() instance if eid has no constraint.
+	// The reference is invalidated by the next Set/Clear call.
+	const EdgeConstraint &GetEdgeConstraint(int eid) const {
+		const EdgeConstraint *ec = Edges.find(eid);
+		return (ec != nullptr) ? *ec : UnconstrainedEdge();
 	}
 
-	void SetOrUpdateEdgeConstraint(int eid, EdgeConstraint ec) {
-		Edges[eid] = ec;
+	void SetOrUpdateEdgeConstraint(int eid, const EdgeConstraint &ec) {
+		Edges.set(eid, ec);
 	}
 
 	void ClearEdgeConstraint(int eid) {
 		Edges.erase(eid);
 	}
 
-	void FindConstrainedEdgesBySetID(int setID, std::vector<int> &result) {
-		for (auto pair : Edges) {
+	// appends the matching edge IDs in increasing order
+	void FindConstrainedEdgesBySetID(int setID, std::vector<int> &result) const {
+		size_t nStart = result.size();
+		for (const auto &pair : Edges) {
 			if (pair.second.TrackingSetID == setID)
 				result.push_back(pair.first);
 		}
+		std::sort(result.begin() + nStart, result.end());
 	}
 
-	std::map<int, VertexConstraint> Vertices;
+	ConstraintTable<VertexConstraint> Vertices;
 
-	bool HasVertexConstraint(int vid) {
-		return Vertices.find(vid) != Vertices.end();
+	bool HasVertexConstraints() const {
+		return Vertices.empty() == false;
 	}
 
-	VertexConstraint GetVertexConstraint(int vid) {
-		auto found = Vertices.find(vid);
-		if (found == Vertices.end())
-			return VertexConstraint::Unconstrained();
-		else
-			return found->second;
+	bool HasVertexConstraint(int vid) const {
+		return Vertices.contains(vid);
 	}
 
-	bool GetVertexConstraint(int vid, VertexConstraint &vc) {
-		auto found = Vertices.find(vid);
-		if (found == Vertices.end())
+	// returns a reference to a shared Unconstrained() instance if vid has no constraint.
+	// The reference is invalidated by the next Set/Clear call.
+	const VertexConstraint &GetVertexConstraint(int vid) const {
+		const VertexConstraint *vc = Vertices.find(vid);
+		return (vc != nullptr) ? *vc : UnconstrainedVertex();
+	}
+
+	bool GetVertexConstraint(int vid, VertexConstraint &vc) const {
+		const VertexConstraint *found = Vertices.find(vid);
+		if (found == nullptr)
 			return false;
-		vc = found->second;
+		vc = *found;
 		return true;
 	}
 
-	void SetOrUpdateVertexConstraint(int vid, VertexConstraint vc) {
-		Vertices[vid] = vc;
+	void SetOrUpdateVertexConstraint(int vid, const VertexConstraint &vc) {
+		Vertices.set(vid, vc);
 	}
 
 	void ClearVertexConstraint(int vid) {
 		Vertices.erase(vid);
 	}
 
-	// System.Collections.IEnumerable VertexConstraintsItr() {
-	//	foreach(KeyValuePair<int, VertexConstraint> v in Vertices)
-	//		yield return v;
-	// }
-
-	bool HasConstraints() {
+	bool HasConstraints() const {
 		return Edges.size() > 0 || Vertices.size() > 0;
 	}
+
+	// shared instances returned by the Get functions for unconstrained elements
+	static const EdgeConstraint &UnconstrainedEdge() {
+		static const EdgeConstraint ec = EdgeConstraint::Unconstrained();
+		return ec;
+	}
+	static const VertexConstraint &UnconstrainedVertex() {
+		static const VertexConstraint vc = VertexConstraint::Unconstrained();
+		return vc;
+	}
 };
 
 } // namespace g3
@@ -31,7 +31,12 @@
 #ifndef MESHIO_H
 #define MESHIO_H
 
+#include <DMesh3.h>
 #include <MaterialTypes.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace g3 {
 
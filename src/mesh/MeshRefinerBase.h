@@ -37,6 +37,7 @@
 #include <VectorUtil.h>
 #include <g3types.h>
 #include <index_util.h>
+#include <scratch_arena.h>
 
 namespace g3 {
 
@@ -45,6 +46,10 @@ protected:
 	DMesh3Ptr mesh;
 	MeshConstraintsPtr constraints = nullptr;
 
+	// temporary buffers for the current pass. Subclasses reset() this at the start
+	// of each pass, so its memory is reused instead of reallocated.
+	scratch_arena scratch;
+
 public:
 	// if true, then when two Fixed vertices have the same non-invalid SetID,
 	// we treat them as not fixed and allow collapse
@@ -71,6 +76,7 @@ public:
 
 	DMesh3Ptr Mesh() { return mesh; }
 	MeshConstraintsPtr Constraints() { return constraints; }
+	scratch_arena &Scratch() { return scratch; }
 
 	//! This object will be modified !!!
 	void SetExternalConstraints(MeshConstraintsPtr cons) {
@@ -202,9 +208,8 @@ public:
 		collapse_to = -1;
 		if (constraints == nullptr)
 			return true;
-		VertexConstraint ca, cb;
-		constraints->GetVertexConstraint(a, ca);
-		constraints->GetVertexConstraint(b, cb);
+		const VertexConstraint &ca = constraints->GetVertexConstraint(a);
+		const VertexConstraint &cb = constraints->GetVertexConstraint(b);
 
 		// no constraint at all
 		if (ca.Fixed == false && cb.Fixed == false && ca.Target == nullptr && cb.Target == nullptr)
@@ -259,17 +264,17 @@ public:
 	}
 	bool vertex_is_constrained(int vid) {
 		if (constraints != nullptr) {
-			VertexConstraint vc = constraints->GetVertexConstraint(vid);
+			const VertexConstraint &vc = constraints->GetVertexConstraint(vid);
 			if (vc.Fixed || vc.Target != nullptr)
 				return true;
 		}
 		return false;
 	}
 
-	VertexConstraint get_vertex_constraint(int vid) {
+	const VertexConstraint &get_vertex_constraint(int vid) {
 		if (constraints != nullptr)
 			return constraints->GetVertexConstraint(vid);
-		return VertexConstraint::Unconstrained();
+		return MeshConstraints::UnconstrainedVertex();
 	}
 	bool get_vertex_constraint(int vid, VertexConstraint &vc) {
 		return (constraints == nullptr) ? false :
@@ -0,0 +1,569 @@
+/**************************************************************************/
+/*  PartitionedRemesher.h                                                 */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef PARTITIONEDREMESHER_H
+#define PARTITIONEDREMESHER_H
+
+#include <MeshIO.h>
+#include <Remesher.h>
+#include <file_util.h>
+#include <int_hash_map.h>
+#include <parallel_util.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace g3 {
+
+/// <summary>
+/// PartitionedRemesher remeshes a large mesh in spatial chunks, so that each Remesher
+/// only works on (and each working DMesh3 only holds) a bounded number of triangles.
+///
+/// The triangles are split into chunks of at most MaxChunkTriangles by recursive median
+/// splits of the triangle centroids along the longest axis (the same split as the
+/// DMeshAABBTree3 top-down build, without building the tree). Each chunk is copied into
+/// its own DMesh3 and remeshed by its own Remesher, with the vertices and edges on the
+/// chunk border locked through MeshConstraints, and the chunks are remeshed in parallel.
+/// The chunks are then merged, which needs no welding as the border vertices are
+/// unchanged, and a final seam pass remeshes the band of triangles around the former
+/// chunk borders in the same way.
+///
+/// If ChunkDirectory is set, each remeshed chunk is written to a file there as soon as it
+/// is done, and read back (and deleted) during the merge. So apart from the input and the
+/// output, only the chunks that are currently being remeshed are held in memory.
+/// </summary>
+class PartitionedRemesher {
+public:
+	DMesh3Ptr Mesh; // input mesh, not modified
+	DMesh3Ptr Result; // remeshed mesh, set by Compute()
+
+	// chunks are split until they have at most this many triangles
+	int MaxChunkTriangles = 250000;
+
+	// number of Remesher::BasicRemeshPass() calls for each chunk, and for the seam band
+	int ChunkPasses = 10;
+	int SeamPasses = 10;
+
+	// width of the seam band, in vertex rings around the former chunk border vertices
+	int SeamRings = 3;
+
+	// if > 0, passed to Remesher::SetTargetEdgeLength()
+	double TargetEdgeLength = 0;
+
+	// Projection target for all Remeshers, must be safe to query concurrently.
+	// If null and ProjectToInput is set, each chunk (and the seam band) is projected
+	// onto a copy of the input triangles it was created from.
+	IProjectionTargetPtr ProjectionTarget = nullptr;
+	bool ProjectToInput = true;
+
+	// called for each Remesher before Precompute(), to set other options.
+	// Called concurrently for different chunks.
+	std::function<void(Remesher &)> ConfigureF = nullptr;
+
+	// if not empty, remeshed chunks are stored in this directory until the merge.
+	// The directory must exist, and must not be used by another Compute() at the same time.
+	std::string ChunkDirectory;
+
+	ProgressCancelPtr Progress = nullptr;
+
+	// results of the last Compute()
+	int ChunkCount = 0;
+	int SeamTriangleCount = 0;
+	IOCode ChunkIOResult = IOCode::Ok;
+
+	PartitionedRemesher(DMesh3Ptr mesh) :
+			Mesh(mesh) {}
+
+	virtual ~PartitionedRemesher() {}
+
+	virtual bool Cancelled() {
+		return (Progress == nullptr) ? false : Progress->Cancelled();
+	}
+
+	/// <summary>
+	/// Remesh Mesh into Result. Returns false (and Result is null) if cancelled,
+	/// or if a chunk file could not be written or read (see ChunkIOResult).
+	/// </summary>
+	virtual bool Compute() {
+		Result = nullptr;
+		ChunkIOResult = IOCode::Ok;
+		SeamTriangleCount = 0;
+
+		std::vector<int> chunk_tris, chunk_starts;
+		partition_triangles(chunk_tris, chunk_starts);
+		ChunkCount = (int)chunk_starts.size() - 1;
+
+		std::vector<int> chunk_of(Mesh->MaxTriangleID(), DMesh3::InvalidID);
+		for (int c = 0; c < ChunkCount; ++c) {
+			for (int k = chunk_starts[c]; k < chunk_starts[c + 1]; ++k)
+				chunk_of[chunk_tris[k]] = c;
+		}
+
+		// remesh the chunks. As in Remesher::process_edges_concurrently(),
+		// the first exception is rethrown afterwards
+		std::vector<RemeshedRegion> chunks(ChunkCount);
+		std::vector<IOCode> chunk_results(ChunkCount, IOCode::ComputingInWorkerThread);
+		std::exception_ptr first_error = nullptr;
+		std::mutex error_lock;
+		parallel_for(
+				0, ChunkCount, [&](int c) {
+					if (Cancelled())
+						return;
+					try {
+						const int *tris = chunk_tris.data() + chunk_starts[c];
+						int nTris = chunk_starts[c + 1] - chunk_starts[c];
+						auto in_chunk = [&](int tid) { return chunk_of[tid] == c; };
+						if (remesh_region(*Mesh, tris, nTris, in_chunk, ChunkPasses, ProjectionTarget, chunks[c]) == false)
+							return;
+						if (ChunkDirectory.empty() == false) {
+							chunk_results[c] = write_region(chunk_file(c), chunks[c]);
+							chunks[c] = RemeshedRegion();
+						} else
+							chunk_results[c] = IOCode::Ok;
+					} catch (...) {
+						std::lock_guard<std::mutex> l(error_lock);
+						if (first_error == nullptr)
+							first_error = std::current_exception();
+					}
+				},
+				1);
+		chunk_of = std::vector<int>();
+		if (first_error != nullptr) {
+			remove_chunk_files(chunk_results);
+			std::rethrow_exception(first_error);
+		}
+		for (IOCode code : chunk_results) {
+			if (code != IOCode::Ok) {
+				remove_chunk_files(chunk_results);
+				if (code != IOCode::ComputingInWorkerThread) // ie not cancelled
+					ChunkIOResult = code;
+				return false;
+			}
+		}
+
+		// merge. Chunk border vertices are shared by several chunks, result_vid maps them to the result mesh
+		DMesh3Ptr result = std::make_shared<DMesh3>((MeshComponents)Mesh->Components());
+		std::vector<int> result_vid(Mesh->MaxVertexID(), DMesh3::InvalidID);
+		std::vector<int> border_vids;
+		for (int c = 0; c < ChunkCount; ++c) {
+			RemeshedRegion chunk;
+			if (ChunkDirectory.empty() == false) {
+				IOCode code = read_region(chunk_file(c), chunk);
+				std::remove(chunk_file(c).c_str());
+				if (code != IOCode::Ok) {
+					for (int k = c + 1; k < ChunkCount; ++k)
+						std::remove(chunk_file(k).c_str());
+					ChunkIOResult = code;
+					return false;
+				}
+			} else
+				std::swap(chunk, chunks[c]);
+			append_region(*result, chunk, &result_vid, &border_vids);
+		}
+
+		if (ChunkCount > 1 && SeamPasses > 0) {
+			if (seam_pass(*result, result_vid, border_vids) == false)
+				return false;
+		}
+
+		Result = result;
+		return true;
+	}
+
+protected:
+	// Compact copy of a remeshed region. Vertices on the region border are unchanged
+	// and are tagged with their vertex ID in the mesh the region was taken from.
+	struct RemeshedRegion {
+		std::vector<double> positions;
+		std::vector<float> normals, colors, uvs; // empty if the mesh has none
+		std::vector<int> base_vids; // InvalidID for vertices that are not on the border
+		std::vector<int> triangles;
+		std::vector<int> groups;
+
+		int VertexCount() const { return (int)base_vids.size(); }
+		int TriangleCount() const { return (int)groups.size(); }
+
+		NewVertexInfo GetVertexInfo(int i) const {
+			NewVertexInfo info(Vector3d(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]));
+			if (normals.empty() == false) {
+				info.bHaveN = true;
+				info.n = Vector3f(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+			}
+			if (colors.empty() == false) {
+				info.bHaveC = true;
+				info.c = Vector3f(colors[3 * i], colors[3 * i + 1], colors[3 * i + 2]);
+			}
+			if (uvs.empty() == false) {
+				info.bHaveUV = true;
+				info.uv = Vector2f(uvs[2 * i], uvs[2 * i + 1]);
+			}
+			return info;
+		}
+	};
+
+	// Split the triangles into chunks of at most MaxChunkTriangles. The triangles
+	// of chunk c are chunk_tris[chunk_starts[c] .. chunk_starts[c+1]).
+	virtual void partition_triangles(std::vector<int> &chunk_tris, std::vector<int> &chunk_starts) {
+		chunk_tris.clear();
+		chunk_starts.clear();
+		for (int tid : Mesh->TriangleIndices())
+			chunk_tris.push_back(tid);
+		int N = (int)chunk_tris.size();
+		chunk_starts.push_back(0);
+		if (N == 0)
+			return;
+
+		std::vector<Vector3f> centroids(Mesh->MaxTriangleID());
+		parallel_for(0, N, [&](int k) {
+			centroids[chunk_tris[k]] = Mesh->GetTriCentroid(chunk_tris[k]).cast<float>();
+		});
+
+		// depth-first with the lower half first, so the chunks come out in order
+		int nMaxTris = std::max(1, MaxChunkTriangles);
+		std::vector<Index2i> stack;
+		stack.push_back(Index2i(0, N));
+		while (stack.empty() == false) {
+			Index2i range = stack.back();
+			stack.pop_back();
+			if (range[1] - range[0] <= nMaxTris) {
+				chunk_starts.push_back(range[1]);
+				continue;
+			}
+			Vector3f vMin = centroids[chunk_tris[range[0]]], vMax = vMin;
+			for (int k = range[0] + 1; k < range[1]; ++k) {
+				vMin = vMin.cwiseMin(centroids[chunk_tris[k]]);
+				vMax = vMax.cwiseMax(centroids[chunk_tris[k]]);
+			}
+			int axis = 0;
+			(vMax - vMin).maxCoeff(&axis);
+			int mid = (range[0] + range[1]) / 2;
+			std::nth_element(chunk_tris.begin() + range[0], chunk_tris.begin() + mid, chunk_tris.begin() + range[1],
+					[&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+			stack.push_back(Index2i(mid, range[1]));
+			stack.push_back(Index2i(range[0], mid));
+		}
+	}
+
+	// Copy the triangles tris[0..nTris) of base into submesh. sub_to_base[vid] is
+	// the base vertex of submesh vertex vid.
+	static void extract_submesh(const DMesh3 &base, const int *tris, int nTris, bool bCopyAttributes,
+			DMesh3 &submesh, std::vector<int> &sub_to_base) {
+		int_hash_map<int, int> base_to_sub(nTris);
+		sub_to_base.clear();
+		for (int k = 0; k < nTris; ++k) {
+			Index3i tv = base.GetTriangle(tris[k]);
+			for (int j = 0; j < 3; ++j) {
+				bool bInserted = false;
+				int &sub_vid = base_to_sub.get_or_insert(tv[j], DMesh3::InvalidID, &bInserted);
+				if (bInserted) {
+					sub_vid = (bCopyAttributes) ? submesh.AppendVertex(base.GetVertexAll(tv[j]))
+												: submesh.AppendVertex(base.GetVertex(tv[j]));
+					sub_to_base.push_back(tv[j]);
+				}
+				tv[j] = sub_vid;
+			}
+			submesh.AppendTriangle(tv, base.GetTriangleGroup(tris[k]));
+		}
+	}
+
+	// true if base vertex vid has a triangle that is not in the region
+	template <typename InRegionFunc>
+	static bool is_region_border_vertex(const DMesh3 &base, int vid, const InRegionFunc &in_region) {
+		for (int eid : base.VtxEdgesItr(vid)) {
+			Index2i et = base.GetEdgeT(eid);
+			if (in_region(et[0]) == false || (et[1] != DMesh3::InvalidID && in_region(et[1]) == false))
+				return true;
+		}
+		return false;
+	}
+
+	// Remesh the region tris[0..nTris) of base (in_region(tid) must be true exactly for
+	// these triangles) in a separate DMesh3, with the region border locked, and store
+	// the result in region. base is not modified. Returns false if cancelled.
+	template <typename InRegionFunc>
+	bool remesh_region(const DMesh3 &base, const int *tris, int nTris, const InRegionFunc &in_region,
+			int nPasses, IProjectionTargetPtr target, RemeshedRegion &region) {
+		// with the attributes (normals, colors, UVs, groups) of base, the Remesher interpolates them
+		DMesh3Ptr submesh = std::make_shared<DMesh3>((MeshComponents)base.Components());
+		std::vector<int> sub_to_base;
+		extract_submesh(base, tris, nTris, true, *submesh, sub_to_base);
+
+		// pin the vertices that are shared with the rest of the mesh, and lock the
+		// edges between them (open boundaries of the base mesh are not locked)
+		MeshConstraintsPtr constraints = std::make_shared<MeshConstraints>();
+		int nBorderCandidates = (int)sub_to_base.size();
+		std::vector<unsigned char> is_border(nBorderCandidates, 0);
+		for (int vid = 0; vid < nBorderCandidates; ++vid) {
+			if (is_region_border_vertex(base, sub_to_base[vid], in_region)) {
+				is_border[vid] = 1;
+				constraints->SetOrUpdateVertexConstraint(vid, VertexConstraint::Pinned());
+			}
+		}
+		for (int eid : submesh->BoundaryEdgeIndices()) {
+			Index2i ev = submesh->GetEdgeV(eid);
+			int base_eid = base.FindEdge(sub_to_base[ev[0]], sub_to_base[ev[1]]);
+			if (base.IsBoundaryEdge(base_eid) == false)
+				constraints->SetOrUpdateEdgeConstraint(eid, EdgeConstraint::FullyConstrained());
+		}
+
+		if (target == nullptr && ProjectToInput)
+			target = MeshProjectionTarget::AutoPtr(submesh, true);
+
+		// the locked border pins fold-overs in place that the unconstrained
+		// Remesher would otherwise smooth out again, so do not create them
+		Remesher r(submesh);
+		r.PreventNormalFlips = true;
+		r.SetExternalConstraints(constraints);
+		if (TargetEdgeLength > 0)
+			r.SetTargetEdgeLength(TargetEdgeLength);
+		if (target != nullptr)
+			r.SetProjectionTarget(target);
+		r.Progress = Progress;
+		if (ConfigureF != nullptr)
+			ConfigureF(r);
+		r.Precompute();
+		for (int k = 0; k < nPasses; ++k) {
+			r.BasicRemeshPass();
+			if (r.Cancelled())
+				return false;
+		}
+
+		// pinned vertices are never removed, so they keep their IDs
+		region = RemeshedRegion();
+		std::vector<int> compact(submesh->MaxVertexID(), DMesh3::InvalidID);
+		for (int vid : submesh->VertexIndices()) {
+			compact[vid] = region.VertexCount();
+			NewVertexInfo info = submesh->GetVertexAll(vid);
+			region.positions.insert(region.positions.end(), { info.v[0], info.v[1], info.v[2] });
+			if (info.bHaveN)
+				region.normals.insert(region.normals.end(), { info.n[0], info.n[1], info.n[2] });
+			if (info.bHaveC)
+				region.colors.insert(region.colors.end(), { info.c[0], info.c[1], info.c[2] });
+			if (info.bHaveUV)
+				region.uvs.insert(region.uvs.end(), { info.uv[0], info.uv[1] });
+			bool bBorder = vid < nBorderCandidates && is_border[vid] != 0;
+			region.base_vids.push_back(bBorder ? sub_to_base[vid] : DMesh3::InvalidID);
+		}
+		for (int tid : submesh->TriangleIndices()) {
+			Index3i tv = submesh->GetTriangle(tid);
+			region.triangles.insert(region.triangles.end(), { compact[tv[0]], compact[tv[1]], compact[tv[2]] });
+			region.groups.push_back(submesh->GetTriangleGroup(tid));
+		}
+		return true;
+	}
+
+	// Append region to mesh. If base_to_mesh is null, the region border vertices are
+	// vertices of mesh. Otherwise they are looked up in base_to_mesh, and added to mesh
+	// (and their base vertex to new_border_vids) the first time they are seen.
+	static void append_region(DMesh3 &mesh, const RemeshedRegion &region,
+			std::vector<int> *base_to_mesh, std::vector<int> *new_border_vids) {
+		std::vector<int> mesh_vid(region.VertexCount());
+		for (int i = 0; i < region.VertexCount(); ++i) {
+			int base_vid = region.base_vids[i];
+			if (base_vid == DMesh3::InvalidID) {
+				mesh_vid[i] = mesh.AppendVertex(region.GetVertexInfo(i));
+			} else if (base_to_mesh == nullptr) {
+				mesh_vid[i] = base_vid;
+			} else {
+				int &vid = (*base_to_mesh)[base_vid];
+				if (vid == DMesh3::InvalidID) {
+					vid = mesh.AppendVertex(region.GetVertexInfo(i));
+					if (new_border_vids != nullptr)
+						new_border_vids->push_back(base_vid);
+				}
+				mesh_vid[i] = vid;
+			}
+		}
+		for (int t = 0; t < region.TriangleCount(); ++t) {
+			const int *tv = &region.triangles[3 * t];
+			int tid = mesh.AppendTriangle(Index3i(mesh_vid[tv[0]], mesh_vid[tv[1]], mesh_vid[tv[2]]), region.groups[t]);
+			gDevAssert(tid >= 0);
+		}
+	}
+
+	// Multi-source breadth-first search from the seed vertices, for at most nMaxRings rings
+	// and only to vertices within fMaxDist of the seed they were reached from. Collects the
+	// triangles of the reached vertices (excluding the last ring) in band_tris, and sets
+	// in_band[tid] for them. Returns the largest distance of a reached vertex from its seed.
+	static double collect_band(const DMesh3 &mesh, const std::vector<int> &seeds, int nMaxRings, double fMaxDist,
+			std::vector<int> &band_tris, std::vector<unsigned char> &in_band) {
+		std::vector<int> seed_of(mesh.MaxVertexID(), DMesh3::InvalidID);
+		for (int vid : seeds)
+			seed_of[vid] = vid;
+		in_band.assign(mesh.MaxTriangleID(), 0);
+		band_tris.clear();
+		double fMaxReached = 0;
+		std::vector<int> ring = seeds, next_ring;
+		for (int k = 0; k < nMaxRings && ring.empty() == false; ++k) {
+			next_ring.clear();
+			for (int vid : ring) {
+				Vector3d seed_pos = mesh.GetVertex(seed_of[vid]);
+				for (int eid : mesh.VtxEdgesItr(vid)) {
+					Index2i et = mesh.GetEdgeT(eid);
+					for (int j = 0; j < 2; ++j) {
+						if (et[j] != DMesh3::InvalidID && in_band[et[j]] == 0) {
+							in_band[et[j]] = 1;
+							band_tris.push_back(et[j]);
+						}
+					}
+					Index2i ev = mesh.GetEdgeV(eid);
+					int nbr_vid = (ev[0] == vid) ? ev[1] : ev[0];
+					if (seed_of[nbr_vid] != DMesh3::InvalidID)
+						continue;
+					double fDist = (mesh.GetVertex(nbr_vid) - seed_pos).norm();
+					if (fDist > fMaxDist)
+						continue;
+					seed_of[nbr_vid] = seed_of[vid];
+					fMaxReached = std::max(fMaxReached, fDist);
+					next_ring.push_back(nbr_vid);
+				}
+			}
+			ring.swap(next_ring);
+		}
+		return fMaxReached;
+	}
+
+	// Remesh the band of triangles around the former chunk borders in the result mesh.
+	// border_vids are the input border vertices, result_vid maps them to the result mesh.
+	virtual bool seam_pass(DMesh3 &result, const std::vector<int> &result_vid, const std::vector<int> &border_vids) {
+		std::vector<int> seam_vids, band_tris;
+		std::vector<unsigned char> in_band;
+		for (int vid : border_vids)
+			seam_vids.push_back(result_vid[vid]);
+		if (seam_vids.empty())
+			return true;
+		double fBandRadius = collect_band(result, seam_vids, std::max(1, SeamRings),
+				std::numeric_limits<double>::max(), band_tris, in_band);
+		SeamTriangleCount = (int)band_tris.size();
+
+		// project onto the input triangles that are within the band radius of the input border vertices
+		IProjectionTargetPtr target = ProjectionTarget;
+		if (target == nullptr && ProjectToInput) {
+			std::vector<int> target_tris;
+			std::vector<unsigned char> in_target;
+			collect_band(*Mesh, border_vids, std::numeric_limits<int>::max(), fBandRadius, target_tris, in_target);
+			DMesh3Ptr target_mesh = std::make_shared<DMesh3>(MeshComponents::None);
+			std::vector<int> target_to_input;
+			extract_submesh(*Mesh, target_tris.data(), (int)target_tris.size(), false, *target_mesh, target_to_input);
+			target = std::make_shared<MeshProjectionTarget>(target_mesh);
+		}
+
+		RemeshedRegion band;
+		auto in_region = [&](int tid) { return in_band[tid] != 0; };
+		if (remesh_region(result, band_tris.data(), (int)band_tris.size(), in_region, SeamPasses, target, band) == false)
+			return false;
+
+		// replace the band. Its border vertices have triangles outside the band, so they are not removed
+		for (int tid : band_tris)
+			result.RemoveTriangle(tid, true, false);
+		append_region(result, band, nullptr, nullptr);
+		return true;
+	}
+
+	std::string chunk_file(int c) const {
+		return FileUtil::PathCombine(ChunkDirectory, "g3chunk_" + std::to_string(c) + ".bin");
+	}
+
+	void remove_chunk_files(const std::vector<IOCode> &chunk_results) const {
+		if (ChunkDirectory.empty())
+			return;
+		for (int c = 0; c < (int)chunk_results.size(); ++c) {
+			if (chunk_results[c] == IOCode::Ok)
+				std::remove(chunk_file(c).c_str());
+		}
+	}
+
+	// chunk files are the RemeshedRegion arrays, each written as a count followed by the raw values
+	static constexpr uint32_t ChunkFileMagic = 0x63723367; // "g3rc"
+
+	template <typename T>
+	static void write_array(std::ofstream &out, const std::vector<T> &v) {
+		uint64_t n = v.size();
+		out.write((const char *)&n, sizeof(n));
+		out.write((const char *)v.data(), n * sizeof(T));
+	}
+
+	template <typename T>
+	static bool read_array(std::ifstream &in, std::vector<T> &v) {
+		uint64_t n = 0;
+		if (!in.read((char *)&n, sizeof(n)) || n > std::numeric_limits<uint32_t>::max())
+			return false;
+		v.resize(n);
+		return (bool)in.read((char *)v.data(), n * sizeof(T));
+	}
+
+	static IOCode write_region(const std::string &path, const RemeshedRegion &region) {
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+			return IOCode::FileAccessError;
+		uint32_t magic = ChunkFileMagic;
+		out.write((const char *)&magic, sizeof(magic));
+		write_array(out, region.positions);
+		write_array(out, region.normals);
+		write_array(out, region.colors);
+		write_array(out, region.uvs);
+		write_array(out, region.base_vids);
+		write_array(out, region.triangles);
+		write_array(out, region.groups);
+		out.close();
+		return (out.fail()) ? IOCode::WriterError : IOCode::Ok;
+	}
+
+	static IOCode read_region(const std::string &path, RemeshedRegion &region) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			return IOCode::FileAccessError;
+		uint32_t magic = 0;
+		if (!in.read((char *)&magic, sizeof(magic)) || magic != ChunkFileMagic)
+			return IOCode::FileParsingError;
+		bool bOk = read_array(in, region.positions) && read_array(in, region.normals) &&
+				read_array(in, region.colors) && read_array(in, region.uvs) &&
+				read_array(in, region.base_vids) && read_array(in, region.triangles) &&
+				read_array(in, region.groups);
+		int nV = region.VertexCount(), nT = region.TriangleCount();
+		bOk = bOk && region.positions.size() == 3 * (size_t)nV && region.triangles.size() == 3 * (size_t)nT &&
+				(region.normals.empty() || region.normals.size() == 3 * (size_t)nV) &&
+				(region.colors.empty() || region.colors.size() == 3 * (size_t)nV) &&
+				(region.uvs.empty() || region.uvs.size() == 2 * (size_t)nV);
+		for (size_t k = 0; bOk && k < region.triangles.size(); ++k)
+			bOk = region.triangles[k] >= 0 && region.triangles[k] < nV;
+		return (bOk) ? IOCode::Ok : IOCode::GarbageDataError;
+	}
+};
+
+} // namespace g3
+#endif // PARTITIONEDREMESHER_H
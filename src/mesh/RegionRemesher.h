@@ -0,0 +1,371 @@
+/**************************************************************************/
+/*  RegionRemesher.h                                                      */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef REGIONREMESHER_H
+#define REGIONREMESHER_H
+
+#include <MeshConstraints.h>
+#include <Remesher.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace g3 {
+
+/// <summary>
+/// RegionRemesher remeshes a triangle selection of a mesh in place, eg a brush footprint.
+/// Only edges whose triangles are all in the region are refined, and only the region vertices
+/// are smoothed and projected, so a pass costs O(region) rather than O(mesh). Triangles
+/// created by splits are added to the region.
+///
+/// The region border is locked: border vertices are pinned, and the edges at border vertices
+/// that are not inside the region are fully constrained. These constraints are (re)applied at
+/// the start of each pass, in Constraints(), which is created if necessary. The constraints
+/// they replace are restored by SetRegion(), or by ClearBorderConstraints() when done.
+///
+/// Call SetRegion() again if the mesh is modified outside of the remesher. The active set
+/// (EnableActiveSet) is not used, as the region already restricts each pass.
+/// </summary>
+class RegionRemesher : public Remesher {
+public:
+	RegionRemesher(DMesh3Ptr mesh, const std::vector<int> &triangles) :
+			Remesher(mesh) {
+		// these passes over the entire mesh would make each pass O(mesh)
+		ComputeEdgeLengthStats = false;
+		CompactVertexEdgesFragmentation = -1;
+		EnableCotanWeightCache = false;
+		SetRegion(triangles);
+	}
+
+	// the border lock must not be left in shared (external) constraints
+	virtual ~RegionRemesher() {
+		clear_border_constraints();
+	}
+
+	/// <summary>
+	/// Replace the region. The constraints replaced by the border lock of the previous region are restored.
+	/// </summary>
+	void SetRegion(const std::vector<int> &triangles) {
+		clear_border_constraints();
+		for (int tid : region_tris) {
+			if (tid < (int)in_region.size())
+				in_region[tid] = 0;
+		}
+		region_tris.clear();
+		in_region.resize(mesh->MaxTriangleID(), 0);
+		for (int tid : triangles) {
+			if (mesh->IsTriangle(tid) && in_region[tid] == 0) {
+				in_region[tid] = 1;
+				region_tris.push_back(tid);
+			}
+		}
+		find_border();
+	}
+
+	/// <summary>
+	/// Restore the constraints that the border lock replaced. The next pass locks the border again.
+	/// </summary>
+	void ClearBorderConstraints() {
+		clear_border_constraints();
+	}
+
+	/// <summary>
+	/// current region triangles
+	/// </summary>
+	std::vector<int> RegionTriangles() {
+		compact_region();
+		return region_tris;
+	}
+
+	bool IsRegionTriangle(int tid) const {
+		return tid >= 0 && tid < (int)in_region.size() && in_region[tid] != 0;
+	}
+
+	/// <summary>
+	/// The triangles that have at least one vertex in the given vertex selection
+	/// </summary>
+	static std::vector<int> VertexSelectionTriangles(DMesh3Ptr mesh, const std::vector<int> &vertices) {
+		std::vector<int> triangles;
+		for (int vid : vertices) {
+			if (mesh->IsVertex(vid) == false)
+				continue;
+			for (int tid : mesh->VtxTrianglesItr(vid))
+				triangles.push_back(tid);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+		return triangles;
+	}
+
+	virtual void OnEdgeSplit(int edgeID, int va, int vb,
+			const DMesh3::EdgeSplitInfo &splitInfo) override {
+		// the split edge is inside the region, so the new triangles are as well.
+		// Splits run concurrently in parallel refinement
+		std::lock_guard<std::mutex> l(region_lock);
+		add_region_triangle(splitInfo.eNewT2);
+		add_region_triangle(splitInfo.eNewT3);
+	}
+
+	virtual void OnEdgeCollapse(int edgeID, int va, int vb,
+			const DMesh3::EdgeCollapseInfo &collapseInfo) override {
+		// triangle IDs may be re-used by later splits, which add them again
+		std::lock_guard<std::mutex> l(region_lock);
+		in_region[collapseInfo.tRemoved0] = 0;
+		if (collapseInfo.tRemoved1 != InvalidID)
+			in_region[collapseInfo.tRemoved1] = 0;
+	}
+
+protected:
+	// per-triangle region flag, and the region triangles (may contain removed triangles and
+	// duplicates until compact_region())
+	std::vector<unsigned char> in_region;
+	std::vector<int> region_tris;
+	std::mutex region_lock;
+
+	// border vertices, and the edges at border vertices that are not in the region
+	std::vector<int> border_vertices;
+	std::vector<int> border_edges;
+
+	// the border constraints replaced by lock_border(), and the constraint set they are in
+	struct saved_vertex_constraint {
+		int vid;
+		bool bHad;
+		VertexConstraint c;
+	};
+	struct saved_edge_constraint {
+		int eid;
+		bool bHad;
+		EdgeConstraint c;
+	};
+	std::vector<saved_vertex_constraint> saved_vertices;
+	std::vector<saved_edge_constraint> saved_edges;
+	MeshConstraintsPtr locked_constraints = nullptr;
+
+	// region edges and vertices of the current pass
+	std::vector<int> region_edges;
+	std::vector<int> region_vertices;
+	int region_edge_index = 0;
+
+	void add_region_triangle(int tid) {
+		if (tid == InvalidID)
+			return;
+		if (tid >= (int)in_region.size())
+			in_region.resize(std::max((size_t)mesh->MaxTriangleID(), 2 * in_region.size()), 0);
+		in_region[tid] = 1;
+		region_tris.push_back(tid);
+	}
+
+	void compact_region() {
+		region_tris.erase(std::remove_if(region_tris.begin(), region_tris.end(),
+								  [&](int tid) { return mesh->IsTriangle(tid) == false || IsRegionTriangle(tid) == false; }),
+				region_tris.end());
+		std::sort(region_tris.begin(), region_tris.end());
+		region_tris.erase(std::unique(region_tris.begin(), region_tris.end()), region_tris.end());
+	}
+
+	// true if all triangles of edge eid are in the region
+	bool is_region_edge(int eid) const {
+		Index2i et = mesh->GetEdgeT(eid);
+		return IsRegionTriangle(et[0]) && (et[1] == InvalidID || IsRegionTriangle(et[1]));
+	}
+
+	// border vertices are the vertices of region edges that are also on non-region triangles
+	void find_border() {
+		border_vertices.clear();
+		border_edges.clear();
+		for (int tid : region_tris) {
+			Index3i tri_edges = mesh->GetTriEdges(tid);
+			for (int j = 0; j < 3; ++j) {
+				if (is_region_edge(tri_edges[j]) == false) {
+					Index2i ev = mesh->GetEdgeV(tri_edges[j]);
+					border_vertices.push_back(ev[0]);
+					border_vertices.push_back(ev[1]);
+				}
+			}
+		}
+		std::sort(border_vertices.begin(), border_vertices.end());
+		border_vertices.erase(std::unique(border_vertices.begin(), border_vertices.end()), border_vertices.end());
+		for (int vid : border_vertices) {
+			for (int eid : mesh->VtxEdgesItr(vid)) {
+				if (is_region_edge(eid) == false)
+					border_edges.push_back(eid);
+			}
+		}
+		std::sort(border_edges.begin(), border_edges.end());
+		border_edges.erase(std::unique(border_edges.begin(), border_edges.end()), border_edges.end());
+	}
+
+	// Pin the border, so no op and no vertex move changes a triangle outside the region.
+	// The ops only reach the edges of region vertices, which are region edges or border_edges.
+	// The constraints this replaces are saved the first time, for clear_border_constraints()
+	void lock_border() {
+		if (constraints == nullptr)
+			constraints = std::make_shared<MeshConstraints>();
+		if (locked_constraints != constraints) {
+			clear_border_constraints();
+			locked_constraints = constraints;
+			for (int vid : border_vertices) {
+				saved_vertex_constraint saved = { vid, false, VertexConstraint() };
+				saved.bHad = constraints->GetVertexConstraint(vid, saved.c);
+				saved_vertices.push_back(saved);
+			}
+			for (int eid : border_edges) {
+				saved_edge_constraint saved = { eid, constraints->HasEdgeConstraint(eid), EdgeConstraint() };
+				if (saved.bHad)
+					saved.c = constraints->GetEdgeConstraint(eid);
+				saved_edges.push_back(saved);
+			}
+		}
+		for (int vid : border_vertices)
+			constraints->SetOrUpdateVertexConstraint(vid, VertexConstraint::Pinned());
+		for (int eid : border_edges)
+			constraints->SetOrUpdateEdgeConstraint(eid, EdgeConstraint::FullyConstrained());
+	}
+
+	// put back the constraints that lock_border() replaced, in the constraint set it locked
+	void clear_border_constraints() {
+		if (locked_constraints != nullptr) {
+			for (const saved_vertex_constraint &saved : saved_vertices) {
+				if (saved.bHad)
+					locked_constraints->SetOrUpdateVertexConstraint(saved.vid, saved.c);
+				else
+					locked_constraints->ClearVertexConstraint(saved.vid);
+			}
+			for (const saved_edge_constraint &saved : saved_edges) {
+				if (saved.bHad)
+					locked_constraints->SetOrUpdateEdgeConstraint(saved.eid, saved.c);
+				else
+					locked_constraints->ClearEdgeConstraint(saved.eid);
+			}
+		}
+		locked_constraints = nullptr;
+		saved_vertices.clear();
+		saved_edges.clear();
+	}
+
+	virtual void begin_pass() override {
+		Remesher::begin_pass();
+		compact_region();
+		lock_border();
+
+		region_edges.clear();
+		for (int tid : region_tris) {
+			Index3i tri_edges = mesh->GetTriEdges(tid);
+			for (int j = 0; j < 3; ++j) {
+				if (is_region_edge(tri_edges[j]))
+					region_edges.push_back(tri_edges[j]);
+			}
+		}
+		std::sort(region_edges.begin(), region_edges.end());
+		region_edges.erase(std::unique(region_edges.begin(), region_edges.end()), region_edges.end());
+		collect_region_vertices();
+	}
+
+	void collect_region_vertices() {
+		region_vertices.clear();
+		for (int tid : region_tris) {
+			if (IsRegionTriangle(tid) && mesh->IsTriangle(tid)) {
+				Index3i tri = mesh->GetTriangle(tid);
+				region_vertices.insert(region_vertices.end(), { tri[0], tri[1], tri[2] });
+			}
+		}
+		std::sort(region_vertices.begin(), region_vertices.end());
+		region_vertices.erase(std::unique(region_vertices.begin(), region_vertices.end()), region_vertices.end());
+	}
+
+	// same modulo-index loop as Remesher, over the region edges
+	virtual int start_edges() override {
+		region_edge_index = 0;
+		return (region_edges.empty()) ? InvalidID : region_edges[0];
+	}
+
+	virtual int next_edge(int cur_eid, bool &bDone) override {
+		int N = (int)region_edges.size();
+		if (N == 0) {
+			bDone = true;
+			return InvalidID;
+		}
+		region_edge_index = (region_edge_index + ((N % nPrime == 0) ? 1 : nPrime)) % N;
+		bDone = (region_edge_index == 0);
+		return region_edges[region_edge_index];
+	}
+
+	// splits and collapses have changed the region vertices since begin_pass()
+	virtual void apply_to_smooth_vertices(const std::function<void(int)> &apply_f, bool bParallel) override {
+		collect_region_vertices();
+		apply_to_region_vertices(apply_f, bParallel);
+	}
+
+	virtual void apply_to_project_vertices(const std::function<void(int)> &apply_f, bool bParallel) override {
+		collect_region_vertices();
+		apply_to_region_vertices(apply_f, bParallel);
+	}
+
+	void apply_to_region_vertices(const std::function<void(int)> &apply_f, bool bParallel) {
+		if (bParallel) {
+			parallel_apply_to_vertices(apply_f, &region_vertices);
+		} else {
+			for (int vid : region_vertices) {
+				if (mesh->IsVertex(vid))
+					apply_f(vid);
+			}
+		}
+	}
+
+	virtual void ApplyVertexBuffer(bool bParallel) override {
+		for (int vid : region_vertices)
+			apply_buffered_vertex(vid);
+		vertex_buffer_clean = true;
+	}
+
+	virtual void update_vertex_lengths() override {
+		if (SizingField == nullptr) {
+			vertex_lengths.clear();
+			return;
+		}
+		vertex_lengths.resize(mesh->MaxVertexID(), 0);
+		apply_to_region_vertices([&](int vid) {
+			vertex_lengths[vid] = SizingField->TargetEdgeLength(mesh->GetVertex(vid), vid);
+		},
+				true);
+	}
+
+	// the region already restricts each pass, so the active set is not used
+	virtual void begin_active_set(RemeshPassStats &stats) override {
+		active_pass = false;
+		active_set_valid = false;
+		touched_vertices.clear();
+	}
+	virtual void begin_active_region() override {}
+	virtual void end_active_set() override {}
+};
+
+} // namespace g3
+#endif // REGIONREMESHER_H
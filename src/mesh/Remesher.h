@@ -35,8 +35,17 @@
 #include <BasicProjectionTargets.h>
 #include <MeshRefinerBase.h>
 #include <MeshUtil.h>
+#include <SizingFields.h>
 #include <SpatialInterfaces.h>
+#include <parallel_util.h>
+#include <profile_util.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
 
 namespace g3 {
 
@@ -50,36 +59,44 @@ class Remesher : public MeshRefinerBase {
 		return sqrt(sqr);
 	}
 
+	// Cotangents above this (angles below about 0.006 or above 179.994 degrees) come from
+	// nearly flat triangles. VectorCot() only returns 0 for exactly flat ones, but the large
+	// weights of nearly flat triangles cancel in the weight sum, and move the vertex far away
+	static constexpr double MaxCotan = 1e4;
+	static bool is_degenerate_cotan(double cot) {
+		return cot == 0 || std::abs(cot) > MaxCotan;
+	}
+
 	// Compute cotan-weighted neighbor sum around a vertex.
 	// These weights are numerically unstable if any of the triangles are degenerate.
 	// We catch these problems and return input vertex as centroid
 	// http://www.geometry.caltech.edu/pubs/DMSB_III.pdf
-	static Vector3d CotanCentroid(DMesh3Ptr mesh, int v_i) {
-		Vector3d vSum;
+	static Vector3d CotanCentroid(const DMesh3 &mesh, int v_i) {
+		Vector3d vSum = Vector3d::Zero();
 		double wSum = 0;
-		Vector3d Vi = mesh->GetVertex(v_i);
+		Vector3d Vi = mesh.GetVertex(v_i);
 		int v_j = DMesh3::InvalidID, opp_v1 = DMesh3::InvalidID, opp_v2 = DMesh3::InvalidID;
 		int t1 = DMesh3::InvalidID, t2 = DMesh3::InvalidID;
 		bool bAborted = false;
-		for (int eid : mesh->VtxEdgesItr(v_i)) {
+		for (int eid : mesh.VtxEdgesItr(v_i)) {
 			opp_v2 = DMesh3::InvalidID;
-			mesh->GetVtxNbrhood(eid, v_i, v_j, opp_v1, opp_v2, t1, t2);
-			Vector3d Vj = mesh->GetVertex(v_j);
-			Vector3d Vo1 = mesh->GetVertex(opp_v1);
+			mesh.GetVtxNbrhood(eid, v_i, v_j, opp_v1, opp_v2, t1, t2);
+			Vector3d Vj = mesh.GetVertex(v_j);
+			Vector3d Vo1 = mesh.GetVertex(opp_v1);
 			double cot_alpha_ij = VectorCot(
 					(Vi - Vo1).normalized(), (Vj - Vo1).normalized());
-			if (cot_alpha_ij == 0) {
+			if (is_degenerate_cotan(cot_alpha_ij)) {
 				bAborted = true;
 				break;
 			}
 			double w_ij = cot_alpha_ij;
 
 			if (opp_v2 != DMesh3::InvalidID) {
-				Vector3d Vo2 = mesh->GetVertex(opp_v2);
+				Vector3d Vo2 = mesh.GetVertex(opp_v2);
 
 				double cot_beta_ij = VectorCot(
 						(Vi - Vo2).normalized(), (Vj - Vo2).normalized());
-				if (cot_beta_ij == 0) {
+				if (is_degenerate_cotan(cot_beta_ij)) {
 					bAborted = true;
 					break;
 				}
@@ -95,11 +112,86 @@ class Remesher : public MeshRefinerBase {
 		return vSum / wSum;
 	}
 
+	// Cotan weight of edge [a,b] with opposing vertices [c,d] (d is InvalidID for a boundary
+	// edge), as computed by CotanCentroid(). Returns NaN if CotanCentroid() would abort.
+	static double CotanEdgeWeight(const DMesh3 &mesh, int a, int b, int c, int d) {
+		Vector3d Va = mesh.GetVertex(a), Vb = mesh.GetVertex(b);
+		Vector3d Vc = mesh.GetVertex(c);
+		double w = VectorCot((Va - Vc).normalized(), (Vb - Vc).normalized());
+		if (is_degenerate_cotan(w))
+			return std::numeric_limits<double>::quiet_NaN();
+		if (d != DMesh3::InvalidID) {
+			Vector3d Vd = mesh.GetVertex(d);
+			double cot_beta = VectorCot((Va - Vd).normalized(), (Vb - Vd).normalized());
+			if (is_degenerate_cotan(cot_beta))
+				return std::numeric_limits<double>::quiet_NaN();
+			w += cot_beta;
+		}
+		return w;
+	}
+
+	// CotanCentroid() with precomputed edge weights (see CotanEdgeWeight())
+	static Vector3d CotanCentroid(const DMesh3 &mesh, int v_i, const dvector<double> &edge_weights) {
+		Vector3d vSum = Vector3d::Zero();
+		double wSum = 0;
+		Vector3d Vi = mesh.GetVertex(v_i);
+		for (int eid : mesh.VtxEdgesItr(v_i)) {
+			double w_ij = edge_weights[eid];
+			if (std::isnan(w_ij))
+				return Vi;
+			Index2i ev = mesh.GetEdgeV(eid);
+			vSum += w_ij * mesh.GetVertex((ev[0] == v_i) ? ev[1] : ev[0]);
+			wSum += w_ij;
+		}
+		if (std::abs(wSum) < std::numeric_limits<double>::epsilon()) {
+			return Vi;
+		}
+		return vSum / wSum;
+	}
+
+	// Compute mean-value-weighted neighbor sum around a vertex. The weights are
+	// positive (unlike cotan weights), so this is stable on meshes with obtuse triangles.
+	// Returns the input vertex if an edge is degenerate.
+	// Floater, Mean value coordinates, CAGD 2003
+	static Vector3d MeanValueCentroid(const DMesh3 &mesh, int v_i) {
+		Vector3d vSum = Vector3d::Zero();
+		double wSum = 0;
+		Vector3d Vi = mesh.GetVertex(v_i);
+		int v_j = DMesh3::InvalidID, opp_v1 = DMesh3::InvalidID, opp_v2 = DMesh3::InvalidID;
+		int t1 = DMesh3::InvalidID, t2 = DMesh3::InvalidID;
+		for (int eid : mesh.VtxEdgesItr(v_i)) {
+			opp_v2 = DMesh3::InvalidID;
+			mesh.GetVtxNbrhood(eid, v_i, v_j, opp_v1, opp_v2, t1, t2);
+			Vector3d Vj = mesh.GetVertex(v_j);
+			Vector3d vVj = Vj - Vi;
+			double len_vVj = vVj.norm();
+			if (len_vVj < Wml::Mathd::ZERO_TOLERANCE)
+				return Vi;
+			vVj /= len_vVj;
+			// tan of the half-angles at Vi in the triangles on either side of the edge
+			double w_ij = VectorTanHalfAngle(vVj, (mesh.GetVertex(opp_v1) - Vi).normalized());
+			if (opp_v2 != DMesh3::InvalidID)
+				w_ij += VectorTanHalfAngle(vVj, (mesh.GetVertex(opp_v2) - Vi).normalized());
+			w_ij /= len_vVj;
+
+			vSum += w_ij * Vj;
+			wSum += w_ij;
+		}
+		if (wSum < Wml::Mathd::ZERO_TOLERANCE)
+			return Vi;
+		return vSum / wSum;
+	}
+
 public:
 	// t in range [0,1]
 	static Vector3d CotanSmooth(DMesh3Ptr mesh, int vID, double t) {
 		Vector3d v = mesh->GetVertex(vID);
-		Vector3d c = CotanCentroid(mesh, vID);
+		Vector3d c = CotanCentroid(*mesh, vID);
+		return (1 - t) * v + (t)*c;
+	}
+	static Vector3d MeanValueSmooth(DMesh3Ptr mesh, int vID, double t) {
+		Vector3d v = mesh->GetVertex(vID);
+		Vector3d c = MeanValueCentroid(*mesh, vID);
 		return (1 - t) * v + (t)*c;
 	}
 
@@ -117,6 +209,16 @@ public:
 	double MinEdgeLength = 0.001f;
 	double MaxEdgeLength = 0.1f;
 
+	// ratio of the min/max edge length to the target edge length, see SetTargetEdgeLength()
+	static constexpr double MinEdgeLengthFactor = 0.66;
+	static constexpr double MaxEdgeLengthFactor = 1.33;
+
+	// Adaptive sizing. If set, an edge is split if it is longer than MaxEdgeLengthFactor, and
+	// collapsed if it is shorter than MinEdgeLengthFactor, times the mean target edge length at
+	// its vertices (MinEdgeLength/MaxEdgeLength are not used for refinement). The field is
+	// evaluated once per vertex at the start of each pass, concurrently. See SizingFields.h
+	ISizingFieldPtr SizingField = nullptr;
+
 	double SmoothSpeedT = 0.1f;
 
 	enum class SmoothTypes { Uniform,
@@ -124,11 +226,20 @@ public:
 		MeanValue };
 	SmoothTypes SmoothType = SmoothTypes::Cotan;
 
-	// this overrides default smoothing if provided
+	// Keep the cotan weight of each edge between passes (SmoothTypes::Cotan only), so a
+	// smoothing pass only recomputes the weights of edges whose triangles were changed by ops
+	// or have a moved vertex. The smoothed positions are the same as without the cache.
+	// It is built by the second of consecutive BasicRemeshPass() calls, and rebuilt if the mesh
+	// is modified outside of the remesher. Updating the cache costs O(mesh), so it is not used
+	// by Step() or by active-set passes (see EnableActiveSet).
+	bool EnableCotanWeightCache = true;
+
+	// this overrides default smoothing if provided. Called concurrently for different
+	// vertices if EnableParallelSmooth is set, and must not modify the mesh
 	std::function<Vector3d(DMesh3Ptr, int, double)> CustomSmoothF;
 
 	// Sometimes we need to have very granular control over what happens to
-	// specific vertices. This function allows client to specify such behavior.
+	// specific vertices. SetVertexControl() allows client to specify such behavior.
 	// Somewhat redundant w/ VertexConstraints, but simpler to code.
 	enum class VertexControl {
 		AllowAll = 0,
@@ -136,8 +247,29 @@ public:
 		NoProject = 2,
 		NoMovement = NoSmooth | NoProject
 	};
+	// If set, this is used instead of the SetVertexControl() flags. It is called for each
+	// smoothed and projected vertex, possibly concurrently, so the flags are much cheaper.
 	std::function<VertexControl(int)> VertexControlF = nullptr;
 
+	/// <summary>
+	/// Set the control flags of a vertex. The flags are stored in a byte per vertex ID.
+	/// Vertices without flags, including the vertices created by splits, allow everything.
+	/// </summary>
+	void SetVertexControl(int vid, VertexControl control) {
+		if (vid >= (int)vertex_controls.size()) {
+			if (control == VertexControl::AllowAll)
+				return;
+			vertex_controls.resize(std::max((size_t)mesh->MaxVertexID(), (size_t)vid + 1), 0);
+		}
+		vertex_controls[vid] = (unsigned char)control;
+	}
+	VertexControl GetVertexControl(int vid) const {
+		return (vid < (int)vertex_controls.size()) ? (VertexControl)vertex_controls[vid] : VertexControl::AllowAll;
+	}
+	void ClearVertexControls() {
+		vertex_controls.clear();
+	}
+
 	// other options
 
 	// [RMS] this is a debugging aid, will break to debugger if these edges are
@@ -159,16 +291,50 @@ public:
 		return ProjectionMode == TargetProjectionMode::Inline;
 	}
 
-	// enable parallel projection. Only applied in AfterRefinement mode
+	// enable parallel projection. Only applied in AfterRefinement mode.
+	// The projection target must be safe to query concurrently (see IProjectionTarget)
 	bool EnableParallelProjection = true;
 
-	// Enable parallel smoothing. This will produce slightly different results
-	// across runs because we smooth in-place and hence there will be order
-	// side-effects.
+	// Enable parallel smoothing. With the (default) buffered smoothing the results
+	// are identical to serial smoothing. In-place smoothing is always serial.
 	bool EnableParallelSmooth = true;
 
+	// Enable parallel edge refinement (splits/flips/collapses), see ParallelRefinePass().
+	// Edges are processed in rounds of independent sets, so the result differs from
+	// serial refinement (where each op sees the effect of all earlier ops), but it does
+	// not depend on the number of threads. Edges next to constraints are processed
+	// serially at the end of the pass. The projection target must be safe to query
+	// concurrently. Ignored if ENABLE_PROFILING is set.
+	bool EnableParallelRefinement = false;
+
+	// rounds with fewer independent edges than this are processed serially
+	int ParallelRefinementMinBatch = 256;
+
+	// Order in which BasicRemeshPass() processes edges. PrimeModulo visits every edge once.
+	// Priority only visits edges that need an op, worst first, and re-queues the edges
+	// around each successful op, see PriorityRefinePass(). Priority refinement is always serial.
+	enum class EdgeOrders { PrimeModulo,
+		Priority };
+	EdgeOrders EdgeOrder = EdgeOrders::PrimeModulo;
+
+	// Active-set remeshing. After a full pass, the next pass only refines, smooths and
+	// projects the vertices changed by the previous pass and their one-rings, so the cost
+	// of a pass scales with the amount of change. A vertex counts as changed if an op
+	// touched it, or if smoothing and projection moved it further than
+	// ActiveSetMoveTolerance * MinEdgeLength (or the local min length, with a SizingField).
+	// The pass processes the whole mesh again if more than ActiveSetMaxFraction of the vertices
+	// are active, or if the mesh, edge lengths, sizing field or projection target were changed
+	// since the last pass. Call ResetActiveSet() after
+	// changing other settings (eg constraints) between passes.
+	bool EnableActiveSet = false;
+	double ActiveSetMoveTolerance = 0.05;
+	double ActiveSetMaxFraction = 0.5;
+
 	// if smoothing is done in-place, we don't need an extra buffer, but also
 	// there will some randomness introduced in results. Probably worse.
+	// In-place smoothing moves each vertex as soon as it is smoothed, so it is always serial
+	// (EnableParallelSmooth is ignored) and the result depends on the vertex order.
+	// BasicRemeshPass() and Step() both support it.
 	bool EnableSmoothInPlace = false;
 
 	Remesher(DMesh3Ptr m) :
@@ -189,6 +355,13 @@ public:
 		this->target = std::dynamic_pointer_cast<IProjectionTarget>(CurrTarget);
 	}
 
+	/// <summary>
+	/// Discard the active set (see EnableActiveSet), so that the next pass processes the whole mesh
+	/// </summary>
+	void ResetActiveSet() {
+		active_set_valid = false;
+	}
+
 	/// <summary>
 	/// Set min/max edge-lengths to sane values for given target edge length
 	/// </summary>
@@ -197,15 +370,24 @@ public:
 		// MinEdgeLength = fLength * (4.0/5.0);
 		// MaxEdgeLength = fLength * (4.0/3.0);
 		// much nicer!! makes sense as when we split, edges are both > min !
-		MinEdgeLength = fLength * 0.66;
-		MaxEdgeLength = fLength * 1.33;
+		MinEdgeLength = fLength * MinEdgeLengthFactor;
+		MaxEdgeLength = fLength * MaxEdgeLengthFactor;
 	}
 
+	// if set, passes are timed with this profiler, otherwise with LocalProfiler::Active() (if any).
+	// Blocks of parallel loops run by pool threads are timed as "ops.worker", "smooth.worker" and
+	// "project.worker" scopes on those threads.
+	// ENABLE_PROFILING additionally times each collapse/flip/split attempt, which is much more expensive.
+	LocalProfiler *Profiler = nullptr;
 	bool ENABLE_PROFILING = false;
 
 	// glboal mesh info that, if known, lets us avoid work in remesh
 	bool MeshIsClosed = false;
 
+	// after each pass, re-linearize the mesh vertex-edge lists if their fragmentation
+	// (see small_list_set::LinkFragmentation) is above this value. Negative disables.
+	double CompactVertexEdgesFragmentation = 0.5;
+
 	/// <summary>
 	/// we can vastly speed things up if we precompute some invariants.
 	/// You need to re-run this if you are changing the mesh externally
@@ -224,6 +406,69 @@ public:
 		}
 	}
 
+	enum class ProcessResult {
+		Ok_Collapsed,
+		Ok_Flipped,
+		Ok_Split,
+		Ignored_EdgeIsFine,
+		Ignored_EdgeIsFullyConstrained,
+		Failed_OpNotSuccessful,
+		Failed_NotAnEdge
+	};
+	static constexpr int ProcessResultCount = (int)ProcessResult::Failed_NotAnEdge + 1;
+
+	/// <summary>
+	/// Statistics of one BasicRemeshPass()
+	/// </summary>
+	struct RemeshPassStats {
+		static constexpr int HistogramBins = 8;
+
+		// number of edges for which ProcessEdge() returned each ProcessResult
+		int ResultCounts[ProcessResultCount] = {};
+		// number of attempted collapses/flips/splits (successes are in ResultCounts)
+		int CollapseAttempts = 0, FlipAttempts = 0, SplitAttempts = 0;
+
+		// wall-clock time of each phase, in milliseconds
+		double OpsTimeMs = 0, SmoothTimeMs = 0, ProjectTimeMs = 0, TotalTimeMs = 0;
+
+		int VertexCountBefore = 0, VertexCountAfter = 0;
+		int TriangleCountBefore = 0, TriangleCountAfter = 0;
+		bool Cancelled = false;
+
+		// size of the active set if the pass only processed the active set (see EnableActiveSet), otherwise -1
+		int ActiveVertices = -1, ActiveEdges = -1;
+
+		// edge-length distribution after the pass, only if ComputeEdgeLengthStats. In an active
+		// pass (ActiveVertices >= 0) only the edges of the smoothed/projected vertices are counted.
+		// Histogram bin k counts edges whose length divided by their max length (MaxEdgeLength, or the
+		// local limit with a SizingField) is in [k,k+1)*(2/HistogramBins), the last bin is open-ended
+		bool HasEdgeLengthStats = false;
+		int EdgeCount = 0;
+		double EdgeLengthMin = 0, EdgeLengthMax = 0, EdgeLengthMean = 0;
+		// edges outside [MinEdgeLength,MaxEdgeLength], or the local limits with a SizingField
+		int EdgesShorterThanMin = 0, EdgesLongerThanMax = 0;
+		int EdgeLengthHistogram[HistogramBins] = {};
+
+		int Count(ProcessResult result) const { return ResultCounts[(int)result]; }
+		int Collapses() const { return Count(ProcessResult::Ok_Collapsed); }
+		int Flips() const { return Count(ProcessResult::Ok_Flipped); }
+		int Splits() const { return Count(ProcessResult::Ok_Split); }
+		int ModifiedEdges() const { return Collapses() + Flips() + Splits(); }
+		int FailedOps() const { return Count(ProcessResult::Failed_OpNotSuccessful); }
+		int VertexDelta() const { return VertexCountAfter - VertexCountBefore; }
+		int TriangleDelta() const { return TriangleCountAfter - TriangleCountBefore; }
+	};
+
+	/// <summary>
+	/// Statistics of the previous Remesh pass, also returned by BasicRemeshPass()
+	/// </summary>
+	RemeshPassStats LastPassStats;
+
+	// compute the edge-length distribution at the end of each pass (one parallel pass over the
+	// edges, or over the edges of the active region in an active pass). Off by default, as it
+	// is a diagnostic and the pass does not need it
+	bool ComputeEdgeLengthStats = false;
+
 	/// <summary>
 	/// Number of edges that were modified in previous Remesh pass.
 	/// If this number gets small relative to edge count, you have probably
@@ -237,12 +482,24 @@ public:
 	/// - smoothing is done in parallel if EnableParallelSmooth = true
 	/// - Projection pass if ProjectionMode == AfterRefinement
 	/// - number of modified edges returned in ModifiedEdgesLastPass
+	/// - statistics returned and in LastPassStats
 	/// </summary>
-	virtual void BasicRemeshPass() {
+	virtual RemeshPassStats BasicRemeshPass() {
+		// a time-sliced pass cannot continue, as this pass reuses its buffers
+		step_phase = StepPhase::Idle;
+		LastPassStats = RemeshPassStats();
 		if (mesh->TriangleCount() == 0) // badness if we don't catch this...
-			return;
-
-		begin_pass();
+			return LastPassStats;
+
+		RemeshPassStats &stats = LastPassStats;
+		auto pass_start = std::chrono::steady_clock::now(), phase_start = pass_start;
+		auto elapsed_ms = [](std::chrono::steady_clock::time_point &since) {
+			auto now = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(now - since).count();
+			since = now;
+			return ms;
+		};
+		start_pass(stats);
 
 		// Iterate over all edges in the mesh at start of pass.
 		// Some may be removed, so we skip those.
@@ -251,40 +508,46 @@ public:
 		//
 		begin_ops();
 
-		int cur_eid = start_edges();
-		bool done = false;
 		ModifiedEdgesLastPass = 0;
-		do {
-			if (mesh->IsEdge(cur_eid)) {
-				ProcessResult result = ProcessEdge(cur_eid);
-				if (result == ProcessResult::Ok_Collapsed ||
-						result == ProcessResult::Ok_Flipped ||
-						result == ProcessResult::Ok_Split)
-					ModifiedEdgesLastPass++;
-			}
-			if (Cancelled()) // expensive to check every iter?
-				return;
-			cur_eid = next_edge(cur_eid, done);
-		} while (done == false);
+		if (EdgeOrder == EdgeOrders::Priority) {
+			if (PriorityRefinePass(stats) == false)
+				return cancel_pass_stats(pass_start);
+		} else if (use_parallel_refinement()) {
+			if (ParallelRefinePass(stats) == false)
+				return cancel_pass_stats(pass_start);
+		} else {
+			int cur_eid = start_edges();
+			bool done = false;
+			do {
+				if (mesh->IsEdge(cur_eid))
+					count_result(stats, ProcessEdge(cur_eid));
+				if (Cancelled()) // expensive to check every iter?
+					return cancel_pass_stats(pass_start);
+				cur_eid = next_edge(cur_eid, done);
+			} while (done == false);
+		}
 		end_ops();
+		stats.OpsTimeMs = elapsed_ms(phase_start);
 
 		if (Cancelled())
-			return;
+			return cancel_pass_stats(pass_start);
+
+		if (EnableActiveSet)
+			begin_active_region();
 
 		begin_smooth();
 		if (EnableSmoothing && SmoothSpeedT > 0) {
 			if (EnableSmoothInPlace)
-				// FullSmoothPass_InPlace(EnableParallelSmooth);
-				;
-			// gBreakToDebugger();
+				FullSmoothPass_InPlace();
 			else
 				FullSmoothPass_Buffer(EnableParallelSmooth);
 			DoDebugChecks();
 		}
 		end_smooth();
+		stats.SmoothTimeMs = elapsed_ms(phase_start);
 
 		if (Cancelled())
-			return;
+			return cancel_pass_stats(pass_start);
 
 		begin_project();
 		if (target != nullptr &&
@@ -293,14 +556,327 @@ public:
 			DoDebugChecks();
 		}
 		end_project();
+		stats.ProjectTimeMs = elapsed_ms(phase_start);
 
 		if (Cancelled())
+			return cancel_pass_stats(pass_start);
+
+		finish_pass(stats);
+		stats.TotalTimeMs = elapsed_ms(pass_start);
+		return stats;
+	}
+
+	/// <summary>
+	/// Time-sliced BasicRemeshPass(), eg to spread a pass over several frames. Each call
+	/// continues the current pass where the previous call stopped, and returns once nMaxItems
+	/// edges (refinement) or vertices (smoothing, projection) were processed, or after
+	/// fMaxMicroseconds, whichever comes first. 0 disables a limit, and each call processes at
+	/// least one item. Returns true if the pass was completed (or cancelled) by this call, then
+	/// LastPassStats has its statistics (with the summed time of the slices) and the next call
+	/// starts a new pass.
+	/// The mesh is valid after each call. Ops re-read the mesh, so it can be modified between
+	/// calls, but if it was, the smoothing of the current pass is skipped, as the buffered
+	/// positions are out of date (in-place smoothing, see EnableSmoothInPlace, just continues).
+	/// Steps run serially, in the start_edges()/next_edge() order: EdgeOrder::Priority and
+	/// parallel refinement/smoothing/projection are only used by BasicRemeshPass().
+	/// The vertex lists of the smoothing and projection phases are collected in one slice, and
+	/// the end of the pass is not sliced. Unless the pass is restricted to the active set,
+	/// ComputeEdgeLengthStats visits all edges there, so leave it off to keep the last slice short.
+	/// </summary>
+	virtual bool Step(int nMaxItems, double fMaxMicroseconds = 0) {
+		auto slice_start = std::chrono::steady_clock::now(), phase_start = slice_start;
+		auto elapsed_ms = [](std::chrono::steady_clock::time_point &since) {
+			auto now = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(now - since).count();
+			since = now;
+			return ms;
+		};
+		int nItems = 0;
+		bool bBudgetUsed = false;
+		auto budget_used = [&]() {
+			nItems++;
+			if (nMaxItems > 0 && nItems >= nMaxItems)
+				return true;
+			// the clock is only read every few items
+			return fMaxMicroseconds > 0 && (nItems % 8) == 0 &&
+					std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - slice_start).count() >= fMaxMicroseconds;
+		};
+		RemeshPassStats &stats = LastPassStats;
+		auto end_slice = [&]() {
+			stats.TotalTimeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - slice_start).count();
+			step_timestamp = mesh->Timestamp();
+			return false;
+		};
+		auto cancel_step = [&]() {
+			step_phase = StepPhase::Idle;
+			double fTotalMs = stats.TotalTimeMs;
+			cancel_pass_stats(slice_start);
+			stats.TotalTimeMs += fTotalMs;
+			return true;
+		};
+
+		if (step_phase == StepPhase::Idle) {
+			LastPassStats = RemeshPassStats();
+			if (mesh->TriangleCount() == 0)
+				return true;
+			start_pass(stats);
+			// profiler scopes would span the frames between the slices
+			close_pass_profile();
+			// updating the cotan weight cache would not fit in a slice
+			cotan_weights_valid = cotan_weights_pass = false;
+			ModifiedEdgesLastPass = 0;
+			step_eid = start_edges();
+			step_edges_done = false;
+			step_phase = StepPhase::Refine;
+		} else if (mesh->Timestamp() != step_timestamp && step_phase == StepPhase::Smooth && EnableSmoothInPlace == false) {
+			begin_step_phase(StepPhase::Project);
+		}
+
+		if (step_phase == StepPhase::Refine) {
+			begin_ops();
+			while (step_edges_done == false && bBudgetUsed == false) {
+				if (mesh->IsEdge(step_eid))
+					count_result(stats, ProcessEdge(step_eid));
+				step_eid = next_edge(step_eid, step_edges_done);
+				bBudgetUsed = budget_used();
+			}
+			end_ops();
+			stats.OpsTimeMs += elapsed_ms(phase_start);
+			if (Cancelled())
+				return cancel_step();
+			if (step_edges_done == false)
+				return end_slice();
+			if (EnableActiveSet)
+				begin_active_region();
+			begin_step_phase(StepPhase::Smooth);
+			if (bBudgetUsed)
+				return end_slice();
+		}
+
+		if (step_phase == StepPhase::Smooth) {
+			begin_smooth();
+			dispatch_smooth_kernel([&](const auto &kernel) {
+				while (step_vertex_index < step_vertices.size() && bBudgetUsed == false) {
+					int vid = step_vertices[step_vertex_index++];
+					if (EnableSmoothInPlace == false)
+						smooth_vertex_to_buffer(vid, kernel);
+					else if (mesh->IsVertex(vid)) // the mesh may have been modified since the vertices were collected
+						smooth_vertex_in_place(vid, kernel);
+					bBudgetUsed = budget_used();
+				}
+			});
+			bool bDone = (step_vertex_index == step_vertices.size());
+			if (bDone && step_vertices.empty() == false) {
+				if (EnableSmoothInPlace == false)
+					ApplyVertexBuffer(false);
+				DoDebugChecks();
+			}
+			end_smooth();
+			stats.SmoothTimeMs += elapsed_ms(phase_start);
+			if (Cancelled())
+				return cancel_step();
+			if (bDone == false)
+				return end_slice();
+			begin_step_phase(StepPhase::Project);
+			if (bBudgetUsed)
+				return end_slice();
+		}
+
+		if (step_phase == StepPhase::Project) {
+			begin_project();
+			while (step_vertex_index < step_vertices.size() && bBudgetUsed == false) {
+				// the mesh may have been modified since the vertices were collected
+				int vid = step_vertices[step_vertex_index++];
+				if (mesh->IsVertex(vid))
+					project_vertex_to_target(vid, false);
+				bBudgetUsed = budget_used();
+			}
+			end_project();
+			stats.ProjectTimeMs += elapsed_ms(phase_start);
+			if (Cancelled())
+				return cancel_step();
+			if (step_vertex_index < step_vertices.size())
+				return end_slice();
+		}
+
+		step_phase = StepPhase::Idle;
+		finish_pass(stats);
+		stats.TotalTimeMs += elapsed_ms(slice_start);
+		return true;
+	}
+
+	/// <summary>
+	/// true if a time-sliced pass was started by Step() and is not complete yet
+	/// </summary>
+	bool StepInProgress() const {
+		return step_phase != StepPhase::Idle;
+	}
+
+	/// <summary>
+	/// Abandon the current time-sliced pass, so the next Step() starts a new pass. The ops that
+	/// were already done are kept.
+	/// </summary>
+	void AbortStep() {
+		if (step_phase == StepPhase::Idle)
 			return;
+		step_phase = StepPhase::Idle;
+		close_pass_profile();
+		active_pass = false;
+		active_set_valid = false;
+	}
 
-		end_pass();
+	/// <summary>
+	/// Edge-refinement loop of BasicRemeshPass when EnableParallelRefinement is set.
+	/// Works in rounds: the edges that may need an op are found concurrently, then
+	/// edges are greedily claimed in prime-modulo order if their neighbourhood (the
+	/// vertices the op may read or write, see get_refinement_region()) does not overlap
+	/// an edge claimed earlier in the round. The claimed independent set is processed
+	/// concurrently, the rest is left for the next round. Returns false if cancelled.
+	/// </summary>
+	virtual bool ParallelRefinePass(RemeshPassStats &stats) {
+		std::vector<int> pending, candidates, batch, deferred, serial_edges, region;
+		int cur_eid = start_edges();
+		bool done = false;
+		do {
+			pending.push_back(cur_eid);
+			cur_eid = next_edge(cur_eid, done);
+		} while (done == false);
+
+		std::vector<unsigned char> needs_op;
+		std::vector<int> claimed_round;
+		int round = 0;
+		while (pending.empty() == false) {
+			needs_op.assign(pending.size(), 0);
+			parallel_for_blocks(0, (int)pending.size(), [&](int i0, int i1) {
+				profile_scope block_scope(worker_profiler(), worker_label);
+				for (int i = i0; i < i1; ++i)
+					needs_op[i] = (unsigned char)edge_needs_op(pending[i]);
+			});
+
+			round++;
+			claimed_round.resize(mesh->MaxVertexID(), 0);
+			candidates.clear();
+			batch.clear();
+			deferred.clear();
+			int nEdgeListInserts = 0;
+			for (size_t i = 0; i < pending.size(); ++i) {
+				int eid = pending[i];
+				if (needs_op[i] == EdgeIsFine) {
+					bool bFullyConstrained = constraints != nullptr && constraints->GetEdgeConstraint(eid).NoModifications();
+					count_result(stats, bFullyConstrained ? ProcessResult::Ignored_EdgeIsFullyConstrained : ProcessResult::Ignored_EdgeIsFine);
+					continue;
+				} else if (needs_op[i] != NotAnEdge) {
+					// once the round is mostly claimed, the edge vertices usually are, and
+					// then the region overlaps without collecting it
+					Index2i ev = mesh->GetEdgeV(eid);
+					if (claimed_round[ev[0]] == round || claimed_round[ev[1]] == round) {
+						candidates.push_back(eid);
+						deferred.push_back(eid);
+						continue;
+					}
+					if (get_refinement_region(eid, needs_op[i] == EdgeNeedsCollapse, region) == false) {
+						serial_edges.push_back(eid);
+						continue;
+					}
+					candidates.push_back(eid);
+					bool bOverlaps = false;
+					for (size_t j = 0; j < region.size() && bOverlaps == false; ++j)
+						bOverlaps = (claimed_round[region[j]] == round);
+					if (bOverlaps) {
+						deferred.push_back(eid);
+					} else {
+						for (int vid : region)
+							claimed_round[vid] = round;
+						batch.push_back(eid);
+						// bounds the list insertions of a split (7) or collapse (< region size)
+						nEdgeListInserts += (int)region.size() + 7;
+					}
+				}
+			}
+
+			// not worth a parallel round, finish the remaining edges serially
+			if ((int)batch.size() < ParallelRefinementMinBatch) {
+				for (int eid : candidates) {
+					if (mesh->IsEdge(eid))
+						count_result(stats, ProcessEdge(eid));
+					if (Cancelled())
+						return false;
+				}
+				break;
+			}
+
+			process_edges_concurrently(batch, nEdgeListInserts, stats);
+			if (Cancelled())
+				return false;
+			pending.swap(deferred);
+		}
+
+		// edges next to constraints, which cannot be updated concurrently
+		for (int eid : serial_edges) {
+			if (mesh->IsEdge(eid))
+				count_result(stats, ProcessEdge(eid));
+			if (Cancelled())
+				return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Edge-refinement loop of BasicRemeshPass when EdgeOrder == Priority.
+	/// Runs a split, a collapse and a flip phase, as in Botsch and Kobbelt's remeshing
+	/// algorithm. In each phase the edges that need the op are put in a min-heap keyed by
+	/// edge_priority() (the edges furthest outside [MinEdgeLength,MaxEdgeLength], or with
+	/// the largest valence improvement, first), and the top edge is processed until the heap
+	/// is empty. After a successful op, the edges of the vertices whose position or valence
+	/// changed are evaluated again and (re-)queued. Each phase only makes progress in one
+	/// direction (shorter edges, fewer vertices, lower valence error), so unlike a single
+	/// queue for all ops, ops cannot undo each other in an endless cycle. In the split phase
+	/// only edges shorter than the split edge are re-queued: next to an edge that cannot be
+	/// split (eg constrained) and is more than twice MaxEdgeLength, each split would otherwise
+	/// create another long edge to it, in an endless fan.
+	/// The first phase starts from the edges of start_edges()/next_edge(), the later
+	/// phases from the edges changed by the earlier phases. Returns false if cancelled.
+	/// </summary>
+	virtual bool PriorityRefinePass(RemeshPassStats &stats) {
+		std::vector<int> seeds;
+		int cur_eid = start_edges();
+		bool done = false;
+		do {
+			if (mesh->IsEdge(cur_eid))
+				seeds.push_back(cur_eid);
+			cur_eid = next_edge(cur_eid, done);
+		} while (done == false);
+
+		// ProcessEdge() tries all enabled ops, so only enable the op of the current phase
+		bool bEnableSplits = EnableSplits, bEnableCollapses = EnableCollapses, bEnableFlips = EnableFlips;
+		EnableSplits = EnableCollapses = EnableFlips = false;
+		bool bCancelled = false;
+		std::vector<int> changed_edges;
+		if (bEnableSplits && bCancelled == false) {
+			EnableSplits = true;
+			bCancelled = priority_phase(PriorityPhase::Split, seeds, changed_edges, stats) == false;
+			EnableSplits = false;
+			seeds.insert(seeds.end(), changed_edges.begin(), changed_edges.end());
+		}
+		if (bEnableCollapses && bCancelled == false) {
+			EnableCollapses = true;
+			bCancelled = priority_phase(PriorityPhase::Collapse, seeds, changed_edges, stats) == false;
+			EnableCollapses = false;
+			seeds.insert(seeds.end(), changed_edges.begin(), changed_edges.end());
+		}
+		if (bEnableFlips && bCancelled == false) {
+			EnableFlips = true;
+			bCancelled = priority_phase(PriorityPhase::Flip, seeds, changed_edges, stats) == false;
+		}
+		EnableSplits = bEnableSplits;
+		EnableCollapses = bEnableCollapses;
+		EnableFlips = bEnableFlips;
+		return bCancelled == false;
 	}
 
 	// subclasses can override these to implement custom behavior...
+	// In parallel refinement they are called concurrently, for edges whose
+	// neighbourhoods do not overlap.
 
 	virtual void OnEdgeSplit(int edgeID, int va, int vb,
 			const DMesh3::EdgeSplitInfo &splitInfo) {
@@ -327,30 +903,36 @@ protected:
 	const int nPrime = 31337; // any prime will do...
 	int nMaxEdgeID;
 	virtual int start_edges() {
+		if (active_pass) {
+			active_edge_index = 0;
+			return (active_edges.empty()) ? InvalidID : active_edges[0];
+		}
 		nMaxEdgeID = mesh->MaxEdgeID();
 		return 0;
 	}
 
 	virtual int next_edge(int cur_eid, bool &bDone) {
+		if (active_pass) {
+			// same modulo-index loop, over the indices into the active edge list
+			int N = (int)active_edges.size();
+			if (N == 0) {
+				bDone = true;
+				return InvalidID;
+			}
+			active_edge_index = (active_edge_index + ((N % nPrime == 0) ? 1 : nPrime)) % N;
+			bDone = (active_edge_index == 0);
+			return active_edges[active_edge_index];
+		}
 		int new_eid = (cur_eid + nPrime) % nMaxEdgeID;
 		bDone = (new_eid == 0);
 		return new_eid;
 	}
 
-	enum class ProcessResult {
-		Ok_Collapsed,
-		Ok_Flipped,
-		Ok_Split,
-		Ignored_EdgeIsFine,
-		Ignored_EdgeIsFullyConstrained,
-		Failed_OpNotSuccessful,
-		Failed_NotAnEdge
-	};
-
 	virtual ProcessResult ProcessEdge(int edgeID) {
 		RuntimeDebugCheck(edgeID);
 
-		EdgeConstraint constraint = (constraints == nullptr) ? EdgeConstraint::Unconstrained() : constraints->GetEdgeConstraint(edgeID);
+		// reference into the constraint table, only valid until constraints are modified below
+		const EdgeConstraint &constraint = (constraints == nullptr) ? MeshConstraints::UnconstrainedEdge() : constraints->GetEdgeConstraint(edgeID);
 		if (constraint.NoModifications())
 			return ProcessResult::Ignored_EdgeIsFullyConstrained;
 
@@ -367,6 +949,8 @@ protected:
 		Vector3d vA = mesh->GetVertex(a);
 		Vector3d vB = mesh->GetVertex(b);
 		double edge_len_sqr = (vA - vB).squaredNorm();
+		double fMinSqr, fMaxSqr;
+		double fTargetLength = get_edge_length_limits(a, b, fMinSqr, fMaxSqr);
 
 		begin_collapse();
 
@@ -375,7 +959,7 @@ protected:
 		int collapse_to = -1;
 		bool bCanCollapse =
 				EnableCollapses && constraint.CanCollapse() &&
-				edge_len_sqr < MinEdgeLength * MinEdgeLength &&
+				edge_len_sqr < fMinSqr &&
 				can_collapse_constraints(edgeID, a, b, c, d, t0, t1, collapse_to);
 
 		// optimization: if edge cd exists, we cannot collapse or flip. look that up
@@ -397,7 +981,16 @@ protected:
 				iKeep = a;
 				iCollapse = b;
 				vNewPos = vA;
-			} else
+			}
+
+			// In priority order, collapses run after the split phase, so do not create
+			// edges that are longer than MaxEdgeLength again. Checked before projecting
+			// the new position, as projection is much more expensive.
+			if (EdgeOrder == EdgeOrders::Priority &&
+					(collapse_creates_long_edge(iKeep, iCollapse, vNewPos) || collapse_creates_long_edge(iCollapse, iKeep, vNewPos)))
+				goto abort_collapse;
+
+			if (collapse_to != a && collapse_to != b)
 				vNewPos = get_projected_collapse_position(iKeep, vNewPos);
 
 			// if new position would flip normal of one of the existing triangles
@@ -418,6 +1011,9 @@ protected:
 			MeshResult result = mesh->CollapseEdge(iKeep, iCollapse, collapseInfo);
 			if (result == MeshResult::Ok) {
 				mesh->SetVertex(iKeep, vNewPos);
+				mark_touched(iKeep);
+				set_vertex_target_length(iKeep, fTargetLength);
+				set_vertex_target_length(iCollapse, 0);
 				if (constraints != nullptr) {
 					constraints->ClearEdgeConstraint(edgeID);
 					constraints->ClearEdgeConstraint(collapseInfo.eRemoved0);
@@ -428,6 +1024,7 @@ protected:
 				OnEdgeCollapse(edgeID, iKeep, iCollapse, collapseInfo);
 				DoDebugChecks();
 
+				end_collapse();
 				return ProcessResult::Ok_Collapsed;
 			} else
 				bTriedCollapse = true;
@@ -440,35 +1037,7 @@ protected:
 		// if this is not a boundary edge, maybe we want to flip
 		bool bTriedFlip = false;
 		if (EnableFlips && constraint.CanFlip() && bIsBoundaryEdge == false) {
-			// can we do this more efficiently somehow?
-			bool a_is_boundary_vtx =
-					(MeshIsClosed) ? false : (bIsBoundaryEdge || mesh->IsBoundaryVertex(a));
-			bool b_is_boundary_vtx =
-					(MeshIsClosed) ? false : (bIsBoundaryEdge || mesh->IsBoundaryVertex(b));
-			bool c_is_boundary_vtx =
-					(MeshIsClosed) ? false : mesh->IsBoundaryVertex(c);
-			bool d_is_boundary_vtx =
-					(MeshIsClosed) ? false : mesh->IsBoundaryVertex(d);
-			int valence_a = mesh->GetVtxEdgeCount(a),
-				valence_b = mesh->GetVtxEdgeCount(b);
-			int valence_c = mesh->GetVtxEdgeCount(c),
-				valence_d = mesh->GetVtxEdgeCount(d);
-			int valence_a_target = (a_is_boundary_vtx) ? valence_a : 6;
-			int valence_b_target = (b_is_boundary_vtx) ? valence_b : 6;
-			int valence_c_target = (c_is_boundary_vtx) ? valence_c : 6;
-			int valence_d_target = (d_is_boundary_vtx) ? valence_d : 6;
-
-			// if total valence error improves by flip, we want to do it
-			int curr_err = abs(valence_a - valence_a_target) +
-						   abs(valence_b - valence_b_target) +
-						   abs(valence_c - valence_c_target) +
-						   abs(valence_d - valence_d_target);
-			int flip_err = abs((valence_a - 1) - valence_a_target) +
-						   abs((valence_b - 1) - valence_b_target) +
-						   abs((valence_c + 1) - valence_c_target) +
-						   abs((valence_d + 1) - valence_d_target);
-
-			bool bTryFlip = flip_err < curr_err;
+			bool bTryFlip = flip_improves_valence(a, b, c, d);
 			if (bTryFlip && PreventNormalFlips &&
 					flip_inverts_normals(a, b, c, d, t0))
 				bTryFlip = false;
@@ -478,7 +1047,9 @@ protected:
 				COUNT_FLIPS++;
 				MeshResult result = mesh->FlipEdge(edgeID, flipInfo);
 				if (result == MeshResult::Ok) {
+					mark_touched(a, b, c, d);
 					DoDebugChecks();
+					end_flip();
 					return ProcessResult::Ok_Flipped;
 				} else
 					bTriedFlip = true;
@@ -491,14 +1062,18 @@ protected:
 		// if edge length is too long, we want to split it
 		bool bTriedSplit = false;
 		if (EnableSplits && constraint.CanSplit() &&
-				edge_len_sqr > MaxEdgeLength * MaxEdgeLength) {
+				edge_len_sqr > fMaxSqr) {
 			DMesh3::EdgeSplitInfo splitInfo;
 			COUNT_SPLITS++;
 			MeshResult result = mesh->SplitEdge(edgeID, splitInfo);
 			if (result == MeshResult::Ok) {
 				update_after_split(edgeID, a, b, splitInfo);
+				mark_touched(splitInfo.vNew);
+				set_vertex_target_length(splitInfo.vNew, fTargetLength);
+				clear_vertex_control(splitInfo.vNew);
 				OnEdgeSplit(edgeID, a, b, splitInfo);
 				DoDebugChecks();
+				end_split();
 				return ProcessResult::Ok_Split;
 			} else
 				bTriedSplit = true;
@@ -512,6 +1087,332 @@ protected:
 			return ProcessResult::Ignored_EdgeIsFine;
 	}
 
+	// true if flipping interior edge [a,b] (with opposing vertices c,d) reduces the total
+	// deviation of the four vertex valences from their targets (6, or current valence at boundaries)
+	bool flip_improves_valence(int a, int b, int c, int d) {
+		return flip_valence_gain(a, b, c, d) > 0;
+	}
+
+	// reduction of the total valence deviation by flipping [a,b] to [c,d], see flip_improves_valence()
+	int flip_valence_gain(int a, int b, int c, int d) {
+		// can we do this more efficiently somehow?
+		bool a_is_boundary_vtx =
+				(MeshIsClosed) ? false : mesh->IsBoundaryVertex(a);
+		bool b_is_boundary_vtx =
+				(MeshIsClosed) ? false : mesh->IsBoundaryVertex(b);
+		bool c_is_boundary_vtx =
+				(MeshIsClosed) ? false : mesh->IsBoundaryVertex(c);
+		bool d_is_boundary_vtx =
+				(MeshIsClosed) ? false : mesh->IsBoundaryVertex(d);
+		int valence_a = mesh->GetVtxEdgeCount(a),
+			valence_b = mesh->GetVtxEdgeCount(b);
+		int valence_c = mesh->GetVtxEdgeCount(c),
+			valence_d = mesh->GetVtxEdgeCount(d);
+		int valence_a_target = (a_is_boundary_vtx) ? valence_a : 6;
+		int valence_b_target = (b_is_boundary_vtx) ? valence_b : 6;
+		int valence_c_target = (c_is_boundary_vtx) ? valence_c : 6;
+		int valence_d_target = (d_is_boundary_vtx) ? valence_d : 6;
+
+		// if total valence error improves by flip, we want to do it
+		int curr_err = abs(valence_a - valence_a_target) +
+					   abs(valence_b - valence_b_target) +
+					   abs(valence_c - valence_c_target) +
+					   abs(valence_d - valence_d_target);
+		int flip_err = abs((valence_a - 1) - valence_a_target) +
+					   abs((valence_b - 1) - valence_b_target) +
+					   abs((valence_c + 1) - valence_c_target) +
+					   abs((valence_d + 1) - valence_d_target);
+		return curr_err - flip_err;
+	}
+
+	// true if moving vid to vNewPos makes one of its edges (except the one to vother) longer than the max edge length
+	bool collapse_creates_long_edge(int vid, int vother, const Vector3d &vNewPos) {
+		double fMinSqr, fMaxSqr;
+		get_edge_length_limits(vid, vother, fMinSqr, fMaxSqr);
+		for (int nbr_vid : mesh->VtxVerticesItr(vid)) {
+			if (nbr_vid == vother)
+				continue;
+			if (SizingField != nullptr)
+				get_edge_length_limits(vid, nbr_vid, fMinSqr, fMaxSqr);
+			if ((mesh->GetVertex(nbr_vid) - vNewPos).squaredNorm() > fMaxSqr)
+				return true;
+		}
+		return false;
+	}
+
+	// per-vertex VertexControl flags, see SetVertexControl()
+	std::vector<unsigned char> vertex_controls;
+
+	VertexControl get_vertex_control(int vid) const {
+		if (VertexControlF != nullptr)
+			return VertexControlF(vid);
+		return GetVertexControl(vid);
+	}
+
+	// split vertices may re-use the ID of a removed vertex that had flags
+	void clear_vertex_control(int vid) {
+		if (vid < (int)vertex_controls.size())
+			vertex_controls[vid] = 0;
+	}
+
+	// target edge length of each vertex, evaluated from SizingField at the start of each pass.
+	// 0 if unknown, eg for vertices created by (possibly concurrent) splits beyond the end of
+	// the array, see vertex_target_length()
+	std::vector<double> vertex_lengths;
+
+	virtual void update_vertex_lengths() {
+		if (SizingField == nullptr) {
+			vertex_lengths.clear();
+			return;
+		}
+		vertex_lengths.resize(mesh->MaxVertexID(), 0);
+		auto update = [&](int vid) {
+			vertex_lengths[vid] = SizingField->TargetEdgeLength(mesh->GetVertex(vid), vid);
+		};
+		// in an active pass only the lengths around the active edges are needed
+		if (active_pass)
+			apply_to_active_region(update, true);
+		else
+			parallel_apply_to_vertices(update);
+	}
+
+	double vertex_target_length(int vid) {
+		double fLength = (vid < (int)vertex_lengths.size()) ? vertex_lengths[vid] : 0;
+		return (fLength > 0) ? fLength : SizingField->TargetEdgeLength(mesh->GetVertex(vid), vid);
+	}
+
+	// only existing entries are written, as the array cannot grow during concurrent ops
+	void set_vertex_target_length(int vid, double fLength) {
+		if (vid < (int)vertex_lengths.size())
+			vertex_lengths[vid] = fLength;
+	}
+
+	// Squared min/max length of edge [a,b]: MinEdgeLength/MaxEdgeLength, or with a SizingField
+	// MinEdgeLengthFactor/MaxEdgeLengthFactor times the mean target length of a and b.
+	// Returns that mean target length, or 0 if there is no SizingField.
+	double get_edge_length_limits(int a, int b, double &fMinSqr, double &fMaxSqr) {
+		if (SizingField == nullptr) {
+			fMinSqr = MinEdgeLength * MinEdgeLength;
+			fMaxSqr = MaxEdgeLength * MaxEdgeLength;
+			return 0;
+		}
+		double fTarget = 0.5 * (vertex_target_length(a) + vertex_target_length(b));
+		fMinSqr = fTarget * fTarget * MinEdgeLengthFactor * MinEdgeLengthFactor;
+		fMaxSqr = fTarget * fTarget * MaxEdgeLengthFactor * MaxEdgeLengthFactor;
+		return fTarget;
+	}
+
+	void count_result(RemeshPassStats &stats, ProcessResult result) {
+		stats.ResultCounts[(int)result]++;
+		if (result == ProcessResult::Ok_Collapsed ||
+				result == ProcessResult::Ok_Flipped ||
+				result == ProcessResult::Ok_Split)
+			ModifiedEdgesLastPass++;
+	}
+
+	bool use_parallel_refinement() {
+		// per-op profiling scopes and debug checks are not thread-safe
+		return EnableParallelRefinement && ENABLE_PROFILING == false && ENABLE_DEBUG_CHECKS == false;
+	}
+
+	enum EdgeOpNeed { NotAnEdge = 0,
+		EdgeIsFine = 1,
+		EdgeNeedsSplitOrFlip = 2,
+		EdgeNeedsCollapse = 3 };
+
+	// Cheap read-only test for whether ProcessEdge() might modify edge eid, ignoring
+	// constraints and normal-flip checks (which ProcessEdge still applies).
+	// Called concurrently for different edges.
+	virtual EdgeOpNeed edge_needs_op(int eid) {
+		int a = 0, b = 0, t0 = 0, t1 = 0;
+		if (mesh->IsEdge(eid) == false || mesh->GetEdge(eid, a, b, t0, t1) == false)
+			return NotAnEdge;
+		double edge_len_sqr = (mesh->GetVertex(a) - mesh->GetVertex(b)).squaredNorm();
+		double fMinSqr, fMaxSqr;
+		get_edge_length_limits(a, b, fMinSqr, fMaxSqr);
+		if (EnableCollapses && edge_len_sqr < fMinSqr)
+			return EdgeNeedsCollapse;
+		if (EnableSplits && edge_len_sqr > fMaxSqr)
+			return EdgeNeedsSplitOrFlip;
+		if (EnableFlips && t1 != InvalidID) {
+			Index2i ov = mesh->GetEdgeOpposingV(eid);
+			if (flip_improves_valence(a, b, ov[0], ov[1]))
+				return EdgeNeedsSplitOrFlip;
+		}
+		return EdgeIsFine;
+	}
+
+	enum class PriorityPhase { Split,
+		Collapse,
+		Flip };
+
+	// edge_priority() value of edges that do not need the op of the phase
+	static constexpr double NoOpPriority = 0.0;
+	// in the split phase, edges are only re-queued if shorter than this ratio times the split edge
+	static constexpr double SplitRequeueRatio = 0.95;
+
+	// Heap key of edge eid in the given phase of priority refinement, lower is processed
+	// first. Minus the ratio by which the edge is too long (Split) or too short (Collapse),
+	// or minus the valence improvement of flipping it (Flip), or NoOpPriority.
+	virtual double edge_priority(int eid, PriorityPhase phase) {
+		int a = 0, b = 0, t0 = 0, t1 = 0;
+		if (mesh->GetEdge(eid, a, b, t0, t1) == false)
+			return NoOpPriority;
+		if (constraints != nullptr && constraints->GetEdgeConstraint(eid).NoModifications())
+			return NoOpPriority;
+		if (phase == PriorityPhase::Flip) {
+			if (t1 == InvalidID)
+				return NoOpPriority;
+			Index2i ov = mesh->GetEdgeOpposingV(eid);
+			return -(double)std::max(0, flip_valence_gain(a, b, ov[0], ov[1]));
+		}
+		double edge_len = (mesh->GetVertex(a) - mesh->GetVertex(b)).norm();
+		double fMinSqr, fMaxSqr;
+		get_edge_length_limits(a, b, fMinSqr, fMaxSqr);
+		double fMinLength = std::sqrt(fMinSqr), fMaxLength = std::sqrt(fMaxSqr);
+		if (phase == PriorityPhase::Split)
+			return (edge_len > fMaxLength) ? -edge_len / fMaxLength : NoOpPriority;
+		return (edge_len < fMinLength) ? -fMinLength / std::max(edge_len, std::numeric_limits<double>::min()) : NoOpPriority;
+	}
+
+	// One phase of PriorityRefinePass(), starting from the seed edges. The edges that were
+	// re-queued after an op are returned in changed_edges. Returns false if cancelled.
+	bool priority_phase(PriorityPhase phase, const std::vector<int> &seeds, std::vector<int> &changed_edges, RemeshPassStats &stats) {
+		// Heap entries are [eid, stamp]. Re-queuing an edge gives it a new stamp, and entries
+		// whose stamp is not the current queue_stamp[eid] are skipped, instead of updating the
+		// heap records in place (which MinHeap invalidates when it grows).
+		std::vector<int> queue_stamp(mesh->MaxEdgeID(), 0);
+		int nStamp = 0;
+		int nHeapSize = std::max(1024, (int)seeds.size() / 4);
+		Wm5::MinHeap<Index2i, double> heap(nHeapSize, nHeapSize, 0.0);
+		auto push = [&](int eid) {
+			if ((size_t)eid >= queue_stamp.size())
+				queue_stamp.resize(std::max((size_t)mesh->MaxEdgeID(), 2 * queue_stamp.size()), 0);
+			double priority = edge_priority(eid, phase);
+			if (priority < NoOpPriority) {
+				queue_stamp[eid] = ++nStamp;
+				heap.Insert(Index2i(eid, nStamp), priority);
+			} else
+				queue_stamp[eid] = 0;
+		};
+		for (int eid : seeds) {
+			if (mesh->IsEdge(eid))
+				push(eid);
+		}
+
+		changed_edges.clear();
+		std::vector<int> changed_vertices;
+		while (heap.GetNumElements() > 0) {
+			Index2i entry;
+			double priority;
+			heap.Remove(entry, priority);
+			int eid = entry[0];
+			if (queue_stamp[eid] != entry[1])
+				continue;
+			queue_stamp[eid] = 0;
+
+			Index2i ev = mesh->GetEdgeV(eid);
+			Index2i ov = mesh->GetEdgeOpposingV(eid);
+			double fRequeueSqr = SplitRequeueRatio * SplitRequeueRatio * (mesh->GetVertex(ev[0]) - mesh->GetVertex(ev[1])).squaredNorm();
+			ProcessResult result = ProcessEdge(eid);
+			count_result(stats, result);
+			if (Cancelled())
+				return false;
+
+			// split: new vertex (at the other end of eid) and the opposing vertices change valence.
+			// collapse: kept vertex moves, opposing vertices change valence. flip: all four change valence
+			changed_vertices.clear();
+			if (result == ProcessResult::Ok_Split) {
+				Index2i new_ev = mesh->GetEdgeV(eid);
+				changed_vertices.push_back((new_ev[0] == ev[0] || new_ev[0] == ev[1]) ? new_ev[1] : new_ev[0]);
+			} else if (result == ProcessResult::Ok_Collapsed) {
+				changed_vertices.push_back(mesh->IsVertex(ev[0]) ? ev[0] : ev[1]);
+			} else if (result == ProcessResult::Ok_Flipped) {
+				changed_vertices.push_back(ev[0]);
+				changed_vertices.push_back(ev[1]);
+			} else
+				continue;
+			for (int j = 0; j < 2; ++j) {
+				if (ov[j] != InvalidID)
+					changed_vertices.push_back(ov[j]);
+			}
+			for (int vid : changed_vertices) {
+				for (int nbr_eid : mesh->VtxEdgesItr(vid)) {
+					changed_edges.push_back(nbr_eid);
+					if (phase == PriorityPhase::Split) {
+						Index2i nbr_ev = mesh->GetEdgeV(nbr_eid);
+						if ((mesh->GetVertex(nbr_ev[0]) - mesh->GetVertex(nbr_ev[1])).squaredNorm() >= fRequeueSqr)
+							continue;
+					}
+					push(nbr_eid);
+				}
+			}
+		}
+		return true;
+	}
+
+	// Collect the vertices that ProcessEdge(eid) may read or write: for a collapse, the edge
+	// vertices and their one-rings (which include the opposing vertices). A split or flip
+	// only changes the edge triangles, so there it is the edge and opposing vertices.
+	// Returns false if the edge vertices or any of their edges are constrained, as ops there
+	// update the constraint tables, which are not thread-safe.
+	bool get_refinement_region(int eid, bool bCollapse, std::vector<int> &region) {
+		bool bCheckConstraints = constraints != nullptr && constraints->HasConstraints();
+		Index2i ev = mesh->GetEdgeV(eid);
+		region.clear();
+		for (int j = 0; j < 2; ++j) {
+			if (bCheckConstraints && constraints->HasVertexConstraint(ev[j]))
+				return false;
+			region.push_back(ev[j]);
+			if (bCollapse == false && bCheckConstraints == false)
+				continue;
+			for (int nbr_eid : mesh->VtxEdgesItr(ev[j])) {
+				if (bCheckConstraints && constraints->HasEdgeConstraint(nbr_eid))
+					return false;
+				if (bCollapse) {
+					Index2i nbr_ev = mesh->GetEdgeV(nbr_eid);
+					region.push_back((nbr_ev[0] == ev[j]) ? nbr_ev[1] : nbr_ev[0]);
+				}
+			}
+		}
+		if (bCollapse == false) {
+			Index2i ov = mesh->GetEdgeOpposingV(eid);
+			region.push_back(ov[0]);
+			if (ov[1] != InvalidID)
+				region.push_back(ov[1]);
+		}
+		return true;
+	}
+
+	// run ProcessEdge() concurrently for a set of edges with disjoint neighbourhoods.
+	// Each edge gets its own DMesh3 concurrent-edit slot, with room for one split.
+	// As in parallel_apply_to_vertices(), the first exception is rethrown afterwards.
+	void process_edges_concurrently(const std::vector<int> &edge_ids, int nEdgeListInserts, RemeshPassStats &stats) {
+		int N = (int)edge_ids.size();
+		std::vector<ProcessResult> results(N, ProcessResult::Ignored_EdgeIsFine);
+		std::exception_ptr first_error = nullptr;
+		std::mutex error_lock;
+		mesh->BeginConcurrentEdits(N, 1, 2, 3, nEdgeListInserts);
+		parallel_for_blocks(0, N, [&](int i0, int i1) {
+			profile_scope block_scope(worker_profiler(), worker_label);
+			try {
+				for (int k = i0; k < i1; ++k) {
+					DMesh3::ConcurrentEditScope slot(k);
+					results[k] = ProcessEdge(edge_ids[k]);
+				}
+			} catch (...) {
+				std::lock_guard<std::mutex> l(error_lock);
+				if (first_error == nullptr)
+					first_error = std::current_exception();
+			}
+		});
+		mesh->EndConcurrentEdits();
+		if (first_error != nullptr)
+			std::rethrow_exception(first_error);
+		for (ProcessResult result : results)
+			count_result(stats, result);
+	}
+
 	// After we split an edge, we have created a new edge and a new vertex.
 	// The edge needs to inherit the constraint on the other pre-existing edge
 	// that we kept. In addition, if the edge vertices were both constrained, then
@@ -541,12 +1442,13 @@ protected:
 
 			// vert inherits Fixed if both orig edge verts Fixed, and both tagged with
 			// same SetID
+			// copies, because setting the vNew constraint below can move the table entries
 			VertexConstraint ca = constraints->GetVertexConstraint(va);
 			VertexConstraint cb = constraints->GetVertexConstraint(vb);
 			if (ca.Fixed && cb.Fixed) {
 				int nSetID = (ca.FixedSetID > 0 && ca.FixedSetID == cb.FixedSetID) ? ca.FixedSetID : VertexConstraint::InvalidSetID;
 				constraints->SetOrUpdateVertexConstraint(
-						splitInfo.vNew, new VertexConstraint(true, nSetID));
+						splitInfo.vNew, VertexConstraint(true, nSetID));
 				bPositionFixed = true;
 			}
 
@@ -565,7 +1467,7 @@ protected:
 					set_target = edge_target;
 				if (set_target != nullptr) {
 					constraints->SetOrUpdateVertexConstraint(
-							splitInfo.vNew, new VertexConstraint(set_target));
+							splitInfo.vNew, VertexConstraint(set_target));
 					project_vertex(splitInfo.vNew, set_target);
 					bPositionFixed = true;
 				}
@@ -588,7 +1490,7 @@ protected:
 	virtual Vector3d get_projected_collapse_position(int vid,
 			const Vector3d &vNewPos) {
 		if (constraints != nullptr) {
-			VertexConstraint vc = constraints->GetVertexConstraint(vid);
+			const VertexConstraint &vc = constraints->GetVertexConstraint(vid);
 			if (vc.Target != nullptr)
 				return vc.Target->Project(vNewPos, vid);
 			if (vc.Fixed)
@@ -596,8 +1498,7 @@ protected:
 		}
 		// no constraint applied, so if we have a target surface, project to that
 		if (EnableInlineProjection() && target != nullptr) {
-			if (VertexControlF == nullptr ||
-					((int)VertexControlF(vid) & (int)VertexControl::NoProject) == 0)
+			if (((int)get_vertex_control(vid) & (int)VertexControl::NoProject) == 0)
 				return target->Project(vNewPos, vid);
 		}
 		return vNewPos;
@@ -607,82 +1508,296 @@ protected:
 		return mesh->VertexIndices();
 	}
 
-	virtual void FullSmoothPass_Buffer(bool bParallel) {
-		InitializeVertexBufferForPass();
+	// Smoothing kernels, kernel(mesh, vID, t) returns the smoothed position of vertex vID.
+	// They are template arguments, so the per-vertex smoothing code can be inlined.
+	struct UniformSmoothKernel {
+		Vector3d operator()(const DMesh3 &mesh, int vID, double t) const {
+			Vector3d c;
+			mesh.VtxOneRingCentroid(vID, c);
+			return (1.0 - t) * mesh.GetVertex(vID) + t * c;
+		}
+	};
+	struct CotanSmoothKernel {
+		Vector3d operator()(const DMesh3 &mesh, int vID, double t) const {
+			return (1.0 - t) * mesh.GetVertex(vID) + t * CotanCentroid(mesh, vID);
+		}
+	};
+	struct CachedCotanSmoothKernel {
+		const dvector<double> &edge_weights;
+		Vector3d operator()(const DMesh3 &mesh, int vID, double t) const {
+			return (1.0 - t) * mesh.GetVertex(vID) + t * CotanCentroid(mesh, vID, edge_weights);
+		}
+	};
+	struct MeanValueSmoothKernel {
+		Vector3d operator()(const DMesh3 &mesh, int vID, double t) const {
+			return (1.0 - t) * mesh.GetVertex(vID) + t * MeanValueCentroid(mesh, vID);
+		}
+	};
+	struct CustomSmoothKernel {
+		const std::function<Vector3d(DMesh3Ptr, int, double)> &smoothF;
+		DMesh3Ptr mesh;
+		Vector3d operator()(const DMesh3 &, int vID, double t) const {
+			return smoothF(mesh, vID, t);
+		}
+	};
 
-		std::function<Vector3d(DMesh3Ptr, int, double)> smoothFunc =
-				UniformSmooth;
+	// call f(kernel) with the kernel for CustomSmoothF or SmoothType
+	template <class Func>
+	void dispatch_smooth_kernel(const Func &f) {
 		if (CustomSmoothF != nullptr) {
-			smoothFunc = CustomSmoothF;
-		} else if (SmoothType == Remesher::SmoothTypes::Cotan) {
-			smoothFunc = Remesher::CotanSmooth;
-		}
-
-		// TODO 2021-06-29 Add back parallel
-		for (int vID : smooth_vertices()) {
-			bool bModified = false;
-			Vector3d vSmoothed = ComputeSmoothedVertexPos(vID, smoothFunc, bModified);
-			if (bModified) {
-				vModifiedV[vID] = true;
-				vBufferV[vID] = vSmoothed;
-			}
+			f(CustomSmoothKernel{ CustomSmoothF, mesh });
+			return;
 		}
+		switch (SmoothType) {
+			case SmoothTypes::Uniform:
+				f(UniformSmoothKernel());
+				break;
+			case SmoothTypes::Cotan:
+				f(CotanSmoothKernel());
+				break;
+			case SmoothTypes::MeanValue:
+				f(MeanValueSmoothKernel());
+				break;
+		}
+	}
+
+	// each vertex only reads the (unmodified) mesh and writes its own buffer
+	// slots, so the result does not depend on order or thread count
+	template <class SmoothKernel>
+	void smooth_vertex_to_buffer(int vID, const SmoothKernel &kernel) {
+		bool bModified = false;
+		Vector3d vSmoothed = compute_smoothed_vertex_pos(vID, kernel, bModified);
+		if (bModified) {
+			vModifiedV[vID] = true;
+			vBufferV[vID] = vSmoothed;
+		}
+	}
+
+	// move the vertex right away, so the vertices smoothed after it see its new position
+	template <class SmoothKernel>
+	void smooth_vertex_in_place(int vID, const SmoothKernel &kernel) {
+		bool bModified = false;
+		Vector3d vSmoothed = compute_smoothed_vertex_pos(vID, kernel, bModified);
+		if (bModified)
+			mesh->SetVertex(vID, vSmoothed);
+	}
+
+	virtual void FullSmoothPass_InPlace() {
+		dispatch_smooth_kernel([&](const auto &kernel) {
+			apply_to_smooth_vertices([&](int vID) { smooth_vertex_in_place(vID, kernel); }, false);
+		});
+	}
 
+	virtual void FullSmoothPass_Buffer(bool bParallel) {
+		InitializeVertexBufferForPass();
+		auto smooth_vertices = [&](const auto &kernel) {
+			apply_to_smooth_vertices([&](int vID) { smooth_vertex_to_buffer(vID, kernel); }, bParallel);
+		};
+		if (cotan_weights_pass) {
+			update_cotan_weights(bParallel);
+			smooth_vertices(CachedCotanSmoothKernel{ cotan_weights });
+		} else {
+			dispatch_smooth_kernel(smooth_vertices);
+		}
 		ApplyVertexBuffer(bParallel);
 	}
 
-	dvector<Vector3d> vBufferV;
-	std::vector<bool> vModifiedV;
+	//
+	// cotan weight cache, see EnableCotanWeightCache
+	//
+
+	// per-edge weights, see CotanEdgeWeight()
+	dvector<double> cotan_weights;
+	// per-vertex positions the weights were computed with
+	std::vector<Vector3d> cotan_weight_positions;
+	// true if the weights are up to date, except for the vertices moved since the last update
+	// and the vertices touched by ops in this pass
+	bool cotan_weights_valid = false;
+	// true if this pass smooths with the cached weights
+	bool cotan_weights_pass = false;
+	// mesh timestamp at the end of the previous pass, if it was a cotan smoothing pass
+	int cotan_weights_timestamp = -1;
+
+	bool use_cotan_weight_cache() const {
+		return EnableCotanWeightCache && CustomSmoothF == nullptr && SmoothType == SmoothTypes::Cotan &&
+				EnableSmoothing && SmoothSpeedT > 0 && EnableSmoothInPlace == false;
+	}
+
+	// The cache is only used from the second of consecutive cotan smoothing passes on, so a
+	// single pass does not allocate it. The ops of this pass are only recorded (in
+	// touched_vertices) if the weights are still valid, otherwise they are all recomputed.
+	void begin_cotan_weights() {
+		cotan_weights_pass = use_cotan_weight_cache() && active_pass == false &&
+				cotan_weights_timestamp == mesh->Timestamp();
+		cotan_weights_valid = cotan_weights_valid && cotan_weights_pass;
+	}
+
+	// Recompute the weights of the edges with a moved or touched vertex (at either end or
+	// opposite the edge), or all of them if the cache is not valid.
+	void update_cotan_weights(bool bParallel) {
+		int NV = mesh->MaxVertexID(), NE = mesh->MaxEdgeID();
+		bool bRebuild = (cotan_weights_valid == false);
+		cotan_weight_positions.resize(NV, Vector3d::Constant(std::numeric_limits<double>::quiet_NaN()));
+		cotan_weights.resize(NE);
+		scratch_array<unsigned char> vDirty = scratch.make_array<unsigned char>(NV, 0);
+
+		auto update_vertices = [&](int a, int b) {
+			profile_scope block_scope(worker_profiler(), worker_label);
+			for (int vid = a; vid < b; ++vid) {
+				if (mesh->IsVertex(vid) == false)
+					continue;
+				Vector3d v = mesh->GetVertex(vid);
+				if (bRebuild || v != cotan_weight_positions[vid]) {
+					cotan_weight_positions[vid] = v;
+					vDirty[vid] = 1;
+				}
+			}
+		};
+		auto update_edges = [&](int a, int b) {
+			profile_scope block_scope(worker_profiler(), worker_label);
+			for (int eid = a; eid < b; ++eid) {
+				if (mesh->IsEdge(eid) == false)
+					continue;
+				Index2i ev = mesh->GetEdgeV(eid);
+				bool bDirty = bRebuild || vDirty[ev[0]] || vDirty[ev[1]];
+				Index2i ov = mesh->GetEdgeOpposingV(eid);
+				if (bDirty == false)
+					bDirty = vDirty[ov[0]] || (ov[1] != InvalidID && vDirty[ov[1]]);
+				if (bDirty)
+					cotan_weights[eid] = CotanEdgeWeight(*mesh, ev[0], ev[1], ov[0], ov[1]);
+			}
+		};
+		if (bParallel) {
+			parallel_for_blocks(0, NV, update_vertices);
+		} else {
+			update_vertices(0, NV);
+		}
+		for (int vid : touched_vertices) {
+			if (vid < NV)
+				vDirty[vid] = 1;
+		}
+		if (bParallel) {
+			parallel_for_blocks(0, NE, update_edges);
+		} else {
+			update_edges(0, NE);
+		}
+		cotan_weights_valid = true;
+	}
+
+	// smoothed positions, kept between passes. vModifiedV is a byte per vertex (not
+	// std::vector<bool>) so vertices can be flagged concurrently. The flags are all zero
+	// between smoothing phases: ApplyVertexBuffer() resets the flags of the vertices it
+	// moves, so a pass over an active set or region only touches the entries it smoothed.
+	// If a phase ends without ApplyVertexBuffer() (cancelled, abandoned or threw), the next
+	// one clears all flags, see vertex_buffer_clean.
+	std::vector<Vector3d> vBufferV;
+	std::vector<unsigned char> vModifiedV;
+	bool vertex_buffer_clean = true;
 
 	virtual void InitializeVertexBufferForPass() {
-		if (vBufferV.size() < mesh->MaxVertexID())
-			vBufferV.resize(mesh->MaxVertexID() + mesh->MaxVertexID() / 5);
-		if (vModifiedV.size() < mesh->MaxVertexID()) {
-			vModifiedV.resize(2 * mesh->MaxVertexID());
+		size_t NV = (size_t)mesh->MaxVertexID();
+		if (vertex_buffer_clean == false)
+			std::fill(vModifiedV.begin(), vModifiedV.end(), 0);
+		if (vModifiedV.size() < NV) {
+			vBufferV.resize(NV);
+			vModifiedV.resize(NV, 0);
 		}
+		vertex_buffer_clean = false;
+	}
 
-		vModifiedV.assign(vModifiedV.size(), false);
+	// move vid to its smoothed position, if it has one, and reset its flag
+	void apply_buffered_vertex(int vid) {
+		if (vModifiedV[vid]) {
+			mesh->SetVertex(vid, vBufferV[vid]);
+			vModifiedV[vid] = 0;
+		}
 	}
 
+	// overrides must apply (and reset the flags of) all smoothed vertices and set vertex_buffer_clean
 	virtual void ApplyVertexBuffer(bool bParallel) {
-		for (int vid : mesh->VertexIndices()) {
-			if (vModifiedV[vid])
-				mesh->SetVertex(vid, vBufferV[vid]);
+		if (active_pass) {
+			// only the active region was smoothed
+			for (int vid : active_region)
+				apply_buffered_vertex(vid);
+		} else if (bParallel) {
+			parallel_for_blocks(0, std::min((int)vModifiedV.size(), mesh->MaxVertexID()), [&](int a, int b) {
+				profile_scope block_scope(worker_profiler(), worker_label);
+				for (int vid = a; vid < b; ++vid) {
+					if (vModifiedV[vid]) {
+						mesh->SetVertexConcurrent(vid, vBufferV[vid]);
+						vModifiedV[vid] = 0;
+					}
+				}
+			});
+			mesh->UpdateShapeTimestamp();
+		} else {
+			for (int vid : mesh->VertexIndices())
+				apply_buffered_vertex(vid);
 		}
+		vertex_buffer_clean = true;
+	}
 
-		// [TODO] can probably use block-parallel here...
-		// if (bParallel) {
-		//    gParallel.BlockStartEnd(0, mesh->MaxVertexID-1, (a,b) => {
-		//        for (int vid = a; vid <= b; vid++) {
-		//            if (vModifiedV[vid])
-		//                mesh->SetVertex(vid, vBufferV[vid]);
-		//        }
-		//    });
-		//} else {
-		//    foreach (int vid in mesh->VertexIndices()) {
-		//        if (vModifiedV[vid])
-		//            mesh->SetVertex(vid, vBufferV[vid]);
-		//    }
-		//}
+	// call apply_f(vid) for each vertex that should be smoothed. If bParallel,
+	// apply_f is called concurrently for blocks of vertex IDs.
+	virtual void apply_to_smooth_vertices(const std::function<void(int)> &apply_f, bool bParallel) {
+		if (active_pass) {
+			apply_to_active_region(apply_f, bParallel);
+		} else if (bParallel) {
+			parallel_apply_to_vertices(apply_f);
+		} else {
+			for (int vid : smooth_vertices())
+				apply_f(vid);
+		}
+	}
+
+	// call apply_f(vid) for all vertices, concurrently for blocks of vertex IDs.
+	// Pool tasks must not throw, so the first exception thrown by apply_f (eg by a
+	// projection target whose spatial structure is out of date) is caught and
+	// rethrown on the calling thread once all blocks are done.
+	// If vertices is given, apply_f is only called for the vertices in that list.
+	void parallel_apply_to_vertices(const std::function<void(int)> &apply_f, const std::vector<int> *vertices = nullptr) {
+		std::exception_ptr first_error = nullptr;
+		std::mutex error_lock;
+		int N = (vertices != nullptr) ? (int)vertices->size() : mesh->MaxVertexID();
+		parallel_for_blocks(0, N, [&](int a, int b) {
+			profile_scope block_scope(worker_profiler(), worker_label);
+			try {
+				for (int k = a; k < b; ++k) {
+					int vid = (vertices != nullptr) ? (*vertices)[k] : k;
+					if (mesh->IsVertex(vid))
+						apply_f(vid);
+				}
+			} catch (...) {
+				std::lock_guard<std::mutex> l(error_lock);
+				if (first_error == nullptr)
+					first_error = std::current_exception();
+			}
+		});
+		if (first_error != nullptr)
+			std::rethrow_exception(first_error);
 	}
 
 	/// <summary>
 	/// This computes smoothed positions w/ proper constraints/etc.
 	/// Does not modify mesh->
 	/// </summary>
-	virtual Vector3d ComputeSmoothedVertexPos(
-			int vID, std::function<Vector3d(DMesh3Ptr, int, double)> smoothFunc,
+	Vector3d ComputeSmoothedVertexPos(
+			int vID, const std::function<Vector3d(DMesh3Ptr, int, double)> &smoothFunc,
 			bool &bModified) {
+		return compute_smoothed_vertex_pos(vID, CustomSmoothKernel{ smoothFunc, mesh }, bModified);
+	}
+
+	template <class SmoothKernel>
+	Vector3d compute_smoothed_vertex_pos(int vID, const SmoothKernel &kernel, bool &bModified) {
 		bModified = false;
-		VertexConstraint vConstraint = VertexConstraint::Unconstrained();
-		get_vertex_constraint(vID, vConstraint);
+		const VertexConstraint &vConstraint = get_vertex_constraint(vID);
 		if (vConstraint.Fixed)
 			return mesh->GetVertex(vID);
-		VertexControl vControl = (VertexControlF == nullptr) ? VertexControl::AllowAll : VertexControlF(vID);
+		VertexControl vControl = get_vertex_control(vID);
 		if (((int)vControl & (int)VertexControl::NoSmooth) != 0)
 			return mesh->GetVertex(vID);
 
-		Vector3d vSmoothed = smoothFunc(mesh, vID, SmoothSpeedT);
+		Vector3d vSmoothed = kernel(*mesh, vID, SmoothSpeedT);
 		gDevAssert(IsFinite(vSmoothed)); // this will really catch a lot of bugs...
 
 		// project onto either vtx constraint target, or surface target
@@ -697,10 +1812,18 @@ protected:
 		return vSmoothed;
 	}
 
+	// call apply_f(vid) for each vertex that should be projected. If bParallel,
+	// apply_f is called concurrently for blocks of vertex IDs.
 	virtual void
-	apply_to_project_vertices(const std::function<void(int)> &apply_f) {
-		for (int vid : mesh->VertexIndices())
-			apply_f(vid);
+	apply_to_project_vertices(const std::function<void(int)> &apply_f, bool bParallel) {
+		if (active_pass) {
+			apply_to_active_region(apply_f, bParallel);
+		} else if (bParallel) {
+			parallel_apply_to_vertices(apply_f);
+		} else {
+			for (int vid : mesh->VertexIndices())
+				apply_f(vid);
+		}
 	}
 
 	// [RMS] how would we do something like this in C++?
@@ -710,28 +1833,206 @@ protected:
 	//}
 
 	// Project vertices onto projection target.
-	// We can do projection in parallel if we have .net
+	// Each vertex only reads and writes its own position, so the parallel version
+	// gives the same result as the serial one.
 	virtual void FullProjectionPass() {
-		auto project = [&](int vID) {
-			if (vertex_is_constrained(vID))
-				return;
-			if (VertexControlF != nullptr &&
-					((int)VertexControlF(vID) & (int)VertexControl::NoProject) != 0)
-				return;
-			Vector3d curpos = mesh->GetVertex(vID);
-			Vector3d projected = target->Project(curpos, vID);
+		bool bParallel = EnableParallelProjection;
+		apply_to_project_vertices([&](int vID) { project_vertex_to_target(vID, bParallel); }, bParallel);
+		if (bParallel)
+			mesh->UpdateShapeTimestamp();
+	}
+
+	void project_vertex_to_target(int vID, bool bConcurrent) {
+		if (vertex_is_constrained(vID))
+			return;
+		if (((int)get_vertex_control(vID) & (int)VertexControl::NoProject) != 0)
+			return;
+		Vector3d curpos = mesh->GetVertex(vID);
+		Vector3d projected = target->Project(curpos, vID);
+		if (bConcurrent)
+			mesh->SetVertexConcurrent(vID, projected);
+		else
 			mesh->SetVertex(vID, projected);
-		};
+	}
 
-		apply_to_project_vertices(project);
+	//
+	// time-sliced passes, see Step()
+	//
 
-		// [RMS] not sure how to do this...
-		// if (EnableParallelProjection) {
-		//    gParallel.ForEach<int>(project_vertices(), project);
-		//} else {
-		//    foreach (int vid in project_vertices())
-		//        project(vid);
-		//}
+	enum class StepPhase { Idle,
+		Refine,
+		Smooth,
+		Project };
+	StepPhase step_phase = StepPhase::Idle;
+	// mesh timestamp at the end of the previous slice
+	int step_timestamp = -1;
+	// position in the start_edges()/next_edge() sweep
+	int step_eid = InvalidID;
+	bool step_edges_done = false;
+	// vertices to smooth or project in the current phase, and the next one to process
+	std::vector<int> step_vertices;
+	size_t step_vertex_index = 0;
+
+	// collect the vertices of a smoothing or projection phase (none if the phase is disabled)
+	void begin_step_phase(StepPhase phase) {
+		step_phase = phase;
+		step_vertices.clear();
+		step_vertex_index = 0;
+		bool bEnabled = (phase == StepPhase::Smooth) ?
+				(EnableSmoothing && SmoothSpeedT > 0) :
+				(target != nullptr && ProjectionMode == TargetProjectionMode::AfterRefinement);
+		if (bEnabled == false)
+			return;
+		if (phase == StepPhase::Smooth && EnableSmoothInPlace == false)
+			InitializeVertexBufferForPass();
+		auto collect = [&](int vID) { step_vertices.push_back(vID); };
+		if (phase == StepPhase::Smooth)
+			apply_to_smooth_vertices(collect, false);
+		else
+			apply_to_project_vertices(collect, false);
+	}
+
+	//
+	// active set, see EnableActiveSet
+	//
+
+	bool active_set_valid = false;
+	// true if the current pass only processes the active set
+	bool active_pass = false;
+	// mesh and settings the active set was computed for
+	int active_set_timestamp = -1;
+	double active_set_min_len = 0, active_set_max_len = 0;
+	IProjectionTarget *active_set_target = nullptr;
+	ISizingField *active_set_sizing = nullptr;
+	// vertices changed by the previous pass
+	std::vector<int> active_seeds;
+	// edges refined in an active pass, and the position of start_edges()/next_edge() in this list
+	std::vector<int> active_edges;
+	int active_edge_index = 0;
+	// vertices touched by ops in the current pass (ops run concurrently in parallel refinement)
+	std::vector<int> touched_vertices;
+	std::mutex touched_lock;
+	// vertices smoothed/projected in the current pass, and their positions before smoothing
+	std::vector<int> active_region;
+	std::vector<Vector3d> active_region_start;
+
+	void mark_touched(int vid) {
+		if (EnableActiveSet == false && cotan_weights_valid == false)
+			return;
+		std::lock_guard<std::mutex> l(touched_lock);
+		touched_vertices.push_back(vid);
+	}
+	void mark_touched(int a, int b, int c, int d) {
+		if (EnableActiveSet == false && cotan_weights_valid == false)
+			return;
+		std::lock_guard<std::mutex> l(touched_lock);
+		touched_vertices.insert(touched_vertices.end(), { a, b, c, d });
+	}
+
+	// sorted list of the valid vertices in seeds and their one-rings
+	void expand_vertex_region(const std::vector<int> &seeds, std::vector<int> &region) {
+		region.clear();
+		for (int vid : seeds) {
+			if (mesh->IsVertex(vid) == false)
+				continue;
+			region.push_back(vid);
+			for (int nbr_vid : mesh->VtxVerticesItr(vid))
+				region.push_back(nbr_vid);
+		}
+		std::sort(region.begin(), region.end());
+		region.erase(std::unique(region.begin(), region.end()), region.end());
+	}
+
+	// decide if this pass can be restricted to the active set, and if so find the edges to refine
+	virtual void begin_active_set(RemeshPassStats &stats) {
+		active_pass = false;
+		touched_vertices.clear();
+		if (EnableActiveSet == false) {
+			active_set_valid = false;
+			return;
+		}
+		if (active_set_valid == false || active_set_timestamp != mesh->Timestamp() ||
+				active_set_min_len != MinEdgeLength || active_set_max_len != MaxEdgeLength ||
+				active_set_target != target.get() || active_set_sizing != SizingField.get())
+			return;
+
+		expand_vertex_region(active_seeds, active_region);
+		if ((double)active_region.size() > ActiveSetMaxFraction * mesh->VertexCount())
+			return;
+		active_edges.clear();
+		for (int vid : active_region) {
+			for (int eid : mesh->VtxEdgesItr(vid))
+				active_edges.push_back(eid);
+		}
+		std::sort(active_edges.begin(), active_edges.end());
+		active_edges.erase(std::unique(active_edges.begin(), active_edges.end()), active_edges.end());
+
+		active_pass = true;
+		stats.ActiveVertices = (int)active_region.size();
+		stats.ActiveEdges = (int)active_edges.size();
+	}
+
+	// find the vertices to smooth and project after the ops: in an active pass the previous
+	// seeds and the vertices touched by ops, with their one-rings, otherwise all vertices.
+	// Their positions are saved so end_active_set() can tell which ones moved.
+	virtual void begin_active_region() {
+		if (active_pass) {
+			std::vector<int> seeds(active_seeds);
+			seeds.insert(seeds.end(), touched_vertices.begin(), touched_vertices.end());
+			expand_vertex_region(seeds, active_region);
+		} else {
+			active_region.clear();
+			for (int vid : mesh->VertexIndices())
+				active_region.push_back(vid);
+		}
+		active_region_start.resize(active_region.size());
+		for (size_t k = 0; k < active_region.size(); ++k)
+			active_region_start[k] = mesh->GetVertex(active_region[k]);
+	}
+
+	// collect the vertices changed by this pass, which seed the active set of the next pass
+	virtual void end_active_set() {
+		active_seeds.clear();
+		for (int vid : touched_vertices) {
+			if (mesh->IsVertex(vid))
+				active_seeds.push_back(vid);
+		}
+		double fTolSqr = ActiveSetMoveTolerance * MinEdgeLength;
+		fTolSqr *= fTolSqr;
+		for (size_t k = 0; k < active_region.size(); ++k) {
+			int vid = active_region[k];
+			if (mesh->IsVertex(vid) == false)
+				continue;
+			if (SizingField != nullptr) {
+				fTolSqr = ActiveSetMoveTolerance * MinEdgeLengthFactor * vertex_target_length(vid);
+				fTolSqr *= fTolSqr;
+			}
+			if ((mesh->GetVertex(vid) - active_region_start[k]).squaredNorm() > fTolSqr)
+				active_seeds.push_back(vid);
+		}
+		std::sort(active_seeds.begin(), active_seeds.end());
+		active_seeds.erase(std::unique(active_seeds.begin(), active_seeds.end()), active_seeds.end());
+		touched_vertices.clear();
+
+		active_pass = false;
+		active_set_valid = true;
+		active_set_timestamp = mesh->Timestamp();
+		active_set_min_len = MinEdgeLength;
+		active_set_max_len = MaxEdgeLength;
+		active_set_target = target.get();
+		active_set_sizing = SizingField.get();
+	}
+
+	// call apply_f(vid) for the vertices in active_region, concurrently if bParallel
+	void apply_to_active_region(const std::function<void(int)> &apply_f, bool bParallel) {
+		if (bParallel) {
+			parallel_apply_to_vertices(apply_f, &active_region);
+		} else {
+			for (int vid : active_region) {
+				if (mesh->IsVertex(vid))
+					apply_f(vid);
+			}
+		}
 	}
 
 	/*
@@ -773,7 +2074,7 @@ protected:
 	void DebugCheckVertexConstraints() {
 		if (constraints == nullptr)
 			return;
-		for (std::pair<int, VertexConstraint> vc : constraints->Vertices) {
+		for (const auto &vc : constraints->Vertices) {
 			int vid = vc.first;
 			if (vc.second.Target != nullptr) {
 				Vector3d curpos = mesh->GetVertex(vid);
@@ -787,79 +2088,234 @@ protected:
 	}
 
 	//
-	// profiling functions, turn on ENABLE_PROFILING to see output in console
+	// profiling functions. Each pass is timed as a "RemeshPass" scope with
+	// ops/smooth/project children, see Profiler and ENABLE_PROFILING
 	//
-	int COUNT_SPLITS, COUNT_COLLAPSES, COUNT_FLIPS;
-	// Stopwatch AllOpsW, SmoothW, ProjectW, FlipW, SplitW, CollapseW;
+	// atomic as ops run concurrently in parallel refinement
+	std::atomic<int> COUNT_SPLITS{ 0 }, COUNT_COLLAPSES{ 0 }, COUNT_FLIPS{ 0 };
+
+	// profiler used by the current pass, the thread running the pass, and number of scopes it has open
+	LocalProfiler *pass_profiler = nullptr;
+	std::thread::id pass_thread;
+	int pass_profile_depth = 0;
+	// label of the scopes opened by pool threads in the current phase (eg "smooth.worker")
+	const char *worker_label = nullptr;
+
+	// profiler for one block of a parallel loop. Blocks run by the pass thread are
+	// already inside the phase scope, blocks run by pool threads open a worker_label
+	// scope on their own thread, so the Chrome trace shows each thread's timeline
+	LocalProfiler *worker_profiler() const {
+		if (pass_profiler == nullptr || worker_label == nullptr || std::this_thread::get_id() == pass_thread)
+			return nullptr;
+		return pass_profiler;
+	}
 
-	virtual void begin_pass() {
-		if (ENABLE_PROFILING) {
-			COUNT_SPLITS = COUNT_COLLAPSES = COUNT_FLIPS = 0;
-			// AllOpsW = new Stopwatch();
-			// SmoothW = new Stopwatch();
-			// ProjectW = new Stopwatch();
-			// FlipW = new Stopwatch();
-			// SplitW = new Stopwatch();
-			// CollapseW = new Stopwatch();
+	void profile_enter(const char *label) {
+		if (pass_profiler != nullptr) {
+			pass_profiler->Enter(label);
+			pass_profile_depth++;
+		}
+	}
+	void profile_exit() {
+		if (pass_profiler != nullptr && pass_profile_depth > 0) {
+			pass_profiler->Exit();
+			pass_profile_depth--;
 		}
 	}
+	// close any scopes left open, eg if the pass was cancelled
+	void close_pass_profile() {
+		while (pass_profile_depth > 0)
+			profile_exit();
+		pass_profiler = nullptr;
+		worker_label = nullptr;
+	}
 
-	virtual void end_pass() {
-		if (ENABLE_PROFILING) {
-			// System.Console.WriteLine(string.Format(
-			//    "RemeshPass: T {0} V {1} splits {2} flips {3} collapses {4}",
-			//    mesh->TriangleCount, mesh->VertexCount, COUNT_SPLITS, COUNT_FLIPS,
-			//    COUNT_COLLAPSES
-			//    ));
-			// System.Console.WriteLine(string.Format(
-			//    "           Timing1:  ops {0} smooth {1} project {2}",
-			//    Util.ToSecMilli(AllOpsW.Elapsed), Util.ToSecMilli(SmoothW.Elapsed),
-			//    Util.ToSecMilli(ProjectW.Elapsed)
-			//    ));
-			// System.Console.WriteLine(string.Format(
-			//    "           Timing2:  collapse {0} flip {1} split {2}",
-			//    Util.ToSecMilli(CollapseW.Elapsed), Util.ToSecMilli(FlipW.Elapsed),
-			//    Util.ToSecMilli(SplitW.Elapsed)
-			//    ));
+	// start of BasicRemeshPass() and of the first Step() of a pass
+	void start_pass(RemeshPassStats &stats) {
+		stats.VertexCountBefore = mesh->VertexCount();
+		stats.TriangleCountBefore = mesh->TriangleCount();
+
+		// recycle the scratch memory of the previous pass
+		scratch.reset();
+
+		begin_pass();
+		begin_active_set(stats);
+		begin_cotan_weights();
+		update_vertex_lengths();
+	}
+
+	// end of a pass that was not cancelled
+	void finish_pass(RemeshPassStats &stats) {
+		// keep one-ring traversal cache-friendly over many passes
+		if (CompactVertexEdgesFragmentation >= 0 &&
+				mesh->VertexEdgesFragmentation() > CompactVertexEdgesFragmentation)
+			mesh->CompactVertexEdges();
+
+		// end_active_set() ends the active pass, but keeps active_region
+		bool bActivePass = active_pass;
+		if (EnableActiveSet)
+			end_active_set();
+		cotan_weights_timestamp = use_cotan_weight_cache() ? mesh->Timestamp() : -1;
+		end_pass();
+
+		fill_end_of_pass_stats(stats);
+		if (ComputeEdgeLengthStats)
+			compute_edge_length_stats(stats, bActivePass);
+	}
+
+	void fill_end_of_pass_stats(RemeshPassStats &stats) {
+		stats.CollapseAttempts = COUNT_COLLAPSES;
+		stats.FlipAttempts = COUNT_FLIPS;
+		stats.SplitAttempts = COUNT_SPLITS;
+		stats.VertexCountAfter = mesh->VertexCount();
+		stats.TriangleCountAfter = mesh->TriangleCount();
+	}
+
+	RemeshPassStats cancel_pass_stats(std::chrono::steady_clock::time_point pass_start) {
+		close_pass_profile();
+		active_pass = false;
+		active_set_valid = false;
+		LastPassStats.Cancelled = true;
+		fill_end_of_pass_stats(LastPassStats);
+		LastPassStats.TotalTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pass_start).count();
+		return LastPassStats;
+	}
+
+	// over all edges, or with bActiveRegion over the edges of the active_region vertices
+	void compute_edge_length_stats(RemeshPassStats &stats, bool bActiveRegion) {
+		if (bActiveRegion) {
+			// active_edges is not used after the ops
+			active_edges.clear();
+			for (int vid : active_region) {
+				if (mesh->IsVertex(vid) == false)
+					continue;
+				for (int eid : mesh->VtxEdgesItr(vid))
+					active_edges.push_back(eid);
+			}
+			std::sort(active_edges.begin(), active_edges.end());
+			active_edges.erase(std::unique(active_edges.begin(), active_edges.end()), active_edges.end());
 		}
+		struct edge_length_info {
+			int count = 0;
+			double min_len = std::numeric_limits<double>::max(), max_len = 0, sum_len = 0;
+			int shorter = 0, longer = 0;
+			int histogram[RemeshPassStats::HistogramBins] = {};
+		};
+		// lengths are binned relative to the max length, so with a SizingField edges of
+		// different target lengths that are equally far off land in the same bin
+		bool bLocalLimits = (SizingField != nullptr);
+		double fBinScale = RemeshPassStats::HistogramBins / 2.0;
+		edge_length_info info = parallel_reduce(
+				0, bActiveRegion ? (int)active_edges.size() : mesh->MaxEdgeID(), edge_length_info(),
+				[&](int a, int b, edge_length_info accum) {
+					double fMinSqr, fMaxSqr;
+					for (int k = a; k < b; ++k) {
+						int eid = bActiveRegion ? active_edges[k] : k;
+						if (mesh->IsEdge(eid) == false)
+							continue;
+						Index2i ev = mesh->GetEdgeV(eid);
+						double len = (mesh->GetVertex(ev[0]) - mesh->GetVertex(ev[1])).norm();
+						get_edge_length_limits(ev[0], ev[1], fMinSqr, fMaxSqr);
+						accum.count++;
+						accum.min_len = std::min(accum.min_len, len);
+						accum.max_len = std::max(accum.max_len, len);
+						accum.sum_len += len;
+						if (len * len < fMinSqr)
+							accum.shorter++;
+						else if (len * len > fMaxSqr)
+							accum.longer++;
+						double fRatio = len / (bLocalLimits ? sqrt(fMaxSqr) : MaxEdgeLength) * fBinScale;
+						int bin = RemeshPassStats::HistogramBins - 1;
+						if (fRatio < bin) // also false for NaN
+							bin = (int)fRatio;
+						accum.histogram[bin]++;
+					}
+					return accum;
+				},
+				[](edge_length_info x, const edge_length_info &y) {
+					x.count += y.count;
+					x.min_len = std::min(x.min_len, y.min_len);
+					x.max_len = std::max(x.max_len, y.max_len);
+					x.sum_len += y.sum_len;
+					x.shorter += y.shorter;
+					x.longer += y.longer;
+					for (int k = 0; k < RemeshPassStats::HistogramBins; ++k)
+						x.histogram[k] += y.histogram[k];
+					return x;
+				});
+		stats.HasEdgeLengthStats = true;
+		stats.EdgeCount = info.count;
+		stats.EdgeLengthMin = (info.count > 0) ? info.min_len : 0;
+		stats.EdgeLengthMax = info.max_len;
+		stats.EdgeLengthMean = (info.count > 0) ? info.sum_len / info.count : 0;
+		stats.EdgesShorterThanMin = info.shorter;
+		stats.EdgesLongerThanMax = info.longer;
+		for (int k = 0; k < RemeshPassStats::HistogramBins; ++k)
+			stats.EdgeLengthHistogram[k] = info.histogram[k];
+	}
+
+	virtual void begin_pass() {
+		COUNT_SPLITS = COUNT_COLLAPSES = COUNT_FLIPS = 0;
+		close_pass_profile();
+		pass_profiler = (Profiler != nullptr) ? Profiler : LocalProfiler::Active();
+		if (pass_profiler != nullptr && pass_profiler->Enabled() == false)
+			pass_profiler = nullptr;
+		pass_thread = std::this_thread::get_id();
+		profile_enter("RemeshPass");
+	}
+
+	virtual void end_pass() {
+		close_pass_profile();
 	}
 
 	virtual void begin_ops() {
-		// if ( ENABLE_PROFILING ) AllOpsW.Start();
+		profile_enter("ops");
+		worker_label = "ops.worker";
 	}
 	virtual void end_ops() {
-		// if ( ENABLE_PROFILING ) AllOpsW.Stop();
+		worker_label = nullptr;
+		profile_exit();
 	}
 	virtual void begin_smooth() {
-		// if ( ENABLE_PROFILING ) SmoothW.Start();
+		profile_enter("smooth");
+		worker_label = "smooth.worker";
 	}
 	virtual void end_smooth() {
-		// if ( ENABLE_PROFILING ) SmoothW.Stop();
+		worker_label = nullptr;
+		profile_exit();
 	}
 	virtual void begin_project() {
-		// if ( ENABLE_PROFILING ) ProjectW.Start();
+		profile_enter("project");
+		worker_label = "project.worker";
 	}
 	virtual void end_project() {
-		// if ( ENABLE_PROFILING ) ProjectW.Stop();
+		worker_label = nullptr;
+		profile_exit();
 	}
 
 	virtual void begin_collapse() {
-		// if ( ENABLE_PROFILING ) CollapseW.Start();
+		if (ENABLE_PROFILING)
+			profile_enter("collapse");
 	}
 	virtual void end_collapse() {
-		// if ( ENABLE_PROFILING ) CollapseW.Stop();
+		if (ENABLE_PROFILING)
+			profile_exit();
 	}
 	virtual void begin_flip() {
-		// if ( ENABLE_PROFILING ) FlipW.Start();
+		if (ENABLE_PROFILING)
+			profile_enter("flip");
 	}
 	virtual void end_flip() {
-		// if ( ENABLE_PROFILING ) FlipW.Stop();
+		if (ENABLE_PROFILING)
+			profile_exit();
 	}
 	virtual void begin_split() {
-		// if ( ENABLE_PROFILING ) SplitW.Start();
+		if (ENABLE_PROFILING)
+			profile_enter("split");
 	}
 	virtual void end_split() {
-		// if ( ENABLE_PROFILING ) SplitW.Stop();
+		if (ENABLE_PROFILING)
+			profile_exit();
 	}
 };
 
@@ -34,12 +34,19 @@
 #include <DMeshAABBTree3.h>
 #include <SpatialInterfaces.h>
 #include <g3types.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace g3 {
 
 /// <summary>
 /// MeshProjectionTarget provides an IProjectionTarget interface to a mesh + spatial data structure.
 /// Use to project points to mesh surface.
+/// Project() is safe to call concurrently, as long as Mesh is not modified.
+/// In particular Mesh must not be the mesh that is being remeshed (see Auto()).
 /// </summary>
 class MeshProjectionTarget : public IOrientedProjectionTarget {
 public:
@@ -60,28 +67,33 @@ public:
 		Spatial = std::make_shared<DMeshAABBTree3>(mesh, true);
 	}
 
-	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) override {
-		double fDistSqr;
-		int tNearestID = Spatial->FindNearestTriangle(vPoint, fDistSqr);
+	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) const override {
+		int tNearestID = find_nearest_triangle(vPoint, identifier);
 		if (tNearestID == DMesh3::InvalidID) {
 			return vPoint;
 		}
 		Vector3d v0, v1, v2;
 		Mesh->GetTriVertices(tNearestID, v0, v1, v2);
+		// the closest points are only computed by Get()/GetSquared()
 		Wml::DistPoint3Triangle3d dist(vPoint, Triangle3d(v0, v1, v2));
+		dist.GetSquared();
 		Vector3d vProj = dist.GetClosestPoint1();
 		return vProj;
 	}
 
-	virtual Vector3d Project(const Vector3d &vPoint, Vector3d &vProjectNormal, int identifier = -1) {
-		double fDistSqr;
-		int tNearestID = Spatial->FindNearestTriangle(vPoint, fDistSqr);
+	virtual Vector3d Project(const Vector3d &vPoint, Vector3d &vProjectNormal, int identifier = -1) const override {
+		int tNearestID = find_nearest_triangle(vPoint, identifier);
+		if (tNearestID == DMesh3::InvalidID) {
+			vProjectNormal = Vector3d::Zero();
+			return vPoint;
+		}
 		Vector3d v0, v1, v2;
 		Mesh->GetTriVertices(tNearestID, v0, v1, v2);
 
 		vProjectNormal = Normal(v0, v1, v2);
 
 		Wml::DistPoint3Triangle3d dist(vPoint, Triangle3d(v0, v1, v2));
+		dist.GetSquared();
 		return dist.GetClosestPoint1();
 	}
 
@@ -119,6 +131,230 @@ public:
 	//	DSubmesh3 submesh = new DSubmesh3(mesh, targetRegion);
 	//	return new MeshProjectionTarget(submesh.SubMesh);
 	// }
+
+protected:
+	// nearest triangle of Mesh to p, or InvalidID
+	virtual int find_nearest_triangle(const Vector3d &p, int identifier) const {
+		double fDistSqr;
+		return Spatial->FindNearestTriangle(p, fDistSqr);
+	}
+};
+
+/// <summary>
+/// MeshProjectionTarget that remembers the nearest triangle found for each identifier (eg the
+/// ID of the remeshed vertex). The next query with that identifier first measures the distances
+/// to the one-ring triangles of the vertex of that triangle nearest to the point. Points that
+/// only moved a little, as between remeshing passes, are usually still nearest to one of these
+/// triangles, and the tree search is skipped if the clearance of the vertex (the distance from
+/// it to all triangles outside its one-ring, computed once per vertex) proves it. Otherwise the
+/// search of Spatial is bounded by the best distance found so far.
+/// The projected points are the same as MeshProjectionTarget (up to ties).
+///
+/// The cache is indexed by identifier, so identifiers should be small (eg vertex IDs). It is
+/// sized for identifiers up to the vertex count of Mesh, and grows (under a lock) for larger
+/// ones, see ReserveCache(). Negative identifiers are not cached. Project() is safe to call
+/// concurrently, and lookups take no lock, as long as Mesh is not modified. Spatial must not filter triangles, and the clearances are only
+/// computed if it is a DMeshAABBTree3.
+/// </summary>
+class WarmStartMeshProjectionTarget : public MeshProjectionTarget {
+public:
+	WarmStartMeshProjectionTarget(DMesh3Ptr mesh, IMeshSpatialPtr spatial) :
+			MeshProjectionTarget(mesh, spatial) {
+		initialize();
+	}
+	WarmStartMeshProjectionTarget(DMesh3Ptr mesh) :
+			MeshProjectionTarget(mesh) {
+		initialize();
+	}
+
+	/// <summary>
+	/// Forget the cached triangles, eg if the identifiers now refer to other points.
+	/// Must not be called while points are being projected.
+	/// </summary>
+	void ClearCache() {
+		std::lock_guard<std::mutex> l(cache_lock);
+		cache_array *current = cache.load(std::memory_order_relaxed);
+		for (size_t k = 0; k < current->size; ++k)
+			current->nearest[k].store(DMesh3::InvalidID, std::memory_order_relaxed);
+		// arrays that were replaced by growing the cache are no longer read
+		for (auto &array : cache_arrays) {
+			if (array.get() != current)
+				array.reset();
+		}
+		cache_arrays.erase(std::remove(cache_arrays.begin(), cache_arrays.end(), nullptr), cache_arrays.end());
+	}
+
+	/// <summary>
+	/// Grow the cache to hold identifiers below nMaxIdentifier, so queries do not grow it
+	/// </summary>
+	void ReserveCache(int nMaxIdentifier) {
+		std::lock_guard<std::mutex> l(cache_lock);
+		grow_cache((size_t)std::max(nMaxIdentifier, 0));
+	}
+
+	static MeshProjectionTargetPtr AutoPtr(DMesh3Ptr mesh, bool bForceCopy = true) {
+		if (bForceCopy)
+			return std::make_shared<WarmStartMeshProjectionTarget>(std::make_shared<DMesh3>(*mesh, false, MeshComponents::None));
+		else
+			return std::make_shared<WarmStartMeshProjectionTarget>(mesh);
+	}
+	static MeshProjectionTargetPtr AutoPtr(const DMesh3 &mesh) {
+		return std::make_shared<WarmStartMeshProjectionTarget>(std::make_shared<DMesh3>(mesh, false, MeshComponents::None));
+	}
+
+protected:
+	std::shared_ptr<DMeshAABBTree3> tree;
+
+	// nearest triangle per identifier, InvalidID if unknown. Entries are atomic because the
+	// same identifier may be projected concurrently
+	struct cache_array {
+		size_t size;
+		std::unique_ptr<std::atomic<int>[]> nearest;
+	};
+	// The current array is published atomically, so lookups take no lock. Growing copies it
+	// under cache_lock, and the replaced arrays are kept (until ClearCache()) as concurrent
+	// queries may still use them. A write that races with a grow may be lost, which only
+	// costs a search.
+	mutable std::atomic<cache_array *> cache{ nullptr };
+	mutable std::vector<std::unique_ptr<cache_array>> cache_arrays;
+	mutable std::mutex cache_lock;
+
+	// clearance per vertex, see get_clearance(). Negative until computed (by the first query
+	// that needs it, racing queries compute the same value)
+	std::unique_ptr<std::atomic<double>[]> clearance;
+
+	void initialize() {
+		tree = std::dynamic_pointer_cast<DMeshAABBTree3>(Spatial);
+		int NV = Mesh->MaxVertexID();
+		clearance.reset(new std::atomic<double>[NV]);
+		for (int vid = 0; vid < NV; ++vid)
+			clearance[vid].store(-1.0, std::memory_order_relaxed);
+		grow_cache((size_t)std::max(NV, 1));
+	}
+
+	virtual int find_nearest_triangle(const Vector3d &p, int identifier) const override {
+		if (identifier < 0)
+			return MeshProjectionTarget::find_nearest_triangle(p, identifier);
+
+		int tNearestID = DMesh3::InvalidID;
+		double fNearestSqr = std::numeric_limits<double>::max();
+		int tCachedID = get_cached(identifier);
+		if (tCachedID != DMesh3::InvalidID && Mesh->IsTriangle(tCachedID)) {
+			double fVertexSqr;
+			int vID = nearest_vertex(tCachedID, p, fVertexSqr);
+			nearest_in_one_ring(vID, p, fNearestSqr, tNearestID);
+			// all other triangles are at least (clearance - distance to the vertex) away from p
+			if (sqrt(fNearestSqr) + sqrt(fVertexSqr) <= get_clearance(vID)) {
+				if (tNearestID != tCachedID)
+					set_cached(identifier, tNearestID);
+				return tNearestID;
+			}
+		}
+
+		// only triangles closer than the one-ring are returned
+		double fDistSqr;
+		int tSearchID = (tNearestID == DMesh3::InvalidID) ?
+				Spatial->FindNearestTriangle(p, fDistSqr) :
+				Spatial->FindNearestTriangle(p, fDistSqr, sqrt(fNearestSqr));
+		if (tSearchID != DMesh3::InvalidID)
+			tNearestID = tSearchID;
+
+		if (tNearestID != tCachedID)
+			set_cached(identifier, tNearestID);
+		return tNearestID;
+	}
+
+	// vertex of triangle tid nearest to p
+	int nearest_vertex(int tid, const Vector3d &p, double &fNearestSqr) const {
+		Index3i tri = Mesh->GetTriangle(tid);
+		int vNearest = tri[0];
+		fNearestSqr = (Mesh->GetVertex(tri[0]) - p).squaredNorm();
+		for (int j = 1; j < 3; ++j) {
+			double fDistSqr = (Mesh->GetVertex(tri[j]) - p).squaredNorm();
+			if (fDistSqr < fNearestSqr) {
+				fNearestSqr = fDistSqr;
+				vNearest = tri[j];
+			}
+		}
+		return vNearest;
+	}
+
+	void nearest_in_one_ring(int vid, const Vector3d &p, double &fNearestSqr, int &tNearestID) const {
+		// each triangle is visited from the edge to the vertex that follows vid in it
+		for (int eid : Mesh->VtxEdgesItr(vid)) {
+			Index4i ev = Mesh->GetEdge(eid);
+			int vOther = (ev[0] == vid) ? ev[1] : ev[0];
+			for (int k = 2; k < 4; ++k) {
+				if (ev[k] == DMesh3::InvalidID || is_next_vertex(ev[k], vid, vOther) == false)
+					continue;
+				double fDistSqr = MeshQueries::TriDistanceSqr(*Mesh, ev[k], p);
+				if (fDistSqr < fNearestSqr) {
+					fNearestSqr = fDistSqr;
+					tNearestID = ev[k];
+				}
+			}
+		}
+	}
+
+	// true if b follows a in triangle tid
+	bool is_next_vertex(int tid, int a, int b) const {
+		Index3i tri = Mesh->GetTriangle(tid);
+		return (tri[0] == a && tri[1] == b) || (tri[1] == a && tri[2] == b) || (tri[2] == a && tri[0] == b);
+	}
+
+	// Distance from vertex vid to the nearest triangle outside its one-ring. Only distances up
+	// to its longest edge are searched, as larger clearances are rarely needed to skip the search.
+	double get_clearance(int vid) const {
+		double fClearance = clearance[vid].load(std::memory_order_relaxed);
+		if (fClearance >= 0)
+			return fClearance;
+		if (tree == nullptr)
+			return 0;
+
+		Vector3d v = Mesh->GetVertex(vid);
+		double fMaxLenSqr = 0;
+		for (int nbr_vid : Mesh->VtxVerticesItr(vid))
+			fMaxLenSqr = std::max(fMaxLenSqr, (Mesh->GetVertex(nbr_vid) - v).squaredNorm());
+
+		// the search returns the squared max distance if no triangle is nearer
+		double fNearestSqr;
+		tree->FindNearestTriangle(v, fNearestSqr, sqrt(fMaxLenSqr), [&](int tid) {
+			Index3i tri = Mesh->GetTriangle(tid);
+			return tri[0] != vid && tri[1] != vid && tri[2] != vid;
+		});
+		fClearance = sqrt(fNearestSqr);
+		clearance[vid].store(fClearance, std::memory_order_relaxed);
+		return fClearance;
+	}
+
+	int get_cached(int identifier) const {
+		const cache_array *current = cache.load(std::memory_order_acquire);
+		return ((size_t)identifier < current->size) ? current->nearest[identifier].load(std::memory_order_relaxed) : DMesh3::InvalidID;
+	}
+
+	void set_cached(int identifier, int tid) const {
+		cache_array *current = cache.load(std::memory_order_acquire);
+		if ((size_t)identifier >= current->size) {
+			std::lock_guard<std::mutex> l(cache_lock);
+			current = grow_cache(std::max((size_t)identifier + 1, 2 * current->size));
+		}
+		current->nearest[identifier].store(tid, std::memory_order_relaxed);
+	}
+
+	// replace the cache with a copy that holds at least nSize entries. Call with cache_lock held
+	cache_array *grow_cache(size_t nSize) const {
+		cache_array *current = cache.load(std::memory_order_relaxed);
+		size_t nOldSize = (current != nullptr) ? current->size : 0;
+		if (nSize <= nOldSize)
+			return current;
+		std::unique_ptr<cache_array> grown(new cache_array{ nSize, std::unique_ptr<std::atomic<int>[]>(new std::atomic<int>[nSize]) });
+		for (size_t k = 0; k < nSize; ++k)
+			grown->nearest[k].store((k < nOldSize) ? current->nearest[k].load(std::memory_order_relaxed) : DMesh3::InvalidID, std::memory_order_relaxed);
+		current = grown.get();
+		cache_arrays.push_back(std::move(grown));
+		cache.store(current, std::memory_order_release);
+		return current;
+	}
 };
 
 //
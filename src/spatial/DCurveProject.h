@@ -40,6 +40,7 @@
 #include <string>
 
 namespace g3 {
+// projects onto the nearest segment of Curve. Safe to call concurrently, as long as Curve is not modified
 class DCurveProjectionTarget : public IProjectionTarget {
 public:
 	DCurve3Ptr Curve;
@@ -48,7 +49,7 @@ public:
 		Curve = curve;
 	}
 
-	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) override {
+	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) const override {
 		Vector3d vNearest;
 		double fNearestSqr = std::numeric_limits<double>::max();
 
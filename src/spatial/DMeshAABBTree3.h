@@ -34,6 +34,7 @@
 #include <DMesh3.h>
 #include <MeshQueries.h>
 #include <SpatialInterfaces.h>
+#include <profile_util.h>
 
 namespace g3 {
 
@@ -58,6 +59,7 @@ public:
 	}
 
 	void Build() {
+		G3_PROFILE_SCOPE("AABBTree.Build");
 		build_top_down(false);
 		mesh_timestamp = mesh->ShapeTimestamp();
 	}
@@ -67,6 +69,8 @@ public:
 	/// <summary>
 	/// Find the triangle closest to p, and distance to it, within distance fMaxDist, or return InvalidID
 	/// Use MeshQueries.TriangleDistance() to get more information
+	/// Queries do not modify the tree, so they can run concurrently while the mesh is not modified.
+	/// Throws if the mesh shape has changed since Build().
 	/// </summary>
 	virtual int FindNearestTriangle(const Vector3d &p, double &fNearestDistSqr, double fMaxDist = DOUBLE_MAX) override {
 		if (mesh_timestamp != mesh->ShapeTimestamp())
@@ -77,7 +81,28 @@ public:
 		find_nearest_tri(root_index, p, fNearestDistSqr, tNearID);
 		return tNearID;
 	}
+
+	/// <summary>
+	/// FindNearestTriangle() that only considers the triangles for which filterF(tID) is true
+	/// (as well as TriangleFilterF). Unlike TriangleFilterF, the filter can differ between
+	/// concurrent queries.
+	/// </summary>
+	template <class FilterFunc>
+	int FindNearestTriangle(const Vector3d &p, double &fNearestDistSqr, double fMaxDist, const FilterFunc &filterF) {
+		if (mesh_timestamp != mesh->ShapeTimestamp())
+			throw std::runtime_error("DMeshAABBTree3.FindNearestTriangle: mesh has been modified since tree construction");
+
+		fNearestDistSqr = (fMaxDist < DOUBLE_MAX) ? fMaxDist * fMaxDist : DOUBLE_MAX;
+		int tNearID = InvalidID;
+		find_nearest_tri(root_index, p, fNearestDistSqr, tNearID, filterF);
+		return tNearID;
+	}
+
 	void find_nearest_tri(int iBox, const Vector3d &p, double &fNearestSqr, int &tID) {
+		find_nearest_tri(iBox, p, fNearestSqr, tID, [](int) { return true; });
+	}
+	template <class FilterFunc>
+	void find_nearest_tri(int iBox, const Vector3d &p, double &fNearestSqr, int &tID, const FilterFunc &filterF) {
 		int idx = box_to_index[iBox];
 		if (idx < triangles_end) { // triange-list case, array is [N t1 t2 ... tN]
 			int num_tris = index_list[idx];
@@ -85,6 +110,8 @@ public:
 				int ti = index_list[idx + i];
 				if (TriangleFilterF != nullptr && TriangleFilterF(ti) == false)
 					continue;
+				if (filterF(ti) == false)
+					continue;
 				double fTriDistSqr = MeshQueries::TriDistanceSqr(*mesh, ti, p);
 				if (fTriDistSqr < fNearestSqr) {
 					fNearestSqr = fTriDistSqr;
@@ -98,7 +125,7 @@ public:
 				iChild1 = (-iChild1) - 1;
 				double fChild1DistSqr = box_distance_sqr(iChild1, p);
 				if (fChild1DistSqr <= fNearestSqr)
-					find_nearest_tri(iChild1, p, fNearestSqr, tID);
+					find_nearest_tri(iChild1, p, fNearestSqr, tID, filterF);
 
 			} else { // 2 children, descend closest first
 				iChild1 = iChild1 - 1;
@@ -108,15 +135,15 @@ public:
 				double fChild2DistSqr = box_distance_sqr(iChild2, p);
 				if (fChild1DistSqr < fChild2DistSqr) {
 					if (fChild1DistSqr < fNearestSqr) {
-						find_nearest_tri(iChild1, p, fNearestSqr, tID);
+						find_nearest_tri(iChild1, p, fNearestSqr, tID, filterF);
 						if (fChild2DistSqr < fNearestSqr)
-							find_nearest_tri(iChild2, p, fNearestSqr, tID);
+							find_nearest_tri(iChild2, p, fNearestSqr, tID, filterF);
 					}
 				} else {
 					if (fChild2DistSqr < fNearestSqr) {
-						find_nearest_tri(iChild2, p, fNearestSqr, tID);
+						find_nearest_tri(iChild2, p, fNearestSqr, tID, filterF);
 						if (fChild1DistSqr < fNearestSqr)
-							find_nearest_tri(iChild1, p, fNearestSqr, tID);
+							find_nearest_tri(iChild1, p, fNearestSqr, tID, filterF);
 					}
 				}
 			}
@@ -0,0 +1,273 @@
+/**************************************************************************/
+/*  SizingFields.h                                                        */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef SIZINGFIELDS_H
+#define SIZINGFIELDS_H
+
+#include <DMeshAABBTree3.h>
+#include <SpatialInterfaces.h>
+#include <g3types.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <vector>
+
+namespace g3 {
+
+/// <summary>
+/// FunctionSizingField provides an ISizingField interface to a client function.
+/// SizeF is called concurrently by the Remesher.
+/// </summary>
+class FunctionSizingField : public ISizingField {
+public:
+	std::function<double(const Vector3d &)> SizeF;
+
+	FunctionSizingField(const std::function<double(const Vector3d &)> &sizeF) :
+			SizeF(sizeF) {}
+
+	virtual double TargetEdgeLength(const Vector3d &vPoint, int identifier = -1) const override {
+		return SizeF(vPoint);
+	}
+};
+
+/// <summary>
+/// GridSizingField stores target edge lengths at the nodes of a regular grid, and interpolates
+/// them trilinearly. Node (i,j,k) is at Origin + CellSize*(i,j,k), points outside the grid
+/// use the nearest point on the grid boundary.
+/// </summary>
+class GridSizingField : public ISizingField {
+public:
+	Vector3d Origin;
+	double CellSize;
+	Vector3i Dims;
+	// node (i,j,k) is Values[i + Dims[0]*(j + Dims[1]*k)]
+	std::vector<double> Values;
+
+	GridSizingField(const Vector3d &origin, double cellSize, const Vector3i &dims, double fInitialLength) :
+			Origin(origin), CellSize(cellSize), Dims(dims), Values((size_t)dims[0] * dims[1] * dims[2], fInitialLength) {}
+
+	double &Value(int i, int j, int k) {
+		return Values[i + (size_t)Dims[0] * (j + (size_t)Dims[1] * k)];
+	}
+	double Value(int i, int j, int k) const {
+		return Values[i + (size_t)Dims[0] * (j + (size_t)Dims[1] * k)];
+	}
+
+	// position of node (i,j,k)
+	Vector3d NodePosition(int i, int j, int k) const {
+		return Origin + CellSize * Vector3d(i, j, k);
+	}
+
+	virtual double TargetEdgeLength(const Vector3d &vPoint, int identifier = -1) const override {
+		int i0[3], i1[3];
+		double t[3];
+		for (int d = 0; d < 3; ++d) {
+			double x = (vPoint[d] - Origin[d]) / CellSize;
+			x = std::max(0.0, std::min(x, (double)(Dims[d] - 1)));
+			i0[d] = std::min((int)x, std::max(Dims[d] - 2, 0));
+			i1[d] = std::min(i0[d] + 1, Dims[d] - 1);
+			t[d] = x - i0[d];
+		}
+		double v00 = (1 - t[0]) * Value(i0[0], i0[1], i0[2]) + t[0] * Value(i1[0], i0[1], i0[2]);
+		double v10 = (1 - t[0]) * Value(i0[0], i1[1], i0[2]) + t[0] * Value(i1[0], i1[1], i0[2]);
+		double v01 = (1 - t[0]) * Value(i0[0], i0[1], i1[2]) + t[0] * Value(i1[0], i0[1], i1[2]);
+		double v11 = (1 - t[0]) * Value(i0[0], i1[1], i1[2]) + t[0] * Value(i1[0], i1[1], i1[2]);
+		double v0 = (1 - t[1]) * v00 + t[1] * v10;
+		double v1 = (1 - t[1]) * v01 + t[1] * v11;
+		return (1 - t[2]) * v0 + t[2] * v1;
+	}
+};
+
+/// <summary>
+/// MeshSizingField stores a target edge length at each vertex of a reference mesh, and
+/// interpolates it over the reference triangle nearest to the query point. FromCurvature()
+/// and FromFeatureDistance() compute the lengths for common cases.
+/// TargetEdgeLength() is safe to call concurrently, as long as Mesh is not modified.
+/// In particular Mesh must not be the mesh that is being remeshed.
+/// </summary>
+class MeshSizingField : public ISizingField {
+public:
+	DMesh3Ptr Mesh;
+	IMeshSpatialPtr Spatial;
+	// target edge length at each vertex of Mesh
+	std::vector<double> VertexLengths;
+	// returned if there is no nearest triangle
+	double DefaultLength;
+
+	MeshSizingField(DMesh3Ptr mesh, double fInitialLength, IMeshSpatialPtr spatial = nullptr) {
+		Mesh = mesh;
+		Spatial = spatial;
+		if (Spatial == nullptr)
+			Spatial = std::make_shared<DMeshAABBTree3>(mesh, true);
+		VertexLengths.resize(mesh->MaxVertexID(), fInitialLength);
+		DefaultLength = fInitialLength;
+	}
+
+	virtual double TargetEdgeLength(const Vector3d &vPoint, int identifier = -1) const override {
+		double fDistSqr;
+		int tNearestID = Spatial->FindNearestTriangle(vPoint, fDistSqr);
+		if (tNearestID == DMesh3::InvalidID)
+			return DefaultLength;
+		Index3i tri = Mesh->GetTriangle(tNearestID);
+		Vector3d v0, v1, v2;
+		Mesh->GetTriVertices(tNearestID, v0, v1, v2);
+		// the barycentric coords are only computed by Get()/GetSquared()
+		Wml::DistPoint3Triangle3d dist(vPoint, Triangle3d(v0, v1, v2));
+		dist.GetSquared();
+		return dist.GetTriangleBary(0) * VertexLengths[tri[0]] +
+				dist.GetTriangleBary(1) * VertexLengths[tri[1]] +
+				dist.GetTriangleBary(2) * VertexLengths[tri[2]];
+	}
+
+	/// <summary>
+	/// Limit how fast the lengths grow over the surface: afterwards the length at each vertex is
+	/// at most the length at any other vertex plus fGradation times the (edge-path) distance
+	/// between them. Without this, small edges next to large ones make badly shaped triangles.
+	/// </summary>
+	void LimitGradation(double fGradation) {
+		typedef std::pair<double, int> entry;
+		std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue;
+		for (int vid : Mesh->VertexIndices())
+			queue.push(entry(VertexLengths[vid], vid));
+		while (queue.empty() == false) {
+			entry e = queue.top();
+			queue.pop();
+			if (e.first > VertexLengths[e.second])
+				continue; // already reached with a smaller length
+			Vector3d v = Mesh->GetVertex(e.second);
+			for (int nbr_vid : Mesh->VtxVerticesItr(e.second)) {
+				double fLength = e.first + fGradation * (Mesh->GetVertex(nbr_vid) - v).norm();
+				if (fLength < VertexLengths[nbr_vid]) {
+					VertexLengths[nbr_vid] = fLength;
+					queue.push(entry(fLength, nbr_vid));
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Curvature-adaptive lengths. At a vertex with maximum absolute curvature k, the length is
+	/// sqrt(6*e/k - 3*e^2) for approximation error e = fMaxError (Dunyach et al. 2013,
+	/// "Adaptive Remeshing for Real-Time Mesh Deformation"), clamped to [fMinLength,fMaxLength].
+	/// Then LimitGradation(fGradation) is applied, if fGradation > 0.
+	/// </summary>
+	static std::shared_ptr<MeshSizingField> FromCurvature(DMesh3Ptr mesh, double fMaxError,
+			double fMinLength, double fMaxLength, double fGradation = 0.5) {
+		auto field = std::make_shared<MeshSizingField>(mesh, fMaxLength);
+		std::vector<double> curvatures;
+		MaxCurvatures(*mesh, curvatures);
+		for (int vid : mesh->VertexIndices()) {
+			double k = curvatures[vid];
+			double fLengthSqr = (k > 0) ? (6 * fMaxError / k - 3 * fMaxError * fMaxError) : fMaxLength * fMaxLength;
+			double fLength = (fLengthSqr > 0) ? std::sqrt(fLengthSqr) : fMinLength;
+			field->VertexLengths[vid] = std::max(fMinLength, std::min(fLength, fMaxLength));
+		}
+		if (fGradation > 0)
+			field->LimitGradation(fGradation);
+		return field;
+	}
+
+	/// <summary>
+	/// Feature-adaptive lengths: fMinLength at the feature vertices, growing by fGradation
+	/// times the (edge-path) distance to the nearest feature vertex, up to fMaxLength.
+	/// See SharpEdgeVertices() to find feature vertices.
+	/// </summary>
+	static std::shared_ptr<MeshSizingField> FromFeatureDistance(DMesh3Ptr mesh, const std::vector<int> &featureVertices,
+			double fMinLength, double fMaxLength, double fGradation) {
+		auto field = std::make_shared<MeshSizingField>(mesh, fMaxLength);
+		for (int vid : featureVertices) {
+			if (mesh->IsVertex(vid))
+				field->VertexLengths[vid] = fMinLength;
+		}
+		field->LimitGradation(fGradation);
+		return field;
+	}
+
+	/// <summary>
+	/// Maximum absolute principal curvature at each vertex of mesh, |H| + sqrt(H^2 - K), from the
+	/// cotangent-weighted mean curvature H and the angle-deficit Gaussian curvature K (which is
+	/// taken as 0 at boundary vertices). curvatures is indexed by vertex ID.
+	/// </summary>
+	static void MaxCurvatures(const DMesh3 &mesh, std::vector<double> &curvatures) {
+		int NV = mesh.MaxVertexID();
+		std::vector<double> areas(NV, 0), angles(NV, 0);
+		std::vector<Vector3d> laplacians(NV, Vector3d::Zero());
+		Vector3d p[3];
+		for (int tid : mesh.TriangleIndices()) {
+			Index3i tri = mesh.GetTriangle(tid);
+			mesh.GetTriVertices(tid, p[0], p[1], p[2]);
+			double fArea = 0.5 * (p[1] - p[0]).cross(p[2] - p[0]).norm();
+			for (int j = 0; j < 3; ++j) {
+				int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+				Vector3d e1 = p[j1] - p[j], e2 = p[j2] - p[j];
+				double fCross = e1.cross(e2).norm(), fDot = e1.dot(e2);
+				angles[tri[j]] += std::atan2(fCross, fDot);
+				areas[tri[j]] += fArea / 3;
+				// cotangent of the angle at corner j weights the opposite edge
+				double fCot = (fCross > Wml::Mathd::ZERO_TOLERANCE) ? fDot / fCross : 0;
+				laplacians[tri[j1]] += fCot * (p[j2] - p[j1]);
+				laplacians[tri[j2]] += fCot * (p[j1] - p[j2]);
+			}
+		}
+		curvatures.assign(NV, 0);
+		for (int vid : mesh.VertexIndices()) {
+			if (areas[vid] <= 0)
+				continue;
+			double H = laplacians[vid].norm() / (4 * areas[vid]);
+			double K = mesh.IsBoundaryVertex(vid) ? 0 : (2 * Wml::Mathd::PI - angles[vid]) / areas[vid];
+			curvatures[vid] = H + std::sqrt(std::max(0.0, H * H - K));
+		}
+	}
+
+	/// <summary>
+	/// Vertices of boundary edges, and of edges where the normals of the two triangles differ
+	/// by more than fAngleDeg.
+	/// </summary>
+	static std::vector<int> SharpEdgeVertices(const DMesh3 &mesh, double fAngleDeg) {
+		double fCosAngle = std::cos(fAngleDeg * Wml::Mathd::DEG_TO_RAD);
+		std::vector<int> vertices;
+		for (int eid : mesh.EdgeIndices()) {
+			Index2i et = mesh.GetEdgeT(eid);
+			if (et[1] == DMesh3::InvalidID ||
+					mesh.GetTriNormal(et[0]).dot(mesh.GetTriNormal(et[1])) < fCosAngle) {
+				Index2i ev = mesh.GetEdgeV(eid);
+				vertices.push_back(ev[0]);
+				vertices.push_back(ev[1]);
+			}
+		}
+		std::sort(vertices.begin(), vertices.end());
+		vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+		return vertices;
+	}
+};
+
+} // namespace g3
+#endif // SIZINGFIELDS_H
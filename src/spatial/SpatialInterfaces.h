@@ -64,19 +64,41 @@ public:
 	virtual int FindNearestHitTriangle(const Ray3d &ray, double fMaxDist = std::numeric_limits<double>::max()) = 0;
 };
 
+//
+// IProjectionTarget maps a point onto a target surface/curve. identifier is the ID
+// of the vertex being projected (or -1), implementations may use it as a hint.
+//
+// Project() may be called concurrently from multiple threads (eg by Remesher's parallel
+// smoothing and projection passes), so implementations must not modify shared state.
+// It is const to enforce that for members, objects reached through pointers (eg a
+// spatial data structure) must also be safe to query concurrently.
+//
 class IProjectionTarget {
 public:
 	virtual ~IProjectionTarget() {}
 
-	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) = 0;
+	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) const = 0;
 };
 
 class IOrientedProjectionTarget : public IProjectionTarget {
 public:
 	virtual ~IOrientedProjectionTarget() {}
 
-	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) override = 0;
-	virtual Vector3d Project(const Vector3d &vPoint, Vector3d &vProjectNormal, int identifier = -1) = 0;
+	virtual Vector3d Project(const Vector3d &vPoint, int identifier = -1) const override = 0;
+	virtual Vector3d Project(const Vector3d &vPoint, Vector3d &vProjectNormal, int identifier = -1) const = 0;
+};
+
+//
+// ISizingField returns the target edge length at a point, for adaptive remeshing
+// (see Remesher::SizingField). identifier is the ID of the vertex (or -1), implementations
+// may use it as a hint. Like IProjectionTarget::Project(), TargetEdgeLength() may be called
+// concurrently and must not modify shared state.
+//
+class ISizingField {
+public:
+	virtual ~ISizingField() {}
+
+	virtual double TargetEdgeLength(const Vector3d &vPoint, int identifier = -1) const = 0;
 };
 
 class IIntersectionTarget {
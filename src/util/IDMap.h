@@ -31,8 +31,11 @@
 #ifndef IDMAP_H
 #define IDMAP_H
 
+#include <algorithm>
+
 #include <g3Debug.h>
 #include <g3types.h>
+#include <int_hash_map.h>
 
 namespace g3 {
 
@@ -60,6 +63,25 @@ public:
 		Resize(nOldSize, nNewSize);
 	}
 
+	// a Dense map costs sizeof(T) per possible ID, a Sparse (hash) map about
+	// 3*sizeof(T) per mapped ID, and Dense lookups are cheaper. So use Dense once
+	// at least 1/DenseDensity of the ID range is expected to be mapped.
+	static constexpr int DenseDensity = 8;
+
+	/// <summary>
+	/// Create a map for old IDs in [0,nOldSize) and new IDs in [0,nNewSize), when about
+	/// nExpectedCount IDs will be mapped. Picks Dense or Sparse storage based on density.
+	/// </summary>
+	static IDMap ForRange(unsigned int nOldSize, unsigned int nNewSize, size_t nExpectedCount) {
+		size_t nRange = std::max(nOldSize, nNewSize);
+		if (nExpectedCount * DenseDensity >= nRange)
+			return IDMap(nOldSize, nNewSize);
+		IDMap map(Sparse);
+		map.vToNewMap.reserve(nExpectedCount);
+		map.vToOldMap.reserve(nExpectedCount);
+		return map;
+	}
+
 	IDMapType Type() const {
 		return m_eType;
 	}
@@ -93,7 +115,7 @@ public:
 			gDevAssert(false);
 			return 0;
 		} else
-			return vToNewMap.size();
+			return vToNew.size();
 	}
 
 	inline size_t NewSize() const {
@@ -101,7 +123,7 @@ public:
 			gDevAssert(false);
 			return 0;
 		} else
-			return vToOldMap.size();
+			return vToOld.size();
 	}
 
 	void SetShift(int nShift) {
@@ -114,9 +136,9 @@ public:
 		if (m_eType == Shift) {
 			gDevAssert(false);
 		} else if (m_eType == Sparse) {
-			vToNewMap[vOld] = vNew;
+			vToNewMap.set(vOld, vNew);
 			if (vNew != (T)InvalidID)
-				vToOldMap[vNew] = vOld;
+				vToOldMap.set(vNew, vOld);
 		} else {
 			vToNew[vOld] = vNew;
 			if (vNew != (T)InvalidID)
@@ -128,8 +150,7 @@ public:
 		if (m_eType == Shift) {
 			return vOld + m_nShift;
 		} else if (m_eType == Sparse) {
-			auto found = vToNewMap.find(vOld);
-			return found != vToNewMap.end() ? found->second : (T)InvalidID;
+			return vToNewMap.get(vOld, (T)InvalidID);
 		} else {
 			return vToNew[vOld];
 		}
@@ -138,8 +159,7 @@ public:
 		if (m_eType == Shift) {
 			return vNew - m_nShift;
 		} else if (m_eType == Sparse) {
-			auto found = vToOldMap.find(vNew);
-			return found != vToOldMap.end() ? found->second : (T)InvalidID;
+			return vToOldMap.get(vNew, (T)InvalidID);
 		} else {
 			return vToOld[vNew];
 		}
@@ -162,11 +182,9 @@ public:
 			for (unsigned int k = 0; k < nCount; ++k)
 				v[k] += nShift;
 		} else if (m_eType == Sparse) {
-			const std::map<T, T> &m = (eDirection == OldToNew) ? vToNewMap : vToOldMap;
-			for (unsigned int k = 0; k < nCount; ++k) {
-				auto found = m.find(v[k]);
-				v[k] = (found != m.end() ? found->second : (T)InvalidID);
-			}
+			const int_hash_map<T, T> &m = (eDirection == OldToNew) ? vToNewMap : vToOldMap;
+			for (unsigned int k = 0; k < nCount; ++k)
+				v[k] = m.get(v[k], (T)InvalidID);
 		} else {
 			const std::vector<T> &m = (eDirection == OldToNew) ? vToNew : vToOld;
 			for (unsigned int k = 0; k < nCount; ++k)
@@ -180,8 +198,8 @@ private:
 	IDMapType m_eType;
 	std::vector<T> vToNew;
 	std::vector<T> vToOld;
-	std::map<T, T> vToNewMap;
-	std::map<T, T> vToOldMap;
+	int_hash_map<T, T> vToNewMap;
+	int_hash_map<T, T> vToOldMap;
 	int m_nShift = 0;
 };
 
@@ -32,106 +32,156 @@
 #define ATOMIC_UTIL_H
 
 #include <atomic>
+#include <type_traits>
+#include <vector>
+
+namespace g3 {
+
+// size used to pad per-thread data onto separate cache lines, so that
+// threads writing to neighbouring slots do not invalidate each other's caches
+constexpr int cache_line_size = 64;
 
 //
-// Use spinlock to allow mutex-free threadsafe accumulation of value(s)
-// To use with non-POD type, you just have to implement += operator
+// lock-free test-and-update of an atomic value. Returns true if v was stored.
+// The common case (v does not improve the value) is a plain load, so many threads
+// can race on the same value without bouncing its cache line between cores.
 //
-namespace g3 {
+template <class Type>
+inline bool atomic_update_if_less(std::atomic<Type> &target, Type v) {
+	Type cur = target.load(std::memory_order_relaxed);
+	while (v < cur) {
+		if (target.compare_exchange_weak(cur, v, std::memory_order_acq_rel, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+template <class Type>
+inline bool atomic_update_if_greater(std::atomic<Type> &target, Type v) {
+	Type cur = target.load(std::memory_order_relaxed);
+	while (v > cur) {
+		if (target.compare_exchange_weak(cur, v, std::memory_order_acq_rel, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
 
+//
+// lock-free threadsafe accumulation of a value, using a compare-and-swap loop
+// (std::atomic<double>::fetch_add only exists from C++20).
+// Type must be trivially copyable and implement += operator.
+//
+// Every accumulate() still writes the same cache line, so for reductions over
+// many elements prefer per_task_accumulator / parallel_accumulate(), which only
+// combine once per task.
+//
 template <class Type>
 class atomic_accumulator {
+	static_assert(std::is_trivially_copyable<Type>::value,
+			"atomic_accumulator requires a trivially-copyable type, use per_task_accumulator instead");
+
 private:
-	std::atomic<bool> lock;
-	Type value;
+	std::atomic<Type> value;
 
 public:
 	atomic_accumulator() = delete;
 	atomic_accumulator(const Type &init) :
-			lock(false) {
-		value = init;
+			value(init) {
 	}
 
 	inline void accumulate(Type v) {
-		while (std::atomic_exchange_explicit(&lock, true, std::memory_order_acquire))
-			; // spin until acquired
-		value += v;
-		std::atomic_store_explicit(&lock, false, std::memory_order_release);
+		Type cur = value.load(std::memory_order_relaxed);
+		Type next;
+		do {
+			next = cur;
+			next += v;
+		} while (!value.compare_exchange_weak(cur, next, std::memory_order_acq_rel, std::memory_order_relaxed));
 	}
 
 	inline void set(Type v) {
-		while (std::atomic_exchange_explicit(&lock, true, std::memory_order_acquire))
-			; // spin until acquired
-		value = v;
-		std::atomic_store_explicit(&lock, false, std::memory_order_release);
+		value.store(v, std::memory_order_release);
 	}
 
-	// assuming that we do not need calls to this function to be atomic...
+	// bAtomic is kept for compatibility, loads are always atomic now
 	inline Type operator()(bool bAtomic = false) {
-		Type tmp;
-		if (bAtomic) {
-			while (std::atomic_exchange_explicit(&lock, true, std::memory_order_acquire))
-				; // spin until acquired
-			tmp = value;
-			std::atomic_store_explicit(&lock, false, std::memory_order_release);
-			return tmp;
-		} else
-			return value;
+		return value.load(bAtomic ? std::memory_order_acquire : std::memory_order_relaxed);
 	}
 };
 
 //
 // This class allows you to test-and-update a single value and
-//   an associated data structure, using a mutex-free spinlock
+//   an associated data structure
 //
 // For example in a raycast loop you might want to find the nearest
 //   hit point, so the ValueType would be the ray-T and the OtherDataType
 //   would be the point data structure
 //
-// update_if_less() / update_if_greater() safely update the value
+// update_if_less() / update_if_greater() safely update the value. The value is
+// checked with a lock-free load first, so only updates that actually improve it
+// take the (short) spinlock that protects the <value,data> pair. In a nearest-hit
+// search almost all candidates are rejected, so threads rarely contend.
+//
 // operator() returns the current <value,data> as a pair-struct
 //
 template <class CheckValueType, class OtherDataType>
 class atomic_compare {
 private:
 	std::atomic<bool> lock;
-	CheckValueType value;
+	std::atomic<CheckValueType> value;
 	OtherDataType data;
 
+	inline void acquire() {
+		while (lock.exchange(true, std::memory_order_acquire)) {
+			while (lock.load(std::memory_order_relaxed))
+				; // spin on a read until released, to avoid hammering the line with writes
+		}
+	}
+	inline void release() {
+		lock.store(false, std::memory_order_release);
+	}
+
 public:
 	atomic_compare() = delete;
 	atomic_compare(CheckValueType init_v, OtherDataType init_d) :
-			lock(false) {
-		value = init_v;
+			lock(false), value(init_v) {
 		data = init_d;
 	}
 
-	inline void update_if_less(CheckValueType v, OtherDataType d) {
-		while (std::atomic_exchange_explicit(&lock, true, std::memory_order_acquire))
-			; // spin until acquired
-		if (v < value) {
-			value = v;
+	inline bool update_if_less(CheckValueType v, OtherDataType d) {
+		if (!(v < value.load(std::memory_order_relaxed)))
+			return false;
+		acquire();
+		bool bUpdated = v < value.load(std::memory_order_relaxed);
+		if (bUpdated) {
+			value.store(v, std::memory_order_relaxed);
 			data = d;
 		}
-		std::atomic_store_explicit(&lock, false, std::memory_order_release);
+		release();
+		return bUpdated;
 	}
 
-	inline void update_if_greater(CheckValueType v, OtherDataType d) {
-		while (std::atomic_exchange_explicit(&lock, true, std::memory_order_acquire))
-			; // spin until acquired
-		if (v > value) {
-			value = v;
+	inline bool update_if_greater(CheckValueType v, OtherDataType d) {
+		if (!(v > value.load(std::memory_order_relaxed)))
+			return false;
+		acquire();
+		bool bUpdated = v > value.load(std::memory_order_relaxed);
+		if (bUpdated) {
+			value.store(v, std::memory_order_relaxed);
 			data = d;
 		}
-		std::atomic_store_explicit(&lock, false, std::memory_order_release);
+		release();
+		return bUpdated;
 	}
 
 	inline void set(CheckValueType v, OtherDataType d) {
-		while (std::atomic_exchange_explicit(&lock, true, std::memory_order_acquire))
-			; // spin until acquired
-		value = v;
+		acquire();
+		value.store(v, std::memory_order_relaxed);
 		data = d;
-		std::atomic_store_explicit(&lock, false, std::memory_order_release);
+		release();
+	}
+
+	// current best value, without the payload. Lock-free, useful for early-out tests
+	inline CheckValueType current_value() const {
+		return value.load(std::memory_order_relaxed);
 	}
 
 	// assuming that we do not need calls to this function to be atomic...
@@ -141,13 +191,111 @@ public:
 	};
 	inline result operator()(bool bAtomic = false) {
 		if (bAtomic) {
-			while (std::atomic_exchange_explicit(&lock, true, std::memory_order_acquire))
-				; // spin until acquired
-			result r = { value, data };
-			std::atomic_store_explicit(&lock, false, std::memory_order_release);
+			acquire();
+			result r = { value.load(std::memory_order_relaxed), data };
+			release();
 			return r;
 		} else
-			return { value, data };
+			return { value.load(std::memory_order_relaxed), data };
+	}
+};
+
+//
+// per_task_accumulator holds one value per parallel task, each on its own cache
+// line, so tasks can accumulate without any synchronization. Use with
+// parallel_for_tasks() (or parallel_accumulate() in parallel_util.h), which pass the
+// task index, then combine() the slots once at the end.
+//
+template <class Type>
+class per_task_accumulator {
+private:
+	struct alignas(cache_line_size) slot {
+		Type value;
+	};
+	std::vector<slot> slots;
+
+public:
+	per_task_accumulator(int nTasks, const Type &init) :
+			slots(nTasks > 0 ? nTasks : 1, slot{ init }) {
+	}
+
+	int size() const { return (int)slots.size(); }
+
+	inline Type &local(int iTask) { return slots[iTask].value; }
+	inline const Type &local(int iTask) const { return slots[iTask].value; }
+
+	// combine all slots in task order with combineF(a,b)
+	template <typename CombineFunc>
+	Type combine(const CombineFunc &combineF) const {
+		Type result = slots[0].value;
+		for (size_t k = 1; k < slots.size(); ++k)
+			result = combineF(result, slots[k].value);
+		return result;
+	}
+};
+
+//
+// per-task <value,data> minimum/maximum, eg nearest-hit search. Each task only
+// ever touches its own slot; combine_min()/combine_max() pick the winner at the end.
+// Ties are resolved towards the lowest task index.
+//
+template <class CheckValueType, class OtherDataType>
+class per_task_compare {
+public:
+	struct result {
+		CheckValueType value;
+		OtherDataType data;
+	};
+
+private:
+	struct alignas(cache_line_size) slot {
+		result r;
+	};
+	std::vector<slot> slots;
+
+public:
+	per_task_compare(int nTasks, CheckValueType init_v, OtherDataType init_d) :
+			slots(nTasks > 0 ? nTasks : 1, slot{ { init_v, init_d } }) {
+	}
+
+	int size() const { return (int)slots.size(); }
+
+	inline bool update_if_less(int iTask, CheckValueType v, const OtherDataType &d) {
+		result &r = slots[iTask].r;
+		if (v < r.value) {
+			r.value = v;
+			r.data = d;
+			return true;
+		}
+		return false;
+	}
+	inline bool update_if_greater(int iTask, CheckValueType v, const OtherDataType &d) {
+		result &r = slots[iTask].r;
+		if (v > r.value) {
+			r.value = v;
+			r.data = d;
+			return true;
+		}
+		return false;
+	}
+
+	inline const result &local(int iTask) const { return slots[iTask].r; }
+
+	result combine_min() const {
+		result best = slots[0].r;
+		for (size_t k = 1; k < slots.size(); ++k) {
+			if (slots[k].r.value < best.value)
+				best = slots[k].r;
+		}
+		return best;
+	}
+	result combine_max() const {
+		result best = slots[0].r;
+		for (size_t k = 1; k < slots.size(); ++k) {
+			if (slots[k].r.value > best.value)
+				best = slots[k].r;
+		}
+		return best;
 	}
 };
 
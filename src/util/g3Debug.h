@@ -48,7 +48,8 @@ g3External void g3_debugPrint(std::string fmt, ...);
 g3External void g3_debugPrint(std::wstring fmt, ...);
 
 // #define gDevAssert g3_devAssert
-#define gDevAssert
+// the condition is still evaluated, cast to void so it does not warn (-Wunused-value)
+#define gDevAssert(...) ((void)(__VA_ARGS__))
 // #define gDebugPrint g3_debugPrint
 #define gDebugPrint
 
@@ -0,0 +1,231 @@
+/**************************************************************************/
+/*  int_hash_map.h                                                        */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef INT_HASH_MAP_H
+#define INT_HASH_MAP_H
+
+#include <g3Debug.h>
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace g3 {
+
+//
+// int_hash_map is an open-addressing hash map for integer keys (eg element IDs).
+// Keys and values are stored inline in one flat array with linear probing, so a
+// lookup is usually a single cache miss, unlike the node-per-entry std::map/std::unordered_map.
+// Erase uses backward-shift deletion, so there are no tombstones and lookups
+// do not degrade after many insert/erase cycles.
+//
+// The minimum value of KeyType is reserved as the empty-slot marker and cannot be
+// used as a key. References/pointers to values are invalidated by inserts that grow the map.
+//
+template <class KeyType = int, class ValueType = int>
+class int_hash_map {
+	static_assert(std::is_integral<KeyType>::value, "int_hash_map requires an integer key type");
+
+public:
+	static constexpr KeyType EmptyKey = std::numeric_limits<KeyType>::min();
+
+	int_hash_map() :
+			nCount(0), nShift(64) {}
+	explicit int_hash_map(size_t nExpectedCount) :
+			int_hash_map() {
+		reserve(nExpectedCount);
+	}
+
+	size_t size() const { return nCount; }
+	bool empty() const { return nCount == 0; }
+	size_t capacity() const { return slots.size(); }
+
+	// remove all entries, but keep the memory
+	void clear() {
+		for (slot &s : slots)
+			s.key = EmptyKey;
+		nCount = 0;
+	}
+
+	// make room for nExpectedCount entries without rehashing
+	void reserve(size_t nExpectedCount) {
+		size_t nSlots = 16;
+		while (nSlots * MaxLoadNum < nExpectedCount * MaxLoadDen)
+			nSlots *= 2;
+		if (nSlots > slots.size())
+			rehash(nSlots);
+	}
+
+	inline const ValueType *find(KeyType key) const {
+		if (nCount == 0)
+			return nullptr;
+		size_t mask = slots.size() - 1;
+		for (size_t i = hash(key);; i = (i + 1) & mask) {
+			const slot &s = slots[i];
+			if (s.key == key)
+				return &s.value;
+			if (s.key == EmptyKey)
+				return nullptr;
+		}
+	}
+	inline ValueType *find(KeyType key) {
+		return const_cast<ValueType *>(static_cast<const int_hash_map *>(this)->find(key));
+	}
+
+	inline bool contains(KeyType key) const { return find(key) != nullptr; }
+
+	// value for key, or missing_value if key is not in the map
+	inline ValueType get(KeyType key, const ValueType &missing_value) const {
+		const ValueType *pValue = find(key);
+		return (pValue != nullptr) ? *pValue : missing_value;
+	}
+
+	// returns reference to value for key, inserting init_value if it was not present
+	inline ValueType &get_or_insert(KeyType key, const ValueType &init_value, bool *pInserted = nullptr) {
+		gDevAssert(key != EmptyKey);
+		if ((nCount + 1) * MaxLoadDen > slots.size() * MaxLoadNum)
+			rehash(slots.empty() ? 16 : 2 * slots.size());
+		size_t mask = slots.size() - 1;
+		for (size_t i = hash(key);; i = (i + 1) & mask) {
+			slot &s = slots[i];
+			if (s.key == key) {
+				if (pInserted != nullptr)
+					*pInserted = false;
+				return s.value;
+			}
+			if (s.key == EmptyKey) {
+				s.key = key;
+				s.value = init_value;
+				nCount++;
+				if (pInserted != nullptr)
+					*pInserted = true;
+				return s.value;
+			}
+		}
+	}
+
+	inline ValueType &operator[](KeyType key) {
+		return get_or_insert(key, ValueType());
+	}
+
+	inline void set(KeyType key, const ValueType &value) {
+		get_or_insert(key, value) = value;
+	}
+
+	// returns false if key was not in the map
+	bool erase(KeyType key) {
+		if (nCount == 0)
+			return false;
+		size_t mask = slots.size() - 1;
+		size_t i = hash(key);
+		while (slots[i].key != key) {
+			if (slots[i].key == EmptyKey)
+				return false;
+			i = (i + 1) & mask;
+		}
+		// backward-shift: move later entries of the probe run into the hole,
+		// unless that would move them before their home slot
+		size_t j = i;
+		while (true) {
+			j = (j + 1) & mask;
+			if (slots[j].key == EmptyKey)
+				break;
+			size_t home = hash(slots[j].key);
+			bool bCanMove = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+			if (bCanMove) {
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		slots[i].key = EmptyKey;
+		nCount--;
+		return true;
+	}
+
+	// call f(key, value) for each entry, in unspecified order
+	template <typename Func>
+	void for_each(const Func &f) const {
+		for (const slot &s : slots) {
+			if (s.key != EmptyKey)
+				f(s.key, s.value);
+		}
+	}
+
+	template <typename Func>
+	void for_each(const Func &f) {
+		for (slot &s : slots) {
+			if (s.key != EmptyKey)
+				f(s.key, s.value);
+		}
+	}
+
+	size_t byte_count() const { return slots.size() * sizeof(slot); }
+
+protected:
+	struct slot {
+		KeyType key;
+		ValueType value;
+	};
+	std::vector<slot> slots; // size is zero or a power of two
+	size_t nCount;
+	int nShift; // 64 - log2(slots.size())
+
+	// grow when more than 7/10 of the slots are used
+	static constexpr size_t MaxLoadNum = 7;
+	static constexpr size_t MaxLoadDen = 10;
+
+	// fibonacci hashing, spreads sequential IDs over the whole table
+	inline size_t hash(KeyType key) const {
+		uint64_t k = (uint64_t)(typename std::make_unsigned<KeyType>::type)key;
+		return (size_t)((k * 0x9E3779B97F4A7C15ull) >> nShift);
+	}
+
+	void rehash(size_t nSlots) {
+		std::vector<slot> old_slots(nSlots, slot{ EmptyKey, ValueType() });
+		old_slots.swap(slots);
+		nShift = 64;
+		for (size_t n = nSlots; n > 1; n >>= 1)
+			nShift--;
+		size_t mask = nSlots - 1;
+		for (const slot &s : old_slots) {
+			if (s.key == EmptyKey)
+				continue;
+			size_t i = hash(s.key);
+			while (slots[i].key != EmptyKey)
+				i = (i + 1) & mask;
+			slots[i] = s;
+		}
+	}
+};
+
+} // end namespace g3
+
+#endif // INT_HASH_MAP_H
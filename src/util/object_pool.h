@@ -31,7 +31,9 @@
 #ifndef OBJECT_POOL_H
 #define OBJECT_POOL_H
 
-#include <dvector.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 namespace g3 {
 
@@ -46,6 +48,14 @@ public:
 	virtual void release(Type *pObject) = 0;
 };
 
+// usage counters for object_pool
+struct object_pool_stats {
+	size_t capacity = 0; // objects constructed in the pool's blocks
+	size_t in_use = 0; // objects currently handed out
+	size_t high_water = 0; // maximum of in_use
+	size_t free = 0; // objects on the free list
+};
+
 template <class Type>
 class object_pool : public object_allocator<Type> {
 public:
@@ -58,11 +68,11 @@ public:
 	const object_pool<Type> &operator=(const object_pool<Type> &copy) = delete;
 
 	// can do move semantics because as pointers will not be invalidated
-	object_pool(const object_pool<Type> &&moved);
-	const object_pool<Type> &operator=(const object_pool<Type> &&moved);
+	object_pool(object_pool<Type> &&moved);
+	const object_pool<Type> &operator=(object_pool<Type> &&moved);
 
 	//
-	// object_allocator interface
+	// object_allocator interface. Not threadsafe
 	//
 
 	// allocate a new instance of the object (either new memory or from free list)
@@ -81,17 +91,34 @@ public:
 	// clear memory
 	void free_pool();
 
-protected:
-	// dvector grows in blocks, so it is safe to store pointers into it
-	dvector<Type> m_store;
+	object_pool_stats stats() const;
 
-	// pointers here are into m_store, but we do not actually know what index
+protected:
+	// objects live in fixed-size heap blocks that never move, so it is safe
+	// to hand out pointers. (a dvector is not safe here, its blocks are
+	// relocated when the block table grows)
+	static constexpr size_t nBlockSize = 1024;
+	std::vector<std::unique_ptr<Type[]>> m_blocks;
+	size_t m_iCurBlock; // next unused object is m_blocks[m_iCurBlock][m_nBlockUsed]
+	size_t m_nBlockUsed;
+
+	// pointers here are into m_blocks, but we do not actually know what index
 	// because we only gave clients the pointer
 	std::vector<Type *> m_free;
+
+	size_t m_nInUse;
+	size_t m_nHighWater;
+
+	inline Type *new_object();
+	inline void count_in_use(size_t nAcquired) {
+		m_nInUse += nAcquired;
+		m_nHighWater = std::max(m_nHighWater, m_nInUse);
+	}
 };
 
 template <class Type>
-object_pool<Type>::object_pool() {
+object_pool<Type>::object_pool() :
+		m_iCurBlock(0), m_nBlockUsed(nBlockSize), m_nInUse(0), m_nHighWater(0) {
 }
 
 template <class Type>
@@ -99,22 +126,44 @@ object_pool<Type>::~object_pool() {
 }
 
 template <class Type>
-object_pool<Type>::object_pool(const object_pool<Type> &&moved) {
+object_pool<Type>::object_pool(object_pool<Type> &&moved) :
+		object_pool() {
 	*this = std::move(moved);
 }
 
 template <class Type>
-const object_pool<Type> &object_pool<Type>::operator=(const object_pool<Type> &&moved) {
-	m_store = std::move(moved.m_store);
+const object_pool<Type> &object_pool<Type>::operator=(object_pool<Type> &&moved) {
+	m_blocks = std::move(moved.m_blocks);
+	m_iCurBlock = moved.m_iCurBlock;
+	m_nBlockUsed = moved.m_nBlockUsed;
 	m_free = std::move(moved.m_free);
+	m_nInUse = moved.m_nInUse;
+	m_nHighWater = moved.m_nHighWater;
+	moved.free_pool();
 	return *this;
 }
 
+template <class Type>
+Type *object_pool<Type>::new_object() {
+	if (m_nBlockUsed == nBlockSize) {
+		if (m_blocks.empty() == false && m_iCurBlock + 1 < m_blocks.size()) {
+			m_iCurBlock++; // re-use block kept by reset_pool()
+		} else {
+			m_blocks.push_back(std::unique_ptr<Type[]>(new Type[nBlockSize]));
+			m_iCurBlock = m_blocks.size() - 1;
+		}
+		m_nBlockUsed = 0;
+	}
+	return &m_blocks[m_iCurBlock][m_nBlockUsed++];
+}
+
 template <class Type>
 Type *object_pool<Type>::allocate() {
+	count_in_use(1);
 	if (m_free.empty()) {
-		m_store.push_back(Type());
-		return &m_store.back();
+		Type *pObject = new_object();
+		*pObject = Type();
+		return pObject;
 	} else {
 		Type *pObject = m_free.back();
 		*pObject = Type();
@@ -125,19 +174,35 @@ Type *object_pool<Type>::allocate() {
 
 template <class Type>
 void object_pool<Type>::release(Type *pObject) {
+	m_nInUse--;
 	m_free.push_back(pObject);
 }
 
 template <class Type>
 void object_pool<Type>::reset_pool() {
 	m_free.clear();
-	m_store.clear(false);
+	m_iCurBlock = 0;
+	m_nBlockUsed = (m_blocks.empty()) ? nBlockSize : 0;
+	m_nInUse = 0;
 }
 
 template <class Type>
 void object_pool<Type>::free_pool() {
 	m_free.clear();
-	m_store.clear();
+	m_blocks.clear();
+	m_iCurBlock = 0;
+	m_nBlockUsed = nBlockSize;
+	m_nInUse = 0;
+}
+
+template <class Type>
+object_pool_stats object_pool<Type>::stats() const {
+	object_pool_stats s;
+	s.capacity = m_blocks.size() * nBlockSize;
+	s.in_use = m_nInUse;
+	s.high_water = m_nHighWater;
+	s.free = m_free.size();
+	return s;
 }
 
 } // end namespace g3
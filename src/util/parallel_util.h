@@ -32,64 +32,182 @@
 #define PARALLEL_UTIL_H
 
 #include <g3platform.h>
+#include <thread_pool.h>
+#include <algorithm>
 #include <atomic>
+#include <vector>
+
+#include <atomic_util.h>
 
 #ifdef G3_ENABLE_TBB
 #include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 #endif
 
 namespace g3 {
 
+// default block size for parallel loops over nCount elements. This only depends
+// on nCount (not on the number of threads), so block-ordered reductions are deterministic.
+inline int parallel_grain_size(int nCount) {
+	return std::max(256, nCount / 256);
+}
+
 // Non-TBB versions of these functions must use portable (eg C++11)
 //   multi-threading, or do serial computations
 #ifndef G3_ENABLE_TBB
 
-// evaluate f[k] = f(k)
-template <typename vector_type, typename ValueFunc>
-void parallel_fill(vector_type &v, const ValueFunc &f) {
-	size_t nCount = v.size();
-	for (unsigned int k = 0; k < nCount; ++k)
-		v[k] = f(k);
+// upper bound on the iTask index passed by parallel_for_tasks(), ie the number
+// of slots to allocate for per-task data (see per_task_accumulator)
+inline int parallel_max_tasks() {
+	return std::max(1, parallel_concurrency());
 }
 
-// evaluate f[k] = f(k), if valid(k)
-template <typename vector_type, typename ValueFunc, typename ValidFunc>
-void parallel_fill(vector_type &v, const ValueFunc &f, const ValidFunc &valid) {
-	size_t nCount = v.size();
-	for (unsigned int k = 0; k < nCount; ++k) {
-		if (valid(k) == true)
-			v[k] = f(k);
+// evaluate f(iTask,a,b) for contiguous blocks [a,b) that cover [iStart,iEnd).
+// iTask is in [0,parallel_max_tasks()), and blocks passed with the same iTask
+// never run concurrently, so f can update per-task data without synchronization
+template <typename TaskBlockFunc>
+void parallel_for_tasks(int iStart, int iEnd, const TaskBlockFunc &f, int nGrainSize = 0) {
+	int nCount = iEnd - iStart;
+	if (nCount <= 0)
+		return;
+	if (nGrainSize <= 0)
+		nGrainSize = parallel_grain_size(nCount);
+	int nBlocks = (nCount + nGrainSize - 1) / nGrainSize;
+	int nTasks = std::min(nBlocks, parallel_max_tasks());
+	if (nTasks <= 1) {
+		for (int a = iStart; a < iEnd; a += nGrainSize)
+			f(0, a, std::min(a + nGrainSize, iEnd));
+		return;
 	}
+
+	// each task pulls blocks off a shared counter until all are done
+	std::atomic<int> next_block(0);
+	parallel_invoke_indexed(nTasks, [&](int iTask) {
+		int bi;
+		while ((bi = next_block.fetch_add(1, std::memory_order_relaxed)) < nBlocks) {
+			int a = iStart + bi * nGrainSize;
+			f(iTask, a, std::min(a + nGrainSize, iEnd));
+		}
+	});
 }
 
 #else
 // TBB versions of these functions
 
+inline int parallel_max_tasks() {
+	return tbb::this_task_arena::max_concurrency();
+}
+
+// The task index is not the TBB thread index: a thread waiting inside a nested TBB loop
+// can steal and run another block of the outer loop. As above, each task pulls blocks
+// off a shared counter, so blocks with the same iTask run in order on one task.
+template <typename TaskBlockFunc>
+void parallel_for_tasks(int iStart, int iEnd, const TaskBlockFunc &f, int nGrainSize = 0) {
+	int nCount = iEnd - iStart;
+	if (nCount <= 0)
+		return;
+	if (nGrainSize <= 0)
+		nGrainSize = parallel_grain_size(nCount);
+	int nBlocks = (nCount + nGrainSize - 1) / nGrainSize;
+	int nTasks = std::min(nBlocks, parallel_max_tasks());
+	if (nTasks <= 1) {
+		for (int a = iStart; a < iEnd; a += nGrainSize)
+			f(0, a, std::min(a + nGrainSize, iEnd));
+		return;
+	}
+
+	std::atomic<int> next_block(0);
+	tbb::parallel_for(0, nTasks, [&](int iTask) {
+		int bi;
+		while ((bi = next_block.fetch_add(1, std::memory_order_relaxed)) < nBlocks) {
+			int a = iStart + bi * nGrainSize;
+			f(iTask, a, std::min(a + nGrainSize, iEnd));
+		}
+	});
+}
+
+#endif
+
+// evaluate f(a,b) for contiguous blocks [a,b) that cover [iStart,iEnd)
+template <typename BlockFunc>
+void parallel_for_blocks(int iStart, int iEnd, const BlockFunc &f, int nGrainSize = 0) {
+	parallel_for_tasks(
+			iStart, iEnd, [&](int, int a, int b) {
+				f(a, b);
+			},
+			nGrainSize);
+}
+
+// evaluate f(k) for k in [iStart,iEnd)
+template <typename Func>
+void parallel_for(int iStart, int iEnd, const Func &f, int nGrainSize = 0) {
+	parallel_for_blocks(
+			iStart, iEnd, [&](int a, int b) {
+				for (int k = a; k < b; ++k)
+					f(k);
+			},
+			nGrainSize);
+}
+
+// reduce over [iStart,iEnd). blockF(a, b, identity) returns the value for block [a,b).
+// Block values are merged in block order with combineF(x,y), so the result does not
+// depend on thread count or scheduling (even for non-associative floating-point sums)
+template <typename T, typename BlockFunc, typename CombineFunc>
+T parallel_reduce(int iStart, int iEnd, const T &identity, const BlockFunc &blockF, const CombineFunc &combineF, int nGrainSize = 0) {
+	int nCount = iEnd - iStart;
+	if (nCount <= 0)
+		return identity;
+	if (nGrainSize <= 0)
+		nGrainSize = parallel_grain_size(nCount);
+	int nBlocks = (nCount + nGrainSize - 1) / nGrainSize;
+	std::vector<T> block_values(nBlocks, identity);
+	parallel_for(
+			0, nBlocks, [&](int bi) {
+				int a = iStart + bi * nGrainSize;
+				block_values[bi] = blockF(a, std::min(a + nGrainSize, iEnd), identity);
+			},
+			1);
+	T result = identity;
+	for (int bi = 0; bi < nBlocks; ++bi)
+		result = combineF(result, block_values[bi]);
+	return result;
+}
+
+// accumulate f(k, acc) for k in [iStart,iEnd) into one cache-line-padded accumulator
+// per task (starting from identity), then merge them with combineF(x,y).
+// Cheaper than parallel_reduce when the per-element work is tiny, but the merge order
+// follows the task schedule, so floating-point sums may differ in the last bits
+template <typename T, typename Func, typename CombineFunc>
+T parallel_accumulate(int iStart, int iEnd, const T &identity, const Func &f, const CombineFunc &combineF, int nGrainSize = 0) {
+	per_task_accumulator<T> accum(parallel_max_tasks(), identity);
+	parallel_for_tasks(
+			iStart, iEnd, [&](int iTask, int a, int b) {
+				T &local = accum.local(iTask);
+				for (int k = a; k < b; ++k)
+					f(k, local);
+			},
+			nGrainSize);
+	return accum.combine(combineF);
+}
+
 // evaluate f[k] = f(k)
 template <typename vector_type, typename ValueFunc>
 void parallel_fill(vector_type &v, const ValueFunc &f) {
-	unsigned int nCount = (unsigned int)v.size();
-	tbb::parallel_for(tbb::blocked_range<unsigned int>(0, nCount),
-			[&](const tbb::blocked_range<unsigned int> &r) {
-				for (unsigned int k = r.begin(); k != r.end(); ++k)
-					v[k] = f(k);
-			});
+	int nCount = (int)v.size();
+	parallel_for(0, nCount, [&](int k) {
+		v[k] = f(k);
+	});
 }
 
 // evaluate f[k] = f(k), if valid(k)
 template <typename vector_type, typename ValueFunc, typename ValidFunc>
 void parallel_fill(vector_type &v, const ValueFunc &f, const ValidFunc &valid) {
-	unsigned int nCount = (unsigned int)v.size();
-	tbb::parallel_for(tbb::blocked_range<unsigned int>(0, nCount),
-			[&](const tbb::blocked_range<unsigned int> &r) {
-				for (unsigned int k = r.begin(); k != r.end(); ++k) {
-					if (valid(k) == true)
-						v[k] = f(k);
-				}
-			});
+	int nCount = (int)v.size();
+	parallel_for(0, nCount, [&](int k) {
+		if (valid(k) == true)
+			v[k] = f(k);
+	});
 }
 
-#endif
-
 } // end namespace g3
 #endif // PARALLEL_UTIL_H
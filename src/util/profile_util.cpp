@@ -0,0 +1,388 @@
+/**************************************************************************/
+/*  profile_util.cpp                                                      */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#include <profile_util.h>
+#include <geometry3PCH.h>
+
+#include <cstring>
+#include <functional>
+#include <map>
+
+// for the OS thread IDs of trace events
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+namespace g3 {
+
+static std::atomic<LocalProfiler *> active_profiler(nullptr);
+// overrides active_profiler on one thread, see SetThreadActive()
+static thread_local LocalProfiler *thread_active_profiler = nullptr;
+static std::atomic<uint64_t> next_profiler_serial(1);
+
+// per-thread cache of the last profiler used on this thread, avoids taking the lock in Enter()
+struct profiler_tls_cache {
+	uint64_t serial = 0;
+	void *data = nullptr;
+};
+static thread_local profiler_tls_cache tls_profiler;
+
+// per-thread allocation counters, trivially constructible so NoteAllocation() never allocates
+struct allocation_counters {
+	int64_t count;
+	int64_t bytes;
+};
+static thread_local allocation_counters tls_allocations = { 0, 0 };
+
+void LocalProfiler::NoteAllocation(size_t nBytes) {
+	tls_allocations.count++;
+	tls_allocations.bytes += (int64_t)nBytes;
+}
+
+int64_t LocalProfiler::ThreadAllocationCount() {
+	return tls_allocations.count;
+}
+
+// ID of the calling thread as shown by debuggers and system profilers
+static int64_t os_thread_id() {
+#if defined(_WIN32)
+	return (int64_t)GetCurrentThreadId();
+#elif defined(__linux__)
+	return (int64_t)syscall(SYS_gettid);
+#elif defined(__APPLE__)
+	uint64_t tid = 0;
+	pthread_threadid_np(nullptr, &tid);
+	return (int64_t)tid;
+#else
+	// keep it exactly representable as a JSON number
+	return (int64_t)(std::hash<std::thread::id>()(std::this_thread::get_id()) & ((1ull << 52) - 1));
+#endif
+}
+
+LocalProfiler::LocalProfiler(bool bEnabled) :
+		enabled(bEnabled), record_trace(false), epoch(clock::now()), serial(next_profiler_serial.fetch_add(1)) {
+}
+
+LocalProfiler::~LocalProfiler() {
+	LocalProfiler *self = this;
+	active_profiler.compare_exchange_strong(self, nullptr);
+	if (thread_active_profiler == this)
+		thread_active_profiler = nullptr;
+}
+
+LocalProfiler *LocalProfiler::Active() {
+	if (thread_active_profiler != nullptr)
+		return thread_active_profiler;
+	return active_profiler.load(std::memory_order_acquire);
+}
+
+void LocalProfiler::SetActive(LocalProfiler *profiler) {
+	active_profiler.store(profiler, std::memory_order_release);
+}
+
+LocalProfiler *LocalProfiler::ThreadActive() {
+	return thread_active_profiler;
+}
+
+void LocalProfiler::SetThreadActive(LocalProfiler *profiler) {
+	thread_active_profiler = profiler;
+}
+
+void LocalProfiler::reset_nodes(thread_data &td) {
+	td.nodes.clear();
+	td.nodes.push_back(node{ "", -1, -1, -1, 0, 0, 0, 0 });
+	td.current = 0;
+	td.start_stack.clear();
+	td.events.clear();
+	td.dropped_events = 0;
+}
+
+LocalProfiler::thread_data &LocalProfiler::local() {
+	if (tls_profiler.serial == serial)
+		return *static_cast<thread_data *>(tls_profiler.data);
+
+	std::lock_guard<std::mutex> l(lock);
+	std::thread::id id = std::this_thread::get_id();
+	thread_data *found = nullptr;
+	for (auto &td : threads) {
+		if (td->thread_id == id)
+			found = td.get();
+	}
+	if (found == nullptr) {
+		threads.push_back(std::make_unique<thread_data>());
+		found = threads.back().get();
+		found->thread_id = id;
+		found->os_thread_id = os_thread_id();
+		found->thread_index = (int)threads.size() - 1;
+		reset_nodes(*found);
+	}
+	tls_profiler.serial = serial;
+	tls_profiler.data = found;
+	return *found;
+}
+
+void LocalProfiler::Enter(const char *label, int64_t nTag) {
+	thread_data &td = local();
+	int iChild = td.nodes[td.current].first_child, iLast = -1;
+	while (iChild >= 0) {
+		const char *child_label = td.nodes[iChild].label;
+		if (child_label == label || strcmp(child_label, label) == 0)
+			break;
+		iLast = iChild;
+		iChild = td.nodes[iChild].next_sibling;
+	}
+	if (iChild < 0) {
+		iChild = (int)td.nodes.size();
+		td.nodes.push_back(node{ label, td.current, -1, -1, 0, 0, 0, 0 });
+		if (iLast >= 0)
+			td.nodes[iLast].next_sibling = iChild;
+		else
+			td.nodes[td.current].first_child = iChild;
+	}
+	td.current = iChild;
+	td.start_stack.push_back(open_scope{ clock::now(), nTag, tls_allocations.count, tls_allocations.bytes });
+}
+
+void LocalProfiler::Exit() {
+	clock::time_point end_time = clock::now();
+	thread_data &td = local();
+	if (td.current == 0 || td.start_stack.empty())
+		return; // unbalanced Exit()
+	const open_scope &scope = td.start_stack.back();
+	node &n = td.nodes[td.current];
+	int64_t duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - scope.start_time).count();
+	n.total_ns += duration_ns;
+	n.count++;
+	n.allocations += tls_allocations.count - scope.allocations_start;
+	n.allocated_bytes += tls_allocations.bytes - scope.allocated_bytes_start;
+	if (RecordingTrace()) {
+		if ((int64_t)td.events.size() < MaxTraceEvents) {
+			int64_t start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(scope.start_time - epoch).count();
+			td.events.push_back(trace_event{ td.current, scope.tag, start_ns, duration_ns });
+		} else
+			td.dropped_events++;
+	}
+	td.start_stack.pop_back();
+	td.current = n.parent;
+}
+
+void LocalProfiler::Clear() {
+	std::lock_guard<std::mutex> l(lock);
+	for (auto &td : threads)
+		reset_nodes(*td);
+	epoch = clock::now();
+}
+
+std::vector<LocalProfiler::Entry> LocalProfiler::Results() const {
+	std::vector<Entry> entries;
+	std::map<std::string, size_t> index;
+
+	std::lock_guard<std::mutex> l(lock);
+	for (const auto &td : threads) {
+		// depth-first traversal, path of each node is built from its parent's
+		std::vector<std::pair<int, std::string>> stack;
+		for (int iChild = td->nodes[0].first_child; iChild >= 0; iChild = td->nodes[iChild].next_sibling)
+			stack.push_back(std::make_pair(iChild, std::string()));
+		std::reverse(stack.begin(), stack.end());
+		while (stack.empty() == false) {
+			int iNode = stack.back().first;
+			std::string parent_path = stack.back().second;
+			stack.pop_back();
+
+			const node &n = td->nodes[iNode];
+			std::string path = parent_path.empty() ? std::string(n.label) : parent_path + "/" + n.label;
+			auto found = index.find(path);
+			if (found == index.end()) {
+				Entry e;
+				e.path = path;
+				e.label = n.label;
+				e.depth = (int)std::count(path.begin(), path.end(), '/');
+				e.total_ms = 0;
+				e.count = 0;
+				e.thread_count = 0;
+				e.allocations = 0;
+				e.allocated_bytes = 0;
+				found = index.insert(std::make_pair(path, entries.size())).first;
+				entries.push_back(e);
+			}
+			Entry &e = entries[found->second];
+			e.total_ms += (double)n.total_ns / 1.0e6;
+			e.count += n.count;
+			e.thread_count++;
+			e.allocations += n.allocations;
+			e.allocated_bytes += n.allocated_bytes;
+
+			size_t nFirst = stack.size();
+			for (int iChild = n.first_child; iChild >= 0; iChild = td->nodes[iChild].next_sibling)
+				stack.push_back(std::make_pair(iChild, path));
+			std::reverse(stack.begin() + nFirst, stack.end());
+		}
+	}
+
+	// entries of later threads may have been appended after unrelated scopes, restore tree order
+	std::vector<Entry> sorted;
+	sorted.reserve(entries.size());
+	std::vector<bool> done(entries.size(), false);
+	for (size_t k = 0; k < entries.size(); ++k) {
+		if (done[k] || entries[k].depth != 0)
+			continue;
+		std::vector<size_t> stack(1, k);
+		while (stack.empty() == false) {
+			size_t i = stack.back();
+			stack.pop_back();
+			done[i] = true;
+			sorted.push_back(entries[i]);
+			std::string prefix = entries[i].path + "/";
+			size_t nFirst = stack.size();
+			for (size_t j = i + 1; j < entries.size(); ++j) {
+				if (done[j] == false && entries[j].depth == entries[i].depth + 1 &&
+						entries[j].path.compare(0, prefix.size(), prefix) == 0)
+					stack.push_back(j);
+			}
+			std::reverse(stack.begin() + nFirst, stack.end());
+		}
+	}
+	return sorted;
+}
+
+double LocalProfiler::AccumulatedMilliseconds(const std::string &path) const {
+	for (const Entry &e : Results()) {
+		if (e.path == path)
+			return e.total_ms;
+	}
+	return 0;
+}
+
+std::string LocalProfiler::AllAccumulatedTimes(const std::string &prefix, const std::string &separator) const {
+	std::string s = prefix + " ";
+	char buf[64];
+	for (const Entry &e : Results()) {
+		snprintf(buf, sizeof(buf), "%.3fms (%lld)", e.total_ms, (long long)e.count);
+		s += e.path + ": " + buf + separator;
+	}
+	return s;
+}
+
+std::string LocalProfiler::Report() const {
+	std::string s;
+	char buf[64];
+	for (const Entry &e : Results()) {
+		s += std::string(2 * e.depth, ' ') + e.label;
+		snprintf(buf, sizeof(buf), "  %.3fms  x%lld", e.total_ms, (long long)e.count);
+		s += buf;
+		if (e.thread_count > 1) {
+			snprintf(buf, sizeof(buf), "  [%d threads]", e.thread_count);
+			s += buf;
+		}
+		if (e.allocations > 0) {
+			snprintf(buf, sizeof(buf), "  %lld allocs %.1fkb", (long long)e.allocations, (double)e.allocated_bytes / 1024.0);
+			s += buf;
+		}
+		s += "\n";
+	}
+	return s;
+}
+
+static void append_json_string(std::string &s, const char *str) {
+	s += '"';
+	for (const char *c = str; *c != 0; ++c) {
+		if (*c == '"' || *c == '\\') {
+			s += '\\';
+			s += *c;
+		} else if ((unsigned char)*c < 0x20)
+			s += ' ';
+		else
+			s += *c;
+	}
+	s += '"';
+}
+
+std::string LocalProfiler::ChromeTraceJSON() const {
+	std::string s = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	char buf[256];
+	bool bFirst = true;
+
+	std::lock_guard<std::mutex> l(lock);
+	for (const auto &td : threads) {
+		// each thread's events are on its own track, ordered by when the thread first entered a scope
+		long long tid = (long long)td->os_thread_id;
+		snprintf(buf, sizeof(buf), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lld,\"args\":{\"name\":\"g3 thread %d\"}}",
+				bFirst ? "" : ",", tid, td->thread_index);
+		s += buf;
+		snprintf(buf, sizeof(buf), ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%lld,\"args\":{\"sort_index\":%d}}",
+				tid, td->thread_index);
+		s += buf;
+		bFirst = false;
+
+		// events are recorded when scopes close, so sort by start time for readability
+		std::vector<const trace_event *> sorted;
+		sorted.reserve(td->events.size());
+		for (const trace_event &e : td->events)
+			sorted.push_back(&e);
+		std::stable_sort(sorted.begin(), sorted.end(),
+				[](const trace_event *a, const trace_event *b) { return a->start_ns < b->start_ns; });
+
+		for (const trace_event *e : sorted) {
+			s += ",\n{\"name\":";
+			append_json_string(s, td->nodes[e->node].label);
+			snprintf(buf, sizeof(buf), ",\"cat\":\"g3\",\"ph\":\"X\",\"pid\":1,\"tid\":%lld,\"ts\":%.3f,\"dur\":%.3f",
+					tid, (double)e->start_ns / 1000.0, (double)e->duration_ns / 1000.0);
+			s += buf;
+			if (e->tag >= 0) {
+				snprintf(buf, sizeof(buf), ",\"args\":{\"tag\":%lld}", (long long)e->tag);
+				s += buf;
+			}
+			s += "}";
+		}
+		if (td->dropped_events > 0) {
+			snprintf(buf, sizeof(buf), ",\n{\"name\":\"dropped events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%lld,\"ts\":0,\"args\":{\"count\":%lld}}",
+					tid, (long long)td->dropped_events);
+			s += buf;
+		}
+	}
+	s += "\n]}\n";
+	return s;
+}
+
+bool LocalProfiler::WriteChromeTrace(const std::string &filename) const {
+	std::string json = ChromeTraceJSON();
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (f == nullptr)
+		return false;
+	bool bOk = fwrite(json.data(), 1, json.size(), f) == json.size();
+	return (fclose(f) == 0) && bOk;
+}
+
+} // end namespace g3
@@ -31,8 +31,17 @@
 #ifndef PROFILE_UTIL_H
 #define PROFILE_UTIL_H
 
+#include <g3Config.h>
+
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace g3 {
 
@@ -101,143 +110,230 @@ public:
 };
 
 //
+// LocalProfiler is a hierarchical, thread-aware scope profiler.
 //
+// Each thread that enters a scope gets its own tree of named scopes, so timing
+// needs no synchronization. Re-entering the same scope under the same parent
+// accumulates into one node (total time and call count). Results() merges the
+// per-thread trees by scope path ("RemeshPass/ops/split").
 //
-// class LocalProfiler : IDisposable
-//{
-//	Dictionary<std::string, BlockTimer> Timers = new Dictionary<std::string, BlockTimer>();
-//	List<std::string> Order = new List<std::string>();
-//
-//	BlockTimer Start(std::string label)
-//	{
-//		if (Timers.ContainsKey(label)) {
-//			Timers[label].Reset();
-//		}
-//		else {
-//			Timers[label] = new BlockTimer(label, true);
-//			Order.Add(label);
-//		}
-//		return Timers[label];
-//	}
-//
-//
-//	BlockTimer StopAllAndStartNew(std::string label)
-//	{
-//		StopAll();
-//		return Start(label);
-//	}
-//
-//	BlockTimer Get(std::string label)
-//	{
-//		return Timers[label];
-//	}
-//
-//
-//	void Stop(std::string label)
-//	{
-//		Timers[label].Stop();
-//	}
-//
-//	void StopAll()
-//	{
-//		foreach(BlockTimer t in Timers.Values)
-//			if (t.Running)
-//				t.Stop();
-//	}
+// Scope labels are compared by pointer first, and must stay alive as long as the
+// profiler (use string literals).
 //
+// Use profile_scope (or G3_PROFILE_SCOPE) to time a block. With no profiler (or a
+// disabled one) a scope costs one load and a branch. Code that is not handed a
+// profiler explicitly uses LocalProfiler::Active(): the calling thread's profiler if
+// one is set (see thread_profiler_activation), otherwise the process-wide one.
 //
-//	void StopAndAccumulate(std::string label, bool bReset = false)
-//	{
-//		Timers[label].Accumulate(bReset);
-//	}
+// With SetRecordTrace(true), every closed scope is also recorded as a timeline event
+// in a buffer of the thread that closed it. ChromeTraceJSON() merges the buffers into
+// Chrome trace-event format (open the file in Perfetto or chrome://tracing), with one
+// track per thread, identified by its OS thread ID. Parallel loops show up there if
+// their tasks open scopes on the pool threads (eg the Remesher's "smooth.worker").
 //
-//	void Reset(std::string label)
-//	{
-//		Timers[label].Reset();
-//	}
+// Heap allocations can also be counted per scope. g3 does not replace the allocator,
+// so the host application has to call NoteAllocation() from its allocation hook
+// (eg a replaced global operator new). Without that the counts stay zero.
 //
-//	void ResetAccumulated(std::string label)
-//	{
-//		Timers[label].Accumulated = TimeSpan.Zero;
-//	}
-//
-//	void ResetAllAccumulated(std::string label)
-//	{
-//		foreach(BlockTimer t in Timers.Values)
-//			t.Accumulated = TimeSpan.Zero;
-//	}
-//
-//	void DivideAllAccumulated(int div)
-//	{
-//		foreach(BlockTimer t in Timers.Values) {
-//			t.Accumulated = new TimeSpan(t.Accumulated.Ticks / div);
-//		}
-//	}
-//
-//
-//	std::string Elapsed(std::string label)
-//	{
-//		return Timers[label].Tostd::string();
-//	}
-//	std::string Accumulated(std::string label)
-//	{
-//		TimeSpan accum = Timers[label].Accumulated;
-//		return std::string.Format(BlockTimer.TimeFormatstd::string(accum), accum);
-//	}
-//
-//	std::string AllTicks(std::string prefix = "Times:")
-//	{
-//		std::stringBuilder b = new std::stringBuilder();
-//		b.Append(prefix + " ");
-//		foreach(std::string label in Order) {
-//			b.Append(label + ": " + Timers[label].Tostd::string() + " ");
-//		}
-//		return b.Tostd::string();
-//	}
-//
-//	std::string AllAccumulatedTicks(std::string prefix = "Times:")
-//	{
-//		std::stringBuilder b = new std::stringBuilder();
-//		b.Append(prefix + " ");
-//		foreach(std::string label in Order) {
-//			b.Append(label + ": " + Accumulated(label) + " ");
-//		}
-//		return b.Tostd::string();
-//	}
+// Enter/Exit may be called from any thread concurrently. Clear(), Results() and the
+// report/export functions must only be called while no scopes are open.
 //
+class LocalProfiler {
+public:
+	struct Entry {
+		std::string path; // labels of the scope and its parents, separated by '/'
+		std::string label;
+		int depth; // 0 for top-level scopes
+		double total_ms; // summed over all threads
+		int64_t count;
+		int thread_count; // number of threads that entered this scope
+		int64_t allocations; // heap allocations inside the scope (including nested scopes), see NoteAllocation()
+		int64_t allocated_bytes;
+	};
+
+	g3External explicit LocalProfiler(bool bEnabled = true);
+	g3External ~LocalProfiler();
+
+	LocalProfiler(const LocalProfiler &copy) = delete;
+	const LocalProfiler &operator=(const LocalProfiler &copy) = delete;
+
+	bool Enabled() const { return enabled.load(std::memory_order_relaxed); }
+	void SetEnabled(bool bEnabled) { enabled.store(bEnabled, std::memory_order_relaxed); }
+
+	// open a scope nested inside the calling thread's current scope. A non-negative
+	// nTag (eg a surface index) is stored with the trace event of this scope.
+	g3External void Enter(const char *label, int64_t nTag = -1);
+	// close the calling thread's current scope
+	g3External void Exit();
+
+	// discard all timings and trace events
+	g3External void Clear();
+
+	// record a trace event for each closed scope, at most MaxTraceEvents per thread
+	void SetRecordTrace(bool bRecord) { record_trace.store(bRecord, std::memory_order_relaxed); }
+	bool RecordingTrace() const { return record_trace.load(std::memory_order_relaxed); }
+	int64_t MaxTraceEvents = 1 << 20;
+
+	// recorded events as Chrome trace-event JSON. Timestamps are relative to construction or the last Clear()
+	g3External std::string ChromeTraceJSON() const;
+	// write ChromeTraceJSON() to a file, returns false if the file could not be written
+	g3External bool WriteChromeTrace(const std::string &filename) const;
+
+	// merged per-thread results, in depth-first order
+	g3External std::vector<Entry> Results() const;
+
+	// total time of the scope with this path, or 0 if it was never entered
+	g3External double AccumulatedMilliseconds(const std::string &path) const;
+
+	// one line per scope path with total time and count
+	g3External std::string AllAccumulatedTimes(const std::string &prefix = "Times:", const std::string &separator = " ") const;
+	// indented tree of scopes
+	g3External std::string Report() const;
+
+	// count one heap allocation on the calling thread. Called from allocator hooks,
+	// so it does not allocate or lock.
+	g3External static void NoteAllocation(size_t nBytes);
+	// allocations noted on the calling thread so far
+	g3External static int64_t ThreadAllocationCount();
+
+	// profiler used by code that is not given one explicitly (nullptr means none)
+	g3External static LocalProfiler *Active();
+	g3External static void SetActive(LocalProfiler *profiler);
+	// profiler that Active() returns on the calling thread instead of the process-wide one
+	g3External static LocalProfiler *ThreadActive();
+	g3External static void SetThreadActive(LocalProfiler *profiler);
+
+protected:
+	typedef std::chrono::steady_clock clock;
+
+	struct node {
+		const char *label;
+		int parent;
+		int first_child;
+		int next_sibling;
+		int64_t total_ns;
+		int64_t count;
+		int64_t allocations;
+		int64_t allocated_bytes;
+	};
+
+	struct open_scope {
+		clock::time_point start_time;
+		int64_t tag;
+		int64_t allocations_start;
+		int64_t allocated_bytes_start;
+	};
+
+	struct trace_event {
+		int node;
+		int64_t tag;
+		int64_t start_ns;
+		int64_t duration_ns;
+	};
+
+	struct thread_data {
+		std::thread::id thread_id;
+		int64_t os_thread_id; // tid of the trace events
+		int thread_index;
+		std::vector<node> nodes; // nodes[0] is the root
+		int current;
+		std::vector<open_scope> start_stack;
+		std::vector<trace_event> events;
+		int64_t dropped_events;
+	};
+
+	std::atomic<bool> enabled;
+	std::atomic<bool> record_trace;
+	clock::time_point epoch;
+	uint64_t serial;
+	mutable std::mutex lock;
+	std::vector<std::unique_ptr<thread_data>> threads;
+
+	thread_data &local();
+	static void reset_nodes(thread_data &td);
+};
+
 //
+// profile_scope times the enclosing block with a LocalProfiler
 //
-//	std::string AllTimes(std::string prefix = "Times:", std::string separator = " ")
-//	{
-//		std::stringBuilder b = new std::stringBuilder();
-//		b.Append(prefix + " ");
-//		foreach(std::string label in Order) {
-//			TimeSpan span = Timers[label].Watch.Elapsed;
-//			b.Append(label + ": " + std::string.Format(BlockTimer.TimeFormatstd::string(span), span) + separator);
-//		}
-//		return b.Tostd::string();
-//	}
+class profile_scope {
+	LocalProfiler *profiler;
+
+public:
+	explicit profile_scope(const char *label, int64_t nTag = -1) :
+			profile_scope(LocalProfiler::Active(), label, nTag) {}
+	profile_scope(LocalProfiler *use_profiler, const char *label, int64_t nTag = -1) :
+			profiler((use_profiler != nullptr && use_profiler->Enabled()) ? use_profiler : nullptr) {
+		if (profiler != nullptr)
+			profiler->Enter(label, nTag);
+	}
+	~profile_scope() {
+		Close();
+	}
+
+	// end the scope before the end of the block
+	void Close() {
+		if (profiler != nullptr)
+			profiler->Exit();
+		profiler = nullptr;
+	}
+
+	profile_scope(const profile_scope &copy) = delete;
+	const profile_scope &operator=(const profile_scope &copy) = delete;
+};
+
 //
-//	std::string AllAccumulatedTimes(std::string prefix = "Times:", std::string separator = " ")
-//	{
-//		std::stringBuilder b = new std::stringBuilder();
-//		b.Append(prefix + " ");
-//		foreach(std::string label in Order) {
-//			TimeSpan span = Timers[label].Accumulated;
-//			b.Append(label + ": " + std::string.Format(BlockTimer.TimeFormatstd::string(span), span) + separator);
-//		}
-//		return b.Tostd::string();
-//	}
+// profiler_activation makes a profiler the Active() one for its lifetime. Active() is
+// process-wide, so code that may run concurrently should pass its profiler explicitly.
 //
+class profiler_activation {
+	LocalProfiler *previous;
+
+public:
+	explicit profiler_activation(LocalProfiler *profiler) :
+			previous(LocalProfiler::Active()) {
+		LocalProfiler::SetActive(profiler);
+	}
+	~profiler_activation() {
+		LocalProfiler::SetActive(previous);
+	}
+
+	profiler_activation(const profiler_activation &copy) = delete;
+	const profiler_activation &operator=(const profiler_activation &copy) = delete;
+};
+
 //
+// thread_profiler_activation makes a profiler the Active() one on the calling thread
+// only, eg for one call of a host-side operator that may run on several threads at
+// once. Scopes that pool threads open via Active() are not affected.
 //
-//	void Dispose()
-//	{
-//		foreach(var timer in Timers.Values)
-//			timer.Stop();
-//		Timers.Clear();
-//	}
-//};
+class thread_profiler_activation {
+	LocalProfiler *previous;
+
+public:
+	explicit thread_profiler_activation(LocalProfiler *profiler) :
+			previous(LocalProfiler::ThreadActive()) {
+		LocalProfiler::SetThreadActive(profiler);
+	}
+	~thread_profiler_activation() {
+		LocalProfiler::SetThreadActive(previous);
+	}
+
+	thread_profiler_activation(const thread_profiler_activation &copy) = delete;
+	const thread_profiler_activation &operator=(const thread_profiler_activation &copy) = delete;
+};
 
 } // namespace g3
+
+// define G3_DISABLE_PROFILING to compile out all G3_PROFILE_SCOPE blocks
+#ifndef G3_DISABLE_PROFILING
+#define G3_PROFILE_CONCAT_INNER(a, b) a##b
+#define G3_PROFILE_CONCAT(a, b) G3_PROFILE_CONCAT_INNER(a, b)
+#define G3_PROFILE_SCOPE(label) g3::profile_scope G3_PROFILE_CONCAT(g3_profile_scope_, __LINE__)(label)
+#define G3_PROFILE_SCOPE_TAG(label, tag) g3::profile_scope G3_PROFILE_CONCAT(g3_profile_scope_, __LINE__)(label, tag)
+#else
+#define G3_PROFILE_SCOPE(label)
+#define G3_PROFILE_SCOPE_TAG(label, tag)
+#endif
+
 #endif // PROFILE_UTIL_H
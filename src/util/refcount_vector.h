@@ -31,7 +31,9 @@
 #ifndef REFCOUNT_VECTOR_H
 #define REFCOUNT_VECTOR_H
 
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <dvector.h>
 #include <g3Debug.h>
@@ -78,7 +80,7 @@ public:
 	//         rebuild_free_list();
 	// }
 
-	dvector<short> RawRefCounts() {
+	dvector<short> &RawRefCounts() {
 		return ref_counts;
 	}
 
@@ -95,6 +97,18 @@ public:
 		return free_indices.length() == 0;
 	}
 
+	// number of indices in the free list
+	size_t free_count() const {
+		return free_indices.size();
+	}
+	// memory allocated by the refcount and free-list buffers
+	size_t refcount_byte_count() const {
+		return ref_counts.byte_count();
+	}
+	size_t free_list_byte_count() const {
+		return free_indices.byte_count();
+	}
+
 	bool isValid(int index) const {
 		return (index >= 0 && index < ref_counts.size() && ref_counts[index] > 0);
 	}
@@ -111,6 +125,8 @@ public:
 	}
 
 	int allocate() {
+		if (concurrent_per_slot > 0)
+			return allocate_concurrent();
 		used_count++;
 		if (free_indices.empty()) {
 			// [RMS] do we need this branch anymore?
@@ -144,7 +160,10 @@ public:
 		gDevAssert(isValid(index));
 		ref_counts[index] -= decrement;
 		gDevAssert(ref_counts[index] >= 0);
-		if (ref_counts[index] == 0) {
+		if (ref_counts[index] == 0 && concurrent_per_slot > 0) {
+			ref_counts[index] = invalid;
+			concurrent_freed[current_slot()].push_back(index);
+		} else if (ref_counts[index] == 0) {
 			free_indices.push_back(index);
 			ref_counts[index] = invalid;
 			used_count--;
@@ -212,6 +231,75 @@ public:
 		}
 	}
 
+	//
+	// Concurrent allocation. begin_concurrent() reserves nPerSlot indices for each of
+	// nSlots slots, reusing free indices first. Until end_concurrent(), allocate() hands
+	// out indices from the reservation of the calling thread's concurrent_slot(), and
+	// indices whose count drops to zero are parked per slot instead of going onto the
+	// free list, so threads using different slots (and touching different indices) never
+	// write shared state. end_concurrent() returns the freed and unused indices to the
+	// free list in slot order, so the result does not depend on how slots were scheduled.
+	//
+	void begin_concurrent(int nSlots, int nPerSlot) {
+		gDevAssert(concurrent_per_slot == 0 && nPerSlot > 0);
+		concurrent_base = (int)ref_counts.size();
+		concurrent_reserved.resize((size_t)nSlots * nPerSlot);
+		for (int &index : concurrent_reserved) {
+			index = invalid;
+			while (index == invalid && free_indices.empty() == false) {
+				index = free_indices.back();
+				free_indices.pop_back();
+			}
+			if (index == invalid) {
+				index = (int)ref_counts.size();
+				ref_counts.push_back(invalid);
+			}
+		}
+		concurrent_used.assign(nSlots, 0);
+		concurrent_freed.resize(nSlots);
+		concurrent_per_slot = nPerSlot;
+	}
+
+	void end_concurrent() {
+		int nSlots = (int)concurrent_used.size();
+		for (int k = 0; k < nSlots; ++k)
+			used_count += concurrent_used[k] - (int)concurrent_freed[k].size();
+
+		// drop trailing indices that were appended by begin_concurrent() and are unused
+		size_t new_size = ref_counts.size();
+		while (new_size > (size_t)concurrent_base && ref_counts[new_size - 1] == invalid)
+			new_size--;
+		ref_counts.resize(new_size);
+
+		for (int k = 0; k < nSlots; ++k) {
+			for (int index : concurrent_freed[k]) {
+				if (index < (int)new_size)
+					free_indices.push_back(index);
+			}
+			concurrent_freed[k].clear();
+		}
+		// unused reservations go on last, so that they are handed out again first, in the same order
+		for (int i = (int)concurrent_reserved.size() - 1; i >= 0; --i) {
+			int k = i / concurrent_per_slot, j = i % concurrent_per_slot;
+			int index = concurrent_reserved[i];
+			if (j >= concurrent_used[k] && index < (int)new_size)
+				free_indices.push_back(index);
+		}
+		concurrent_reserved.clear();
+		concurrent_used.clear();
+		concurrent_per_slot = 0;
+	}
+
+	bool is_concurrent() const {
+		return concurrent_per_slot > 0;
+	}
+
+	// slot used by allocate() and decrement() on the calling thread, see begin_concurrent()
+	static int &concurrent_slot() {
+		static thread_local int slot = -1;
+		return slot;
+	}
+
 	// [RMS] really should not use this!!
 	void set_Unsafe(int index, short count) {
 		ref_counts[index] = count;
@@ -240,6 +328,31 @@ public:
 		used_count = maxIndex;
 	}
 
+protected:
+	// concurrent allocation state, see begin_concurrent()
+	int concurrent_per_slot = 0;
+	int concurrent_base = 0;
+	std::vector<int> concurrent_reserved; // nPerSlot indices for each slot
+	std::vector<int> concurrent_used; // number of reserved indices allocated, per slot
+	std::vector<std::vector<int>> concurrent_freed; // indices freed, per slot
+
+	int current_slot() const {
+		int slot = concurrent_slot();
+		if (slot < 0 || slot >= (int)concurrent_used.size())
+			throw std::runtime_error("refcount_vector: concurrent edit outside of a reserved slot");
+		return slot;
+	}
+
+	int allocate_concurrent() {
+		int slot = current_slot();
+		if (concurrent_used[slot] == concurrent_per_slot)
+			throw std::runtime_error("refcount_vector: concurrent edit used up its reserved indices");
+		int index = concurrent_reserved[(size_t)slot * concurrent_per_slot + concurrent_used[slot]++];
+		ref_counts[index] = 1;
+		return index;
+	}
+
+public:
 	/*
 	 * base iterator for indices with valid refcount (skips zero-refcount indices)
 	 */
@@ -0,0 +1,192 @@
+/**************************************************************************/
+/*  scratch_arena.h                                                       */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace g3 {
+
+//
+// fixed-size uninitialized array carved out of a scratch_arena. Does not own
+// its memory, it is invalid after the arena is reset().
+//
+template <class Type>
+class scratch_array {
+public:
+	scratch_array() :
+			pData(nullptr), nSize(0) {}
+	scratch_array(Type *data, size_t size) :
+			pData(data), nSize(size) {}
+
+	inline Type &operator[](size_t i) { return pData[i]; }
+	inline const Type &operator[](size_t i) const { return pData[i]; }
+
+	size_t size() const { return nSize; }
+	bool empty() const { return nSize == 0; }
+	Type *data() { return pData; }
+	const Type *data() const { return pData; }
+	Type *begin() { return pData; }
+	Type *end() { return pData + nSize; }
+
+	void fill(const Type &value) { std::fill(pData, pData + nSize, value); }
+
+protected:
+	Type *pData;
+	size_t nSize;
+};
+
+//
+// scratch_arena is a bump allocator for temporary buffers that live for one
+// pass of an algorithm (eg a remesh pass). Allocation just advances an offset,
+// individual allocations are never freed, and reset() releases everything at once.
+//
+// Memory is kept across reset(), so after the first pass a repeated algorithm
+// does not hit malloc at all. If a pass needed more than one chunk, reset() merges
+// them into one chunk of the combined size.
+//
+// Only use for trivially-destructible types, destructors are never run.
+//
+// An arena is not threadsafe. Parallel loops can allocate their buffers up-front
+// and write disjoint ranges of them.
+//
+class scratch_arena {
+public:
+	explicit scratch_arena(size_t nMinChunkBytes = 64 * 1024) :
+			min_chunk_bytes(nMinChunkBytes), cur_chunk(0), cur_offset(0), used_prev_chunks(0), high_water(0) {}
+	~scratch_arena() { release_chunks(); }
+
+	scratch_arena(const scratch_arena &copy) = delete;
+	const scratch_arena &operator=(const scratch_arena &copy) = delete;
+
+	// allocate nBytes with the given (power-of-two) alignment
+	void *allocate(size_t nBytes, size_t nAlign = alignof(std::max_align_t)) {
+		while (cur_chunk < chunks.size()) {
+			chunk &c = chunks[cur_chunk];
+			size_t base = (size_t)c.data;
+			size_t aligned = (base + cur_offset + nAlign - 1) & ~(nAlign - 1);
+			if (aligned + nBytes <= base + c.size) {
+				cur_offset = aligned + nBytes - base;
+				high_water = std::max(high_water, bytes_used());
+				return (void *)aligned;
+			}
+			// current chunk is full, move on to the next one
+			used_prev_chunks += cur_offset;
+			cur_chunk++;
+			cur_offset = 0;
+		}
+		// geometric growth, so the number of chunks stays logarithmic in the total size
+		size_t nChunk = std::max(std::max(min_chunk_bytes, capacity()), nBytes + nAlign);
+		chunks.push_back(chunk{ (unsigned char *)std::malloc(nChunk), nChunk });
+		if (chunks.back().data == nullptr) {
+			chunks.pop_back();
+			throw std::bad_alloc();
+		}
+		cur_chunk = chunks.size() - 1;
+		return allocate(nBytes, nAlign);
+	}
+
+	// uninitialized array of nCount elements
+	template <class Type>
+	scratch_array<Type> make_array(size_t nCount) {
+		static_assert(std::is_trivially_destructible<Type>::value,
+				"scratch_arena does not run destructors");
+		return scratch_array<Type>((Type *)allocate(std::max(nCount, (size_t)1) * sizeof(Type), alignof(Type)), nCount);
+	}
+	template <class Type>
+	scratch_array<Type> make_array(size_t nCount, const Type &init) {
+		scratch_array<Type> a = make_array<Type>(nCount);
+		a.fill(init);
+		return a;
+	}
+
+	// release all allocations, keeping the memory
+	void reset() {
+		if (chunks.size() > 1) {
+			size_t nTotal = capacity();
+			release_chunks();
+			chunks.push_back(chunk{ (unsigned char *)std::malloc(nTotal), nTotal });
+			if (chunks.back().data == nullptr)
+				chunks.pop_back();
+		}
+		cur_chunk = 0;
+		cur_offset = 0;
+		used_prev_chunks = 0;
+	}
+
+	// bytes handed out since the last reset
+	size_t bytes_used() const { return used_prev_chunks + cur_offset; }
+	// bytes currently held by this arena
+	size_t capacity() const {
+		size_t n = 0;
+		for (const chunk &c : chunks)
+			n += c.size;
+		return n;
+	}
+	// maximum bytes_used() over the lifetime of this arena
+	size_t high_water_mark() const { return high_water; }
+
+	// free all memory
+	void clear() {
+		release_chunks();
+		cur_chunk = 0;
+		cur_offset = 0;
+		used_prev_chunks = 0;
+	}
+
+protected:
+	struct chunk {
+		unsigned char *data;
+		size_t size;
+	};
+	std::vector<chunk> chunks;
+	size_t min_chunk_bytes;
+	size_t cur_chunk;
+	size_t cur_offset;
+	size_t used_prev_chunks;
+	size_t high_water;
+
+	void release_chunks() {
+		for (chunk &c : chunks)
+			std::free(c.data);
+		chunks.clear();
+	}
+};
+
+} // end namespace g3
+
+#endif // SCRATCH_ARENA_H
@@ -31,11 +31,21 @@
 #ifndef SMALL_LIST_SET_H
 #define SMALL_LIST_SET_H
 
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 
 #include <dvector.h>
 #include <g3Debug.h>
 
+#include <sstream>
+
+// number of values stored inline in each list before spilling to the linked store
+#ifndef G3_SMALL_LIST_BLOCKSIZE
+#define G3_SMALL_LIST_BLOCKSIZE 8
+#endif
+
 namespace g3 {
 /// <summary>
 /// small_list_set stores a set of short integer-valued variable-size lists.
@@ -49,11 +59,13 @@ namespace g3 {
 /// Each list stores its count, so list-size operations are constant time.
 /// All the internal "pointers" are 32-bit.
 /// </summary>
-class small_list_set {
+template <int InlineCount = G3_SMALL_LIST_BLOCKSIZE>
+class basic_small_list_set {
 public:
 	static constexpr int Null = -1;
 
-	static constexpr int BLOCKSIZE = 8;
+	static constexpr int BLOCKSIZE = InlineCount;
+	static_assert(InlineCount > 0, "small_list_set needs at least one inline element");
 	static constexpr int BLOCK_LIST_OFFSET = BLOCKSIZE + 1;
 
 	dvector<int> list_heads; // each "list" is stored as index of first element in block-store (like a pointer)
@@ -69,7 +81,12 @@ public:
 
 	int free_head_ptr; // index of first free element in linked_store
 
-	small_list_set() {
+	// hops between linked nodes of the lists, and those that do not go to the next node
+	// in memory. Updated on each link edit, so LinkFragmentation() does not walk the lists
+	int64_t link_hops = 0;
+	int64_t scattered_link_hops = 0;
+
+	basic_small_list_set() {
 		list_heads = dvector<int>();
 		linked_store = dvector<int>();
 		free_head_ptr = Null;
@@ -77,12 +94,15 @@ public:
 		free_blocks = dvector<int>();
 	}
 
-	small_list_set(const small_list_set &copy) {
+	basic_small_list_set(const basic_small_list_set &copy) {
 		linked_store = dvector<int>(copy.linked_store);
 		free_head_ptr = copy.free_head_ptr;
 		list_heads = dvector<int>(copy.list_heads);
 		block_store = dvector<int>(copy.block_store);
 		free_blocks = dvector<int>(copy.free_blocks);
+		allocated_count = copy.allocated_count;
+		link_hops = copy.link_hops;
+		scattered_link_hops = copy.scattered_link_hops;
 	}
 
 	/// <summary>
@@ -139,21 +159,11 @@ public:
 		} else {
 			// spill to linked list
 			int cur_head = block_store[block_ptr + BLOCK_LIST_OFFSET];
-
-			if (free_head_ptr == Null) {
-				// allocate linkedlist node
-				int new_ptr = (int)linked_store.size();
-				linked_store.add(val);
-				linked_store.add(cur_head);
-				block_store[block_ptr + BLOCK_LIST_OFFSET] = new_ptr;
-			} else {
-				// pull from free list
-				int free_ptr = free_head_ptr;
-				free_head_ptr = linked_store[free_ptr + 1];
-				linked_store[free_ptr] = val;
-				linked_store[free_ptr + 1] = cur_head;
-				block_store[block_ptr + BLOCK_LIST_OFFSET] = free_ptr;
-			}
+			int new_ptr = allocate_link();
+			linked_store[new_ptr] = val;
+			linked_store[new_ptr + 1] = cur_head;
+			block_store[block_ptr + BLOCK_LIST_OFFSET] = new_ptr;
+			count_link_hops(new_ptr, cur_head, Null, Null);
 		}
 
 		// count element
@@ -176,6 +186,7 @@ public:
 
 				if (N > BLOCKSIZE) {
 					int cur_ptr = block_store[block_ptr + BLOCK_LIST_OFFSET];
+					count_link_hops(Null, Null, cur_ptr, linked_store[cur_ptr + 1]);
 					block_store[block_ptr + BLOCK_LIST_OFFSET] = linked_store[cur_ptr + 1]; // point to cur->next
 					block_store[iEnd] = linked_store[cur_ptr];
 					add_free_link(cur_ptr);
@@ -221,6 +232,7 @@ public:
 				while (cur_ptr != Null) {
 					int free_ptr = cur_ptr;
 					cur_ptr = linked_store[cur_ptr + 1];
+					count_link_hops(Null, Null, free_ptr, cur_ptr);
 					add_free_link(free_ptr);
 				}
 				block_store[block_ptr + BLOCK_LIST_OFFSET] = Null;
@@ -228,7 +240,7 @@ public:
 
 			// free our block
 			block_store[block_ptr] = 0;
-			free_blocks.push_back(block_ptr);
+			free_block(block_ptr);
 			list_heads[list_index] = Null;
 		}
 	}
@@ -329,7 +341,7 @@ public:
 				set_to_end();
 		}
 
-		inline value_iterator(const small_list_set *pVector, int list_index, bool is_end,
+		inline value_iterator(const basic_small_list_set *pVector, int list_index, bool is_end,
 				const std::function<int(int)> &map_func = nullptr) {
 			p = pVector;
 			this->map_func = map_func;
@@ -356,7 +368,7 @@ public:
 			cur_ptr = -1;
 		}
 
-		const small_list_set *p;
+		const basic_small_list_set *p;
 		std::function<int(int)> map_func;
 		int list_index;
 		int block_ptr;
@@ -365,7 +377,7 @@ public:
 		int iCur;
 		int cur_ptr;
 		int cur_value;
-		friend class small_list_set;
+		friend class basic_small_list_set;
 	};
 	inline value_iterator begin_values(int list_index) const {
 		return value_iterator(this, list_index, false);
@@ -379,17 +391,17 @@ public:
 
 	class value_enumerable {
 	public:
-		const small_list_set *p;
+		const basic_small_list_set *p;
 		int list_index;
 		std::function<int(int)> map_func;
 		value_enumerable() {}
-		value_enumerable(const small_list_set *p, int list_index, std::function<int(int)> map_func = nullptr) {
+		value_enumerable(const basic_small_list_set *p, int list_index, std::function<int(int)> map_func = nullptr) {
 			this->p = p;
 			this->list_index = list_index;
 			this->map_func = map_func;
 		}
-		typename small_list_set::value_iterator begin() { return p->begin_values(list_index, map_func); }
-		typename small_list_set::value_iterator end() { return p->end_values(list_index); }
+		typename basic_small_list_set::value_iterator begin() { return p->begin_values(list_index, map_func); }
+		typename basic_small_list_set::value_iterator end() { return p->end_values(list_index); }
 	};
 	inline value_enumerable values(int list_index) const {
 		return value_enumerable(this, list_index);
@@ -501,15 +513,57 @@ public:
 		return false;
 	}
 
+	/// <summary>
+	/// Concurrent edits. Between BeginConcurrent() and EndConcurrent(), Insert/Remove/Clear
+	/// may be called from several threads at once for *different* lists. The block and
+	/// link pools are shared by all lists, so they are pre-grown here to hold nNewLists
+	/// more lists and nInserts more spilled elements, and guarded by a lock until EndConcurrent().
+	/// The list-of-lists must already be large enough, see Resize().
+	/// </summary>
+	void BeginConcurrent(int nNewLists, int nInserts) {
+		gDevAssert(pool_lock.get() == nullptr);
+		for (int k = (int)free_blocks.size(); k < nNewLists; ++k)
+			free_blocks.push_back(append_block());
+
+		int nFreeLinks = 0;
+		for (int ptr = free_head_ptr; ptr != Null && nFreeLinks < nInserts; ptr = linked_store[ptr + 1])
+			nFreeLinks++;
+		for (; nFreeLinks < nInserts; ++nFreeLinks) {
+			int new_ptr = (int)linked_store.size();
+			linked_store.add(Null);
+			linked_store.add(Null);
+			add_free_link(new_ptr);
+		}
+		pool_lock = std::make_shared<std::mutex>();
+	}
+
+	void EndConcurrent() {
+		pool_lock = nullptr;
+	}
+
 protected:
+	// guards the block/link pools during concurrent edits, see BeginConcurrent()
+	std::shared_ptr<std::mutex> pool_lock;
+
+	std::unique_lock<std::mutex> lock_pools() {
+		return (pool_lock != nullptr) ? std::unique_lock<std::mutex>(*pool_lock) : std::unique_lock<std::mutex>();
+	}
+
 	// grab a block from the free list, or allocate a one
 	int allocate_block() {
+		std::unique_lock<std::mutex> lock = lock_pools();
 		int nfree = (int)free_blocks.size();
 		if (nfree > 0) {
 			int ptr = free_blocks[nfree - 1];
 			free_blocks.pop_back();
 			return ptr;
 		}
+		if (pool_lock != nullptr)
+			throw std::runtime_error("small_list_set: block pool exhausted during concurrent edits");
+		return append_block();
+	}
+
+	int append_block() {
 		int nsize = (int)block_store.size();
 		block_store.insertAt(Null, nsize + BLOCK_LIST_OFFSET);
 		block_store[nsize] = 0;
@@ -517,12 +571,53 @@ protected:
 		return nsize;
 	}
 
+	void free_block(int block_ptr) {
+		std::unique_lock<std::mutex> lock = lock_pools();
+		free_blocks.push_back(block_ptr);
+	}
+
+	// grab a link-node from the free list, or allocate a new one
+	int allocate_link() {
+		std::unique_lock<std::mutex> lock = lock_pools();
+		if (free_head_ptr != Null) {
+			int free_ptr = free_head_ptr;
+			free_head_ptr = linked_store[free_ptr + 1];
+			return free_ptr;
+		}
+		if (pool_lock != nullptr)
+			throw std::runtime_error("small_list_set: link pool exhausted during concurrent edits");
+		int new_ptr = (int)linked_store.size();
+		linked_store.add(Null);
+		linked_store.add(Null);
+		return new_ptr;
+	}
+
 	// push a link-node onto the free list
 	void add_free_link(int ptr) {
+		std::unique_lock<std::mutex> lock = lock_pools();
 		linked_store[ptr + 1] = free_head_ptr;
 		free_head_ptr = ptr;
 	}
 
+	// count the hop from_ptr->to_ptr as added, and remove_from->remove_to as removed.
+	// Null nodes skip that side. Lists are edited concurrently, see BeginConcurrent()
+	void count_link_hops(int from_ptr, int to_ptr, int remove_from, int remove_to) {
+		int64_t dHops = 0, dScattered = 0;
+		if (from_ptr != Null && to_ptr != Null) {
+			dHops++;
+			dScattered += (to_ptr != from_ptr + 2) ? 1 : 0;
+		}
+		if (remove_from != Null && remove_to != Null) {
+			dHops--;
+			dScattered -= (remove_to != remove_from + 2) ? 1 : 0;
+		}
+		if (dHops == 0 && dScattered == 0)
+			return;
+		std::unique_lock<std::mutex> lock = lock_pools();
+		link_hops += dHops;
+		scattered_link_hops += dScattered;
+	}
+
 	// remove val from the linked-list attached to block_ptr
 	bool remove_from_linked_list(int block_ptr, int val) {
 		int cur_ptr = block_store[block_ptr + BLOCK_LIST_OFFSET];
@@ -530,6 +625,8 @@ protected:
 		while (cur_ptr != Null) {
 			if (linked_store[cur_ptr] == val) {
 				int next_ptr = linked_store[cur_ptr + 1];
+				count_link_hops(prev_ptr, next_ptr, prev_ptr, cur_ptr);
+				count_link_hops(Null, Null, cur_ptr, next_ptr);
 				if (prev_ptr == Null) {
 					block_store[block_ptr + BLOCK_LIST_OFFSET] = next_ptr;
 				} else {
@@ -545,16 +642,130 @@ protected:
 	}
 
 public:
+	/// <summary>
+	/// Re-linearize storage: blocks are re-packed in list_index order, and each
+	/// spilled list's linked nodes are stored contiguously in list order, so
+	/// traversal is sequential again. Free blocks and free links are released.
+	/// The order of values in each list is preserved.
+	/// </summary>
+	void Compact() {
+		dvector<int> new_blocks;
+		dvector<int> new_linked;
+		int nLists = (int)list_heads.size();
+		allocated_count = 0;
+		link_hops = scattered_link_hops = 0;
+		for (int li = 0; li < nLists; ++li) {
+			int block_ptr = list_heads[li];
+			if (block_ptr == Null)
+				continue;
+			int N = block_store[block_ptr];
+			int new_ptr = (int)new_blocks.size();
+			new_blocks.push_back(N);
+			for (int k = 1; k <= BLOCKSIZE; ++k)
+				new_blocks.push_back(block_store[block_ptr + k]);
+
+			int new_link = Null;
+			if (N > BLOCKSIZE) {
+				new_link = (int)new_linked.size();
+				int cur_ptr = block_store[block_ptr + BLOCK_LIST_OFFSET];
+				while (cur_ptr != Null) {
+					int next_ptr = linked_store[cur_ptr + 1];
+					new_linked.push_back(linked_store[cur_ptr]);
+					new_linked.push_back((next_ptr == Null) ? Null : (int)new_linked.size() + 1);
+					link_hops += (next_ptr == Null) ? 0 : 1;
+					cur_ptr = next_ptr;
+				}
+			}
+			new_blocks.push_back(new_link);
+
+			list_heads[li] = new_ptr;
+			allocated_count++;
+		}
+		block_store = std::move(new_blocks);
+		linked_store = std::move(new_linked);
+		free_blocks = dvector<int>();
+		free_head_ptr = Null;
+	}
+
+	struct memory_stats {
+		int lists = 0; // allocated (non-null) lists
+		int spilled_lists = 0; // lists with elements in linked_store
+		size_t elements = 0; // total values in all lists
+		size_t free_blocks = 0; // blocks in the free list
+		size_t linked_nodes = 0; // linked_store nodes, including free ones
+		size_t free_linked_nodes = 0;
+		size_t bytes = 0; // memory used by the dvector buffers
+		size_t wasted_bytes = 0; // unused inline slots, free blocks and free links
+		// fraction of linked-node hops that do not go to the next node in memory,
+		// ie 0 right after Compact(), approaching 1 when nodes are scattered
+		double fragmentation = 0;
+	};
+
+	/// <summary>
+	/// memory_stats::fragmentation without walking the lists. O(1)
+	/// </summary>
+	double LinkFragmentation() const {
+		return (link_hops == 0) ? 0.0 : (double)scattered_link_hops / (double)link_hops;
+	}
+
+	/// <summary>
+	/// compute memory/fragmentation statistics. O(total size)
+	/// </summary>
+	memory_stats MemoryStats() const {
+		memory_stats st;
+		size_t nHops = 0, nScattered = 0;
+		int nLists = (int)list_heads.size();
+		for (int li = 0; li < nLists; ++li) {
+			int block_ptr = list_heads[li];
+			if (block_ptr == Null)
+				continue;
+			st.lists++;
+			int N = block_store[block_ptr];
+			st.elements += N;
+			if (N < BLOCKSIZE)
+				st.wasted_bytes += (BLOCKSIZE - N) * sizeof(int);
+			if (N > BLOCKSIZE) {
+				st.spilled_lists++;
+				int cur_ptr = block_store[block_ptr + BLOCK_LIST_OFFSET];
+				while (cur_ptr != Null) {
+					int next_ptr = linked_store[cur_ptr + 1];
+					if (next_ptr != Null) {
+						nHops++;
+						if (next_ptr != cur_ptr + 2)
+							nScattered++;
+					}
+					cur_ptr = next_ptr;
+				}
+			}
+		}
+		for (int ptr = free_head_ptr; ptr != Null; ptr = linked_store[ptr + 1])
+			st.free_linked_nodes++;
+		st.free_blocks = free_blocks.size();
+		st.linked_nodes = linked_store.size() / 2;
+		st.bytes = list_heads.byte_count() + block_store.byte_count() + free_blocks.byte_count() + linked_store.byte_count();
+		st.wasted_bytes += st.free_blocks * (BLOCKSIZE + 2) * sizeof(int) + st.free_linked_nodes * 2 * sizeof(int);
+		st.fragmentation = (nHops == 0) ? 0.0 : (double)nScattered / (double)nHops;
+		return st;
+	}
+
 	std::string MemoryUsage() {
+		memory_stats st = MemoryStats();
 		std::ostringstream s;
 		s << "ListSize " << list_heads.size()
 		  << "  Blocks Count " << allocated_count
-		  << " Free " << (free_blocks.size() * sizeof(int) / 1024)
-		  << " Mem " << block_store.size()
-		  << "kb  Linked Mem " << (linked_store.size() * sizeof(int) / 1024) << "kb";
+		  << " Free " << st.free_blocks
+		  << " Mem " << (block_store.size() * sizeof(int) / 1024)
+		  << "kb  Linked Mem " << (linked_store.size() * sizeof(int) / 1024) << "kb"
+		  << "  Wasted " << (st.wasted_bytes / 1024) << "kb"
+		  << "  Fragmentation " << st.fragmentation;
 		return s.str();
 	}
 };
 
+// used for DMesh3 vertex-edge lists. Vertices with valence above G3_SMALL_LIST_BLOCKSIZE
+// spill into the linked store, define it at build time to tune for meshes with
+// unusually high or low valence
+typedef basic_small_list_set<> small_list_set;
+
 } // namespace g3
 #endif // SMALL_LIST_SET_H
@@ -32,6 +32,7 @@
 #define SPARSE_DVECTOR_H
 
 #include <g3Debug.h>
+#include <cstring>
 #include <vector>
 
 namespace g3 {
@@ -46,6 +47,11 @@ public:
 	~sparse_dvector_segment() {}
 };
 
+//
+// sparse_dvector is a segmented vector where segments that are never written are
+// not allocated (reads return the default value). Non-const access allocates the
+// segment of the element, const access and iteration do not.
+//
 template <class Type>
 class sparse_dvector {
 public:
@@ -114,7 +120,7 @@ protected:
 
 	Type *allocate_element();
 	sparse_dvector_segment<Type> &get_or_allocate(unsigned int nSegIndex);
-	bool is_allocated(unsigned int nSegIndex);
+	bool is_allocated(unsigned int nSegIndex) const;
 
 	friend class iterator;
 
@@ -204,6 +210,7 @@ const sparse_dvector<Type> &sparse_dvector<Type>::operator=(const sparse_dvector
 		} else if (is_allocated(k)) {
 			delete[] m_vSegments[k].pData;
 			m_vSegments[k].pData = nullptr;
+			m_nAllocated -= m_nSegmentSize;
 		}
 	}
 
@@ -212,11 +219,18 @@ const sparse_dvector<Type> &sparse_dvector<Type>::operator=(const sparse_dvector
 
 template <class Type>
 const sparse_dvector<Type> &sparse_dvector<Type>::operator=(sparse_dvector &&moved) {
-	clear(this);
+	clear(true);
 	this->m_nSegmentSize = moved.m_nSegmentSize;
 	this->m_nCurSeg = moved.m_nCurSeg;
+	this->m_nAllocated = moved.m_nAllocated;
+	this->m_defaultValue = moved.m_defaultValue;
 	m_vSegments = std::move(moved.m_vSegments);
+	moved.m_vSegments.resize(1);
+	moved.m_vSegments[0].pData = nullptr;
+	moved.m_vSegments[0].nSize = moved.m_nSegmentSize;
+	moved.m_vSegments[0].nCur = 0;
 	moved.m_nCurSeg = 0;
+	moved.m_nAllocated = 0;
 	return *this;
 }
 
@@ -299,7 +313,7 @@ sparse_dvector_segment<Type> &sparse_dvector<Type>::get_or_allocate(unsigned int
 }
 
 template <class Type>
-bool sparse_dvector<Type>::is_allocated(unsigned int nSegIndex) {
+bool sparse_dvector<Type>::is_allocated(unsigned int nSegIndex) const {
 	if (nSegIndex <= m_nCurSeg && m_vSegments[nSegIndex].pData != nullptr)
 		return true;
 	return false;
@@ -327,6 +341,7 @@ size_t sparse_dvector<Type>::size() const {
 	return m_nCurSeg * m_nSegmentSize + m_vSegments[m_nCurSeg].nCur;
 }
 
+// number of elements in allocated segments
 template <class Type>
 size_t sparse_dvector<Type>::allocated() const {
 	return m_nAllocated;
@@ -382,25 +397,22 @@ void sparse_dvector<Type>::pop_back() {
 
 template <class Type>
 Type &sparse_dvector<Type>::front() {
-	return get_or_allocate(0).pData[0];
+	return (*this)[0];
 }
 template <class Type>
 const Type &sparse_dvector<Type>::front() const {
-	return is_allocated(0) ? m_vSegments[0].pData[0] : m_defaultValue;
+	const sparse_dvector<Type> &cthis = *this;
+	return cthis[0];
 }
 
 template <class Type>
 Type &sparse_dvector<Type>::back() {
-	auto &seg = get_or_allocate(m_nCurSeg);
-	return seg.pData[seg.nCur - 1];
+	return (*this)[(unsigned int)size() - 1];
 }
 template <class Type>
 const Type &sparse_dvector<Type>::back() const {
-	if (is_allocated(m_nCurSeg)) {
-		auto &seg = m_vSegments[m_nCurSeg];
-		return seg.pData[seg.nCur - 1];
-	} else
-		return m_defaultValue;
+	const sparse_dvector<Type> &cthis = *this;
+	return cthis[(unsigned int)size() - 1];
 }
 
 template <class Type>
@@ -427,7 +439,8 @@ void sparse_dvector<Type>::apply(const Func &f) {
 
 template <typename Type>
 const Type &sparse_dvector<Type>::iterator::operator*() const {
-	return (*pVector)[i];
+	const sparse_dvector<Type> &v = *pVector;
+	return v[i];
 }
 
 template <typename Type>
@@ -465,10 +478,12 @@ void sparse_dvector<Type>::iterator::next() {
 	if (i == n)
 		return; // done!
 
-	while ((*pVector)[i] == pVector->m_defaultValue) {
-		unsigned int nSegment = i / pVector->m_nSegmentSize;
-		if (!pVector->is_allocated(nSegment))
-			i = (nSegment + 1) * pVector->m_nSegmentSize;
+	// use const access, so that skipping over default values does not allocate
+	const sparse_dvector<Type> &v = *pVector;
+	while (v[i] == v.m_defaultValue) {
+		unsigned int nSegment = i / v.m_nSegmentSize;
+		if (!v.is_allocated(nSegment))
+			i = (nSegment + 1) * v.m_nSegmentSize;
 		else
 			i++;
 		if (i >= n) {
@@ -498,7 +513,8 @@ typename sparse_dvector<Type>::iterator sparse_dvector<Type>::begin() {
 	if (empty())
 		return end();
 	iterator itr(this, 0);
-	if (*itr == m_defaultValue)
+	const sparse_dvector<Type> &cthis = *this;
+	if (cthis[0] == m_defaultValue)
 		itr.next();
 	return itr;
 }
@@ -0,0 +1,188 @@
+/**************************************************************************/
+/*  thread_pool.cpp                                                       */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#include <thread_pool.h>
+#include <geometry3PCH.h>
+
+#include <algorithm>
+
+namespace g3 {
+
+static thread_local const thread_pool *tls_pool = nullptr;
+static thread_local int tls_worker_index = -1;
+
+thread_pool::thread_pool(int nWorkers) :
+		pending(0), steal_start(0), stopping(false) {
+	if (nWorkers < 0) {
+		int nHardware = (int)std::thread::hardware_concurrency();
+		nWorkers = (nHardware > 1) ? nHardware - 1 : 0;
+	}
+	for (int k = 0; k < nWorkers + 1; ++k)
+		queues.push_back(std::make_unique<task_queue>());
+	for (int k = 0; k < nWorkers; ++k)
+		threads.emplace_back([this, k]() { worker_main(k); });
+}
+
+thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> l(sleep_lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread &t : threads)
+		t.join();
+}
+
+thread_pool &thread_pool::global() {
+	static thread_pool pool;
+	return pool;
+}
+
+int thread_pool::current_worker_index() const {
+	return (tls_pool == this) ? tls_worker_index : -1;
+}
+
+void thread_pool::submit(task t) {
+	int index = current_worker_index();
+	task_queue &q = (index >= 0) ? *queues[index] : *queues.back();
+	{
+		std::lock_guard<std::mutex> l(q.lock);
+		q.tasks.push_back(std::move(t));
+	}
+	{
+		std::lock_guard<std::mutex> l(sleep_lock);
+		pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	wake.notify_one();
+}
+
+bool thread_pool::try_run_one() {
+	int index = current_worker_index();
+	task t;
+	if ((index >= 0 && pop_task(index, t)) || steal_task(index, t)) {
+		t();
+		return true;
+	}
+	return false;
+}
+
+// owner takes from the back of its own deque
+bool thread_pool::pop_task(int index, task &t) {
+	task_queue &q = *queues[index];
+	std::lock_guard<std::mutex> l(q.lock);
+	if (q.tasks.empty())
+		return false;
+	t = std::move(q.tasks.back());
+	q.tasks.pop_back();
+	pending.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+// thieves take from the front of the other deques (including the injection queue).
+// Start position rotates so that thieves do not all hammer the same queue.
+bool thread_pool::steal_task(int index, task &t) {
+	int nQueues = (int)queues.size();
+	int start = (int)(steal_start.fetch_add(1, std::memory_order_relaxed) % (unsigned int)nQueues);
+	for (int k = 0; k < nQueues; ++k) {
+		int qi = (start + k) % nQueues;
+		if (qi == index)
+			continue;
+		task_queue &q = *queues[qi];
+		std::lock_guard<std::mutex> l(q.lock);
+		if (q.tasks.empty())
+			continue;
+		t = std::move(q.tasks.front());
+		q.tasks.pop_front();
+		pending.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void thread_pool::worker_main(int index) {
+	tls_pool = this;
+	tls_worker_index = index;
+	task t;
+	while (true) {
+		if (pop_task(index, t) || steal_task(index, t)) {
+			t();
+			t = nullptr;
+			continue;
+		}
+		std::unique_lock<std::mutex> l(sleep_lock);
+		wake.wait(l, [this]() { return stopping || pending.load(std::memory_order_relaxed) > 0; });
+		if (stopping)
+			return;
+	}
+}
+
+//
+// parallel backend
+//
+
+static parallel_backend active_backend;
+static bool have_backend = false;
+
+void set_parallel_backend(const parallel_backend &backend) {
+	active_backend = backend;
+	have_backend = (backend.dispatch != nullptr);
+}
+
+void clear_parallel_backend() {
+	active_backend = parallel_backend();
+	have_backend = false;
+}
+
+int parallel_concurrency() {
+	if (have_backend)
+		return std::max(active_backend.concurrency, 1);
+	return thread_pool::global().thread_count();
+}
+
+void parallel_invoke_indexed(int nTasks, const std::function<void(int)> &task) {
+	if (nTasks <= 0)
+		return;
+	if (nTasks == 1) {
+		task(0);
+		return;
+	}
+	if (have_backend) {
+		active_backend.dispatch(nTasks, task);
+		return;
+	}
+	// calling thread runs task 0 itself and then helps with the rest
+	task_group group;
+	for (int k = 1; k < nTasks; ++k)
+		group.run([&task, k]() { task(k); });
+	task(0);
+	group.wait();
+}
+
+} // end namespace g3
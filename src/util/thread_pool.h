@@ -0,0 +1,170 @@
+/**************************************************************************/
+/*  thread_pool.h                                                         */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <g3Config.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace g3 {
+
+//
+// thread_pool is a small portable (C++17) work-stealing task scheduler, used
+// by the non-TBB versions of the functions in parallel_util.h.
+//
+// Each worker thread owns a task deque. Tasks submitted from a worker go onto
+// that worker's deque and are popped LIFO (good locality for nested tasks),
+// idle workers steal FIFO from the other deques. Tasks submitted from outside
+// the pool go into a shared injection queue.
+//
+// Threads that wait on a task_group execute pending tasks while they wait, so
+// nested parallelism cannot deadlock, and a pool with zero workers (eg on a
+// single-core machine) simply runs everything on the waiting thread.
+//
+// Tasks must not throw.
+//
+class thread_pool {
+public:
+	typedef std::function<void()> task;
+
+	// nWorkers < 0 means (hardware_concurrency - 1), as the waiting thread also runs tasks
+	explicit thread_pool(int nWorkers = -1);
+	~thread_pool();
+
+	thread_pool(const thread_pool &copy) = delete;
+	const thread_pool &operator=(const thread_pool &copy) = delete;
+
+	// process-wide pool, created on first use
+	g3External static thread_pool &global();
+
+	// number of threads that can run tasks concurrently (workers + calling thread)
+	int thread_count() const { return (int)threads.size() + 1; }
+
+	// index of the calling thread in this pool, or -1 if it is not one of our workers
+	int current_worker_index() const;
+
+	// queue a task for execution
+	void submit(task t);
+
+	// run a single pending task on the calling thread, returns false if none was available
+	bool try_run_one();
+
+protected:
+	struct task_queue {
+		std::mutex lock;
+		std::deque<task> tasks;
+	};
+
+	// queues[k] belongs to worker k, the last queue is the injection queue
+	std::vector<std::unique_ptr<task_queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+	std::atomic<int> pending;
+	std::atomic<unsigned int> steal_start;
+	bool stopping;
+
+	void worker_main(int index);
+	bool pop_task(int index, task &t);
+	bool steal_task(int index, task &t);
+};
+
+//
+// task_group runs a set of tasks on a thread_pool and waits for all of them.
+// The destructor waits, so tasks may safely reference locals of the enclosing scope.
+//
+class task_group {
+public:
+	task_group() :
+			pool(&thread_pool::global()), pending(0) {}
+	explicit task_group(thread_pool &use_pool) :
+			pool(&use_pool), pending(0) {}
+	~task_group() { wait(); }
+
+	task_group(const task_group &copy) = delete;
+	const task_group &operator=(const task_group &copy) = delete;
+
+	template <typename Func>
+	void run(Func &&f) {
+		pending.fetch_add(1, std::memory_order_relaxed);
+		pool->submit([this, f = std::forward<Func>(f)]() mutable {
+			f();
+			pending.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	// block until all tasks have finished, executing pending pool tasks in the meantime
+	void wait() {
+		while (pending.load(std::memory_order_acquire) > 0) {
+			if (pool->try_run_one() == false)
+				std::this_thread::yield();
+		}
+	}
+
+protected:
+	thread_pool *pool;
+	std::atomic<int> pending;
+};
+
+//
+// Host applications can route g3 parallel loops through their own scheduler
+// (eg Godot's WorkerThreadPool) by installing a parallel_backend. dispatch()
+// must run task(k) for k in [0,nTasks) and only return once all have finished.
+// Parallel loops nest, so dispatch() is called re-entrantly from inside its own
+// tasks; it must not block a worker waiting on tasks that no free worker can run
+// (eg run nested tasks inline). Install at startup, before any parallel work is running.
+//
+struct parallel_backend {
+	std::function<void(int nTasks, const std::function<void(int)> &task)> dispatch;
+	int concurrency = 1;
+};
+
+g3External void set_parallel_backend(const parallel_backend &backend);
+g3External void clear_parallel_backend();
+
+// number of tasks a parallel loop should be split into to keep all threads busy
+g3External int parallel_concurrency();
+
+// run task(k) for k in [0,nTasks) concurrently, return when all are done
+g3External void parallel_invoke_indexed(int nTasks, const std::function<void(int)> &task);
+
+} // end namespace g3
+
+#endif // THREAD_POOL_H
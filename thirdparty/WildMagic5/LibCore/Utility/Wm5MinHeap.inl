@@ -121,9 +121,9 @@ const MinHeapRecord<Generator,Scalar>* MinHeap<Generator,Scalar>::Insert (
         int i;
         for (i = 0; i < mMaxElements; ++i)
         {
-            int byteOffset = (int)(mRecordPointers[i] - mRecords);
-            newRecordPointers[i] = (MinHeapRecord<Generator,Scalar>*)(
-                ((char*)newRecords) + byteOffset);
+            // (pointer difference is in records, not bytes)
+            int offset = (int)(mRecordPointers[i] - mRecords);
+            newRecordPointers[i] = newRecords + offset;
             newRecordPointers[i]->mIndex = i;
         }
 